@@ -342,9 +342,26 @@ struct FuzzyText : clife_base
     atomic<bool> messageDel = {false};
 
     typedef rapidfuzz::fuzz::CachedRatio<char32_t> FuzzyCache;
-    typedef simple_ptr<FuzzyCache> FuzzyCachePtr;
 
-    FuzzyCachePtr fuzzyCache;
+    // Кеш для нечеткого сравнения текста. Кеш содержит копию текста в UTF-32,
+    // поэтому создается только при первом обращении, т.е. для тех текстов,
+    // которые действительно сравниваются. Функция потокобезопасна
+    const FuzzyCache& fuzzyCache() const
+    {
+        FuzzyCache* cache = _fuzzyCache.load(std::memory_order_acquire);
+        if (cache == nullptr)
+        {
+            FuzzyCache* newCache = new FuzzyCache {text.toLower().toStdU32String()};
+            if (_fuzzyCache.compare_exchange_strong(cache, newCache,
+                                                    std::memory_order_acq_rel))
+                cache = newCache;
+            else
+                delete newCache;
+        }
+        return *cache;
+    }
+
+    ~FuzzyText() {delete _fuzzyCache.load();}
 
     typedef lst::List<FuzzyText, CompareChatMsg<FuzzyText>, clife_alloc_ref<FuzzyText>> List;
 
@@ -358,6 +375,9 @@ struct FuzzyText : clife_base
         J_SERIALIZE_MAP_ITEM( "time_life"   , timeLife   )
         J_SERIALIZE_MAP_ITEM( "message_del" , messageDel )
     J_SERIALIZE_END
+
+private:
+    mutable atomic<FuzzyCache*> _fuzzyCache = {nullptr};
 };
 
 // Вспомогательная структура для сериализации списка FuzzyText
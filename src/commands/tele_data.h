@@ -600,18 +600,36 @@ struct Update
     J_SERIALIZE_END
 };
 
+/**
+  https://core.telegram.org/bots/api#responseparameters
+*/
+struct ResponseParameters : clife_base
+{
+    typedef clife_ptr<ResponseParameters> Ptr;
+
+    qint64 migrate_to_chat_id = {0}; // Optional. The group has been migrated to a supergroup with the specified identifier
+    qint32 retry_after = {0};        // Optional. In case of exceeding flood control, the number of seconds left to wait before the request can be repeated
+
+    J_SERIALIZE_BEGIN
+        J_SERIALIZE_OPT ( migrate_to_chat_id )
+        J_SERIALIZE_OPT ( retry_after        )
+    J_SERIALIZE_END
+};
+
 struct HttpResult
 {
     bool       ok = {false};
     QByteArray result;
     qint32     error_code = {0};
     QString    description;
+    ResponseParameters::Ptr parameters; // Optional
 
     J_SERIALIZE_BEGIN
         J_SERIALIZE_ITEM( ok          )
         J_SERIALIZE_OPT ( result      )
         J_SERIALIZE_OPT ( error_code  )
         J_SERIALIZE_OPT ( description )
+        J_SERIALIZE_OPT ( parameters  )
     J_SERIALIZE_END
 };
 
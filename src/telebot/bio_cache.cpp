@@ -0,0 +1,207 @@
+#include "bio_cache.h"
+#include "hash_func.h"
+
+#include "shared/break_point.h"
+#include "shared/logger/logger.h"
+#include "shared/logger/format.h"
+#include "shared/safe_singleton.h"
+
+#include <algorithm>
+
+#define log_error_m   alog::logger().error  (alog_line_location, "BioCache")
+#define log_warn_m    alog::logger().warn   (alog_line_location, "BioCache")
+#define log_info_m    alog::logger().info   (alog_line_location, "BioCache")
+#define log_verbose_m alog::logger().verbose(alog_line_location, "BioCache")
+#define log_debug_m   alog::logger().debug  (alog_line_location, "BioCache")
+#define log_debug2_m  alog::logger().debug2 (alog_line_location, "BioCache")
+
+namespace tbot {
+
+// Интервал вывода статистики в лог (мсек)
+static const qint64 reportInterval = 10*60*1000 /*10 мин*/;
+
+BioCache::BioCache()
+{
+    _clock.start();
+}
+
+void BioCache::setParams(const Params& params)
+{
+    QMutexLocker locker {&_mutex}; (void) locker;
+
+    _params = params;
+    _params.ttl = std::max(_params.ttl, 0);
+    _params.maxUsers = std::max(_params.maxUsers, 1);
+
+    if (_params.ttl == 0)
+    {
+        _entries.clear();
+        _lru.clear();
+    }
+    evict();
+}
+
+BioCache::Params BioCache::params() const
+{
+    QMutexLocker locker {&_mutex}; (void) locker;
+    return _params;
+}
+
+void BioCache::update(qint64 userId, const QByteArray& data)
+{
+    QMutexLocker locker {&_mutex}; (void) locker;
+
+    if (_params.ttl == 0)
+        return;
+
+    const qint64 now = _clock.elapsed();
+    const quint64 hash = fnv1a(data.constData(), data.size());
+
+    ++_stats.fetches;
+    _statsChanged = true;
+
+    auto it = _entries.find(userId);
+    if (it == _entries.end())
+    {
+        _lru.push_front(userId);
+        it = _entries.insert(userId, Entry());
+        it->lru = _lru.begin();
+    }
+    else
+    {
+        _lru.splice(_lru.begin(), _lru, it->lru);
+        if (it->hash != hash)
+        {
+            // BIO изменилось, вердикты для прежних данных не действительны
+            it->verdicts.clear();
+            ++_stats.changes;
+        }
+    }
+    it->data = data;
+    it->hash = hash;
+    it->fetchTime = now;
+
+    evict();
+    report(now);
+}
+
+bool BioCache::data(qint64 userId, QByteArray& data)
+{
+    QMutexLocker locker {&_mutex}; (void) locker;
+
+    const qint64 now = _clock.elapsed();
+    Entry* entry = find(userId, now);
+    if (entry == nullptr)
+        return false;
+
+    data = entry->data;
+    ++_stats.dataHits;
+    _statsChanged = true;
+    return true;
+}
+
+BioCache::Verdict BioCache::verdict(qint64 userId, quint64 triggerKey)
+{
+    QMutexLocker locker {&_mutex}; (void) locker;
+
+    const qint64 now = _clock.elapsed();
+    Entry* entry = find(userId, now);
+    if (entry == nullptr)
+        return Verdict::Unknown;
+
+    auto it = entry->verdicts.constFind(triggerKey);
+    if (it == entry->verdicts.constEnd())
+        return Verdict::Unknown;
+
+    if (!it.value())
+    {
+        ++_stats.verdictHits;
+        _statsChanged = true;
+    }
+    return (it.value()) ? Verdict::Spam : Verdict::Clean;
+}
+
+void BioCache::setVerdict(qint64 userId, quint64 triggerKey, bool spam)
+{
+    QMutexLocker locker {&_mutex}; (void) locker;
+
+    auto it = _entries.find(userId);
+    if (it != _entries.end())
+        it->verdicts.insert(triggerKey, spam);
+}
+
+void BioCache::clearVerdicts()
+{
+    QMutexLocker locker {&_mutex}; (void) locker;
+
+    for (Entry& entry : _entries)
+        entry.verdicts.clear();
+}
+
+void BioCache::clear()
+{
+    QMutexLocker locker {&_mutex}; (void) locker;
+
+    _entries.clear();
+    _lru.clear();
+}
+
+quint64 BioCache::triggerKey(const QStringList& triggerNames, bool newUser)
+{
+    QStringList names = triggerNames;
+    names.sort();
+
+    quint64 hash = fnv1a(newUser ? "1" : "0", 1);
+    for (const QString& name : names)
+    {
+        const QByteArray buff = name.toUtf8();
+        hash = fnv1a(buff.constData(), buff.size() + 1 /*завершающий ноль*/, hash);
+    }
+    return hash;
+}
+
+BioCache::Entry* BioCache::find(qint64 userId, qint64 now)
+{
+    auto it = _entries.find(userId);
+    if (it == _entries.end())
+        return nullptr;
+
+    if (now - it->fetchTime >= qint64(_params.ttl) * 1000)
+        return nullptr;
+
+    _lru.splice(_lru.begin(), _lru, it->lru);
+    return &it.value();
+}
+
+void BioCache::evict()
+{
+    while (_entries.count() > _params.maxUsers)
+    {
+        _entries.remove(_lru.back());
+        _lru.pop_back();
+        ++_stats.evictions;
+        _statsChanged = true;
+    }
+}
+
+void BioCache::report(qint64 now)
+{
+    if (!_statsChanged || (now - _reportTime < reportInterval))
+        return;
+
+    log_info_m << log_format(
+        "BIO cache stat. Users: %?, fetched: %?, changed: %?, taken from cache: %?"
+        ", checks skipped: %?, evicted: %?",
+        _entries.count(), _stats.fetches, _stats.changes, _stats.dataHits,
+        _stats.verdictHits, _stats.evictions);
+
+    _statsChanged = false;
+    _reportTime = now;
+}
+
+BioCache& bioCache()
+{
+    return safe::singleton<BioCache>();
+}
+
+} // namespace tbot
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <QtCore>
+#include <list>
+
+namespace tbot {
+
+/**
+  Кеш BIO пользователей. Для пользователя хранится результат  запроса
+  getChat (BIO, персональный канал, бизнес-адрес), хеш этих данных и
+  вердикты проверки BIO триггерами. Вердикт  сохраняется  для  набора
+  триггеров (ключ набора вычисляется функцией triggerKey()), поэтому  он
+  используется во всех группах с таким же набором BIO-триггеров.
+
+  Данные пользователя действительны в течение ttl секунд, после этого BIO
+  запрашивается повторно. Если полученные данные не изменились (совпадает
+  хеш), то ранее вынесенные вердикты сохраняются. Количество пользователей
+  в кеше ограничено, при превышении ограничения удаляются пользователи, к
+  которым дольше всего не было обращений.
+
+  Класс потокобезопасный: данные сохраняются в потоке приложения, вердикты
+  выносятся в потоках обработки сообщений
+*/
+class BioCache
+{
+public:
+    struct Params
+    {
+        // Время хранения BIO пользователя в секундах. Значение 0 отключает
+        // кеширование
+        int ttl = {3600};
+
+        // Максимальное количество пользователей в кеше
+        int maxUsers = {100000};
+    };
+
+    enum class Verdict
+    {
+        Unknown, // Данных нет, срок их хранения истек или BIO не проверялось
+        Clean,   // BIO не активировало ни одного триггера
+        Spam     // BIO активировало триггер
+    };
+
+    BioCache();
+
+    void setParams(const Params&);
+    Params params() const;
+
+    // Сохраняет результат запроса getChat для пользователя userId. Если
+    // данные изменились, вердикты пользователя сбрасываются
+    void update(qint64 userId, const QByteArray& data);
+
+    // Возвращает TRUE и результат запроса getChat, если срок хранения
+    // данных не истек
+    bool data(qint64 userId, QByteArray& data);
+
+    // Вердикт для набора триггеров triggerKey
+    Verdict verdict(qint64 userId, quint64 triggerKey);
+    void setVerdict(qint64 userId, quint64 triggerKey, bool spam);
+
+    // Сбрасывает вердикты всех пользователей, используется при изменении
+    // конфигурации триггеров
+    void clearVerdicts();
+    void clear();
+
+    // Ключ набора BIO-триггеров группы. Параметр newUser - проверка нового
+    // пользователя (для новых пользователей используется часть триггеров)
+    static quint64 triggerKey(const QStringList& triggerNames, bool newUser);
+
+private:
+    typedef std::list<qint64> LruList;
+
+    struct Entry
+    {
+        QByteArray data;
+        quint64 hash = {0};
+        qint64 fetchTime = {0}; // Время получения данных (мсек)
+        QHash<quint64 /*ключ набора триггеров*/, bool /*спам*/> verdicts;
+        LruList::iterator lru;
+    };
+
+    // Возвращает запись пользователя, если срок хранения данных не истек.
+    // Запись перемещается в начало LRU-списка
+    Entry* find(qint64 userId, qint64 now);
+
+    // Удаляет пользователей, к которым дольше всего не было обращений
+    void evict();
+
+    // Выводит в лог статистику использования кеша
+    void report(qint64 now);
+
+private:
+    mutable QMutex _mutex;
+    Params _params;
+
+    QHash<qint64 /*user id*/, Entry> _entries;
+    LruList _lru; // Начало списка - последние обращения
+
+    QElapsedTimer _clock;
+
+    struct Stats
+    {
+        qint64 dataHits = {0};    // BIO взято из кеша без запроса getChat
+        qint64 verdictHits = {0}; // BIO не проверялось повторно
+        qint64 fetches = {0};     // Получено BIO по запросу getChat
+        qint64 changes = {0};     // Получено измененное BIO
+        qint64 evictions = {0};
+    };
+    Stats _stats;
+    bool _statsChanged = {false};
+    qint64 _reportTime = {0};
+};
+
+BioCache& bioCache();
+
+} // namespace tbot
@@ -0,0 +1,235 @@
+#include "campaign_detector.h"
+#include "fuzzy_index.h"
+#include "hash_func.h"
+
+#include "shared/break_point.h"
+#include "shared/safe_singleton.h"
+
+#include <QRegularExpression>
+#include <algorithm>
+
+namespace tbot {
+
+namespace {
+
+quint64 stringHash(const QString& str)
+{
+    return mix64(fnv1a(str));
+}
+
+inline quint64 pairKey(quint64 key, qint64 id, quint64 salt)
+{
+    return mix64(key ^ mix64(quint64(id) ^ salt));
+}
+
+// Соли для различения типов ключей в общих скетчах
+const quint64 SaltChat    = 0x43484154ULL; // CHAT
+const quint64 SaltUser    = 0x55534552ULL; // USER
+const quint64 SaltDomain  = 0x444F4D4EULL; // DOMN
+
+// Минимальное количество букв в тексте, при котором для текста
+// вычисляется отпечаток
+const int MinFingerprintLetters = 10;
+
+} // namespace
+
+void SlidingSketch::init(int window)
+{
+    _slotTime = std::max(window / SlotCount, 1);
+    std::fill(std::begin(_epoch), std::end(_epoch), qint64(-1));
+    _counters.fill(0, SlotCount * Depth * Width);
+}
+
+int SlidingSketch::cell(int slot, int row, quint64 key) const
+{
+    quint64 h = mix64(key + quint64(row) * 0x9E3779B97F4A7C15ULL);
+    return (slot * Depth + row) * Width + int(h & (Width - 1));
+}
+
+void SlidingSketch::rotate(qint64 time)
+{
+    const qint64 epoch = time / _slotTime;
+    const int slot = int(epoch % SlotCount);
+    if (_epoch[slot] == epoch)
+        return;
+
+    // Интервал, который вышел за пределы окна, используется повторно
+    std::fill(_counters.begin() + slot * Depth * Width,
+              _counters.begin() + (slot + 1) * Depth * Width, quint16(0));
+    _epoch[slot] = epoch;
+}
+
+int SlidingSketch::add(quint64 key, qint64 time)
+{
+    rotate(time);
+
+    const int slot = int((time / _slotTime) % SlotCount);
+    for (int row = 0; row < Depth; ++row)
+    {
+        quint16& counter = _counters[cell(slot, row, key)];
+        if (counter != quint16(-1))
+            ++counter;
+    }
+    return estimate(key, time);
+}
+
+int SlidingSketch::estimate(quint64 key, qint64 time) const
+{
+    const qint64 epoch = time / _slotTime;
+
+    int result = 0;
+    for (int slot = 0; slot < SlotCount; ++slot)
+    {
+        if ((_epoch[slot] <= epoch - SlotCount) || (_epoch[slot] > epoch))
+            continue;
+
+        int count = quint16(-1);
+        for (int row = 0; row < Depth; ++row)
+            count = std::min(count, int(_counters[cell(slot, row, key)]));
+        result += count;
+    }
+    return result;
+}
+
+CampaignDetector::CampaignDetector()
+{
+    _pairs.init(_params.window);
+    _chats.init(_params.window);
+    _newUsers.init(_params.window);
+}
+
+void CampaignDetector::setParams(const Params& params)
+{
+    QMutexLocker locker {&_mutex}; (void) locker;
+
+    // Счетчики сбрасываются только при изменении длительности окна
+    if (params.window != _params.window)
+    {
+        _pairs.init(params.window);
+        _chats.init(params.window);
+        _newUsers.init(params.window);
+    }
+    _params = params;
+}
+
+CampaignDetector::Params CampaignDetector::params() const
+{
+    QMutexLocker locker {&_mutex}; (void) locker;
+    return _params;
+}
+
+quint64 CampaignDetector::textFingerprint(const QString& text)
+{
+    QString letters;
+    const QString normText = FuzzyIndex::normalizeText(text);
+    letters.reserve(normText.length());
+    for (QChar c : normText)
+        if (c.isLetter())
+            letters.append(c);
+
+    if (letters.length() < MinFingerprintLetters)
+        return 0;
+
+    return FuzzyIndex::textHash(letters);
+}
+
+QStringList CampaignDetector::linkDomains(const QString& text)
+{
+    static const QRegularExpression reTme {
+        R"(\bt\.me/([\w+-]+))",
+        QRegularExpression::CaseInsensitiveOption};
+
+    static const QRegularExpression reUrl {
+        R"((?:https?://|www\.)([^\s/?#:]+))",
+        QRegularExpression::CaseInsensitiveOption};
+
+    QStringList domains;
+    QRegularExpressionMatchIterator it = reTme.globalMatch(text);
+    while (it.hasNext())
+        domains.append("t.me/" + it.next().captured(1).toLower());
+
+    it = reUrl.globalMatch(text);
+    while (it.hasNext())
+    {
+        QString domain = it.next().captured(1).toLower();
+        if (domain.startsWith("www."))
+            domain.remove(0, 4);
+
+        if (domain.isEmpty() || (domain == "t.me"))
+            continue;
+
+        domains.append(domain);
+    }
+    domains.removeDuplicates();
+    return domains;
+}
+
+CampaignDetector::Verdict CampaignDetector::update(qint64 chatId, qint64 userId,
+                                                   bool newUser, const QString& text,
+                                                   qint64 time)
+{
+    Verdict verdict;
+
+    const quint64 fingerprint = textFingerprint(text);
+    const QStringList domains = newUser ? linkDomains(text) : QStringList();
+
+    QMutexLocker locker {&_mutex}; (void) locker;
+
+    if (!_params.active)
+        return verdict;
+
+    if (fingerprint)
+    {
+        // Первое появление пары (отпечаток, группа) в окне
+        const quint64 chatKey = pairKey(fingerprint, chatId, SaltChat);
+        if (_pairs.add(chatKey, time) == 1)
+            verdict.chats = _chats.add(fingerprint, time);
+        else
+            verdict.chats = _chats.estimate(fingerprint, time);
+
+        if (newUser)
+        {
+            const quint64 userKey = pairKey(fingerprint, userId, SaltUser);
+            if (_pairs.add(userKey, time) == 1)
+                verdict.newUsers = _newUsers.add(fingerprint, time);
+            else
+                verdict.newUsers = _newUsers.estimate(fingerprint, time);
+        }
+
+        if ((_params.chats > 0 && verdict.chats >= _params.chats)
+            || (_params.newUsers > 0 && verdict.newUsers >= _params.newUsers))
+        {
+            verdict.campaign = true;
+        }
+    }
+
+    if (_params.domainNewUsers > 0)
+        for (const QString& domain : domains)
+        {
+            const quint64 domainKey = stringHash(domain) ^ SaltDomain;
+            const quint64 userKey = pairKey(domainKey, userId, SaltUser);
+
+            int domainNewUsers;
+            if (_pairs.add(userKey, time) == 1)
+                domainNewUsers = _newUsers.add(domainKey, time);
+            else
+                domainNewUsers = _newUsers.estimate(domainKey, time);
+
+            if ((domainNewUsers >= _params.domainNewUsers)
+                && (domainNewUsers > verdict.domainNewUsers))
+            {
+                verdict.campaign = true;
+                verdict.domain = domain;
+                verdict.domainNewUsers = domainNewUsers;
+            }
+        }
+
+    return verdict;
+}
+
+CampaignDetector& campaignDetector()
+{
+    return safe::singleton<CampaignDetector>();
+}
+
+} // namespace tbot
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <QtCore>
+
+namespace tbot {
+
+/**
+  Скетч count-min со скользящим окном. Окно разбито на SlotCount интервалов,
+  для каждого интервала хранится отдельная матрица счетчиков. При  переходе
+  к новому интервалу самый старый интервал обнуляется, поэтому объем памяти
+  постоянен, а оценка частоты ключа выполняется за O(1)
+*/
+class SlidingSketch
+{
+public:
+    // window - длительность окна в секундах
+    void init(int window);
+
+    // Увеличивает счетчик ключа. Возвращает оценку частоты ключа в окне
+    // (с учетом текущего добавления)
+    int add(quint64 key, qint64 time);
+
+    // Оценка частоты ключа в окне (может быть завышена, но не занижена)
+    int estimate(quint64 key, qint64 time) const;
+
+private:
+    int cell(int slot, int row, quint64 key) const;
+    void rotate(qint64 time);
+
+private:
+    static constexpr int SlotCount = 6;
+    static constexpr int Depth = 4;
+    static constexpr int Width = 1 << 13;
+
+    qint64 _slotTime = {100}; // Длительность интервала в секундах
+    qint64 _epoch[SlotCount] = {0};
+    QVector<quint16> _counters;
+};
+
+/**
+  Обнаружение спам-кампаний: один и тот же (после нормализации)  текст  или
+  ссылки на один и тот же домен появляются в разных группах или от  разных
+  новых пользователей за короткий промежуток времени.
+
+  Для каждого сообщения вычисляется отпечаток нормализованного текста и
+  извлекаются домены ссылок. Количество различных групп и различных новых
+  пользователей для отпечатка подсчитывается приближенно: пары (отпечаток,
+  группа) и (отпечаток, пользователь) учитываются в отдельном скетче, первое
+  появление пары увеличивает счетчик отпечатка. Объем памяти ограничен,
+  обработка сообщения выполняется за O(1)
+*/
+class CampaignDetector
+{
+public:
+    struct Params
+    {
+        bool active = {false};
+
+        // Длительность окна наблюдения в секундах
+        int window = {600};
+
+        // Количество различных групп, при достижении которого текст
+        // считается спам-кампанией
+        int chats = {5};
+
+        // Количество различных новых пользователей для текста
+        int newUsers = {5};
+
+        // Количество различных новых пользователей, разместивших ссылки
+        // на один домен. Значение 0 отключает проверку доменов
+        int domainNewUsers = {10};
+    };
+
+    struct Verdict
+    {
+        bool campaign = {false};
+        int chats = {0};          // Оценка количества групп для текста
+        int newUsers = {0};       // Оценка количества новых пользователей
+
+        // Домен, по которому обнаружена кампания, и оценка количества новых
+        // пользователей для домена
+        QString domain;
+        int domainNewUsers = {0};
+    };
+
+    CampaignDetector();
+
+    void setParams(const Params&);
+    Params params() const;
+
+    // Учитывает сообщение и возвращает вердикт. Параметр newUser - признак
+    // того, что автор сообщения недавно вступил в группу
+    Verdict update(qint64 chatId, qint64 userId, bool newUser,
+                   const QString& text, qint64 time);
+
+    // Отпечаток текста: хеш нормализованного текста, из которого удалены
+    // все символы кроме букв
+    static quint64 textFingerprint(const QString& text);
+
+    // Домены ссылок из текста (без префикса www.). Для ссылок t.me
+    // в качестве домена используется имя канала/группы
+    static QStringList linkDomains(const QString& text);
+
+private:
+    mutable QMutex _mutex;
+    Params _params;
+
+    SlidingSketch _pairs;       // Пары (ключ, группа/пользователь)
+    SlidingSketch _chats;       // Количество групп для отпечатка
+    SlidingSketch _newUsers;    // Количество новых пользователей для ключа
+};
+
+CampaignDetector& campaignDetector();
+
+} // namespace tbot
@@ -0,0 +1,157 @@
+#include "delete_aggregator.h"
+
+#include "shared/break_point.h"
+
+#include <algorithm>
+
+namespace tbot {
+
+// Время (мсек), в течение которого повторное удаление сообщения отбрасывается
+static const qint64 requestedTimeout = 10*60*1000 /*10 мин*/;
+
+void DeleteAggregator::setWindow(int window)
+{
+    _window = std::max(window, 0);
+}
+
+bool DeleteAggregator::add(qint64 chatId, qint32 messageId, qint64 sendTime)
+{
+    const Key key {chatId, messageId};
+    if (_requested.contains(key))
+        return false;
+
+    _requested.insert(key, sendTime);
+    _pending.insert(TimeKey {sendTime, ++_sequence}, key);
+    return true;
+}
+
+QVector<TgParams::Ptr> DeleteAggregator::take(qint64 now)
+{
+    if (now - _pruneTime > 60*1000 /*1 мин*/)
+    {
+        for (auto it = _requested.begin(); it != _requested.end();)
+            it = (now - it.value() > requestedTimeout) ? _requested.erase(it) : ++it;
+        _pruneTime = now;
+    }
+
+    // Сообщения, для которых наступило время удаления, по группам
+    QList<qint64> chatIds;
+    QHash<qint64, QList<qint32>> messageIds;
+    QHash<qint64, qint64> firstTime;
+
+    for (auto it = _pending.constBegin(); it != _pending.constEnd(); ++it)
+    {
+        if (it.key().first > now)
+            break;
+
+        const qint64 chatId = it.value().first;
+        if (!messageIds.contains(chatId))
+        {
+            chatIds.append(chatId);
+            firstTime.insert(chatId, it.key().first);
+        }
+        messageIds[chatId].append(it.value().second);
+    }
+
+    QSet<qint64> flushChats;
+    for (qint64 chatId : chatIds)
+        if ((firstTime[chatId] + _window <= now)
+            || (messageIds[chatId].count() >= MaxBatch))
+        {
+            flushChats.insert(chatId);
+        }
+
+    QVector<TgParams::Ptr> commands;
+    if (flushChats.isEmpty())
+        return commands;
+
+    for (auto it = _pending.begin(); it != _pending.end();)
+    {
+        if (it.key().first > now)
+            break;
+
+        it = flushChats.contains(it.value().first) ? _pending.erase(it) : ++it;
+    }
+
+    for (qint64 chatId : chatIds)
+    {
+        if (!flushChats.contains(chatId))
+            continue;
+
+        const QList<qint32>& ids = messageIds[chatId];
+        for (int i = 0; i < ids.count(); i += MaxBatch)
+            commands.append(command(chatId, ids.mid(i, MaxBatch)));
+    }
+    return commands;
+}
+
+qint64 DeleteAggregator::wait(qint64 now) const
+{
+    if (_pending.isEmpty())
+        return -1;
+
+    return std::max(_pending.firstKey().first + _window - now, qint64(0));
+}
+
+void DeleteAggregator::clear()
+{
+    _pending.clear();
+    _requested.clear();
+}
+
+TgParams::Ptr DeleteAggregator::command(qint64 chatId, const QList<qint32>& messageIds)
+{
+    if (messageIds.count() == 1)
+    {
+        auto params = tgfunction("deleteMessage");
+        params->api["chat_id"] = chatId;
+        params->api["message_id"] = messageIds[0];
+        return params;
+    }
+
+    QStringList ids;
+    for (qint32 messageId : messageIds)
+        ids.append(QString::number(messageId));
+
+    auto params = tgfunction("deleteMessages");
+    params->api["chat_id"] = chatId;
+    params->api["message_ids"] = QByteArray("[" + ids.join(',').toLatin1() + "]");
+    return params;
+}
+
+QList<qint32> DeleteAggregator::messageIds(const TgParams& params)
+{
+    QList<qint32> messageIds;
+    if (params.funcName == "deleteMessage")
+    {
+        messageIds.append(params.api["message_id"].toInt());
+    }
+    else if (params.funcName == "deleteMessages")
+    {
+        QString ids = params.api["message_ids"].toString();
+        ids.remove('[').remove(']');
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+        for (const QString& id : ids.split(QChar(','), Qt::SkipEmptyParts))
+#else
+        for (const QString& id : ids.split(QChar(','), QString::SkipEmptyParts))
+#endif
+            messageIds.append(id.trimmed().toInt());
+    }
+    return messageIds;
+}
+
+QVector<TgParams::Ptr> DeleteAggregator::split(const TgParams& params)
+{
+    QVector<TgParams::Ptr> commands;
+    const qint64 chatId = params.api["chat_id"].toLongLong();
+    for (qint32 messageId : messageIds(params))
+    {
+        auto p = tgfunction("deleteMessage");
+        p->api["chat_id"] = chatId;
+        p->api["message_id"] = messageId;
+        commands.append(p);
+    }
+    return commands;
+}
+
+} // namespace tbot
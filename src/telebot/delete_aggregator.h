@@ -0,0 +1,71 @@
+#pragma once
+
+#include "processing.h"
+
+#include <QtCore>
+
+namespace tbot {
+
+/**
+  Агрегатор команд удаления сообщений. Команды deleteMessage, поступающие
+  из разных участков кода, накапливаются в течение короткого интервала
+  (окна) и объединяются по группам в вызовы deleteMessages (до  100  сооб-
+  щений в одном вызове). Повторное удаление одного и того же  сообщения
+  отбрасывается: пара (группа, сообщение) запоминается на время, достаточ-
+  ное для того, чтобы все участки кода успели запросить удаление.
+
+  Время отправки команды (TgParams::delay) сохраняется: сообщение попадает
+  в пакет только после наступления времени отправки.
+
+  Класс не является потокобезопасным, используется в потоке приложения
+*/
+class DeleteAggregator
+{
+public:
+    // Максимальное количество сообщений в одном вызове deleteMessages
+    static constexpr int MaxBatch = 100;
+
+    // window - время накопления сообщений группы (мсек)
+    void setWindow(int window);
+    int window() const {return _window;}
+
+    // Добавляет сообщение для удаления, sendTime - наиболее раннее время
+    // удаления. Возвращает FALSE если удаление сообщения уже запрошено
+    bool add(qint64 chatId, qint32 messageId, qint64 sendTime);
+
+    // Возвращает команды удаления для групп, окно накопления  которых
+    // истекло, или для которых накоплено MaxBatch сообщений
+    QVector<TgParams::Ptr> take(qint64 now);
+
+    // Время (в миллисекундах) до формирования следующей команды. Значение
+    // -1 - нет сообщений для удаления
+    qint64 wait(qint64 now) const;
+
+    void clear();
+
+    // Создает команду deleteMessages (или deleteMessage для одного сообщения)
+    static TgParams::Ptr command(qint64 chatId, const QList<qint32>& messageIds);
+
+    // Идентификаторы сообщений команды deleteMessage/deleteMessages
+    static QList<qint32> messageIds(const TgParams&);
+
+    // Разбивает команду deleteMessages на отдельные команды deleteMessage,
+    // используется если вызов deleteMessages завершился ошибкой
+    static QVector<TgParams::Ptr> split(const TgParams&);
+
+private:
+    typedef QPair<qint64 /*chat id*/, qint32 /*message id*/> Key;
+    typedef QPair<qint64 /*время удаления*/, quint64 /*порядковый номер*/> TimeKey;
+
+    int _window = {200};
+    quint64 _sequence = {0};
+
+    // Сообщения, ожидающие удаления, упорядочены по времени удаления
+    QMap<TimeKey, Key> _pending;
+
+    // Сообщения, удаление которых уже запрошено, и время запроса
+    QHash<Key, qint64> _requested;
+    qint64 _pruneTime = {0};
+};
+
+} // namespace tbot
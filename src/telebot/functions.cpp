@@ -7,6 +7,7 @@
 
 #include <QtCore>
 #include <tuple>
+#include <algorithm>
 
 #define log_error_m   alog::logger().error  (alog_line_location, "Functions")
 #define log_warn_m    alog::logger().warn   (alog_line_location, "Functions")
@@ -155,8 +156,94 @@ WhiteUserList& whiteUsers()
     return safe::singleton<WhiteUserList>();
 }
 
+FuzzyIndexBuilder::FuzzyIndexBuilder(FuzzyTextList& owner)
+    : _owner(owner)
+{}
+
+void FuzzyIndexBuilder::build(const QVector<FuzzyTextSegment::Ptr>& segments,
+                              const data::FuzzyText::List& texts,
+                              const FuzzyTextSetPtr& removed, int generation)
+{
+    _segments = segments;
+    _texts = texts;
+    _removed = removed;
+    _generation = generation;
+    start();
+}
+
+void FuzzyIndexBuilder::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    auto segment = std::make_shared<FuzzyTextSegment>();
+
+    // Основой нового индекса становится копия индекса наибольшего сегмента,
+    // индексы остальных сегментов добавляются к ней
+    int base = -1;
+    for (int i = 0; i < _segments.count(); ++i)
+        if ((base < 0) || (_segments[i]->index.count() > _segments[base]->index.count()))
+            base = i;
+
+    if (base >= 0)
+        segment->index = _segments[base]->index;
+
+    for (int i = 0; i < _segments.count(); ++i)
+    {
+        CHECK_QTHREADEX_STOP
+        if (i != base)
+            segment->index.addFrom(_segments[i]->index);
+    }
+    for (data::FuzzyText* ft : _texts)
+    {
+        CHECK_QTHREADEX_STOP
+        if (!_removed->contains(ft))
+            segment->index.add(ft, FuzzyIndex::textKeys(ft->text));
+    }
+    for (data::FuzzyText* ft : *_removed)
+        segment->index.remove(ft);
+
+    // Список сегмента удерживает ссылки на тексты индекса
+    auto addText = [&segment, this](data::FuzzyText* ft)
+    {
+        if (_removed->contains(ft))
+            return;
+
+        ft->add_ref();
+        segment->list.add(ft);
+    };
+    for (const FuzzyTextSegment::Ptr& s : _segments)
+        for (data::FuzzyText* ft : s->list)
+            addText(ft);
+
+    for (data::FuzzyText* ft : _texts)
+        addText(ft);
+
+    if (!threadStop())
+        _owner.compactDone(segment, _generation, _segments.count(), _removed,
+                           timer.elapsed());
+
+    _segments.clear();
+    _texts.clear();
+    _removed.reset();
+}
+
+FuzzyTextList::FuzzyTextList()
+{
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->removed = std::make_shared<FuzzyTextSet>();
+    _snapshot = snapshot;
+}
+
+FuzzyTextList::~FuzzyTextList()
+{
+    _indexBuilder.stop();
+}
+
 void FuzzyTextList::add(const data::FuzzyText::Ptr& fuzzyText)
 {
+    const FuzzyIndex::Keys keys = FuzzyIndex::textKeys(fuzzyText->text);
+
     QMutexLocker locker {&_mutex}; (void) locker;
 
     if (_list.sortState() != lst::SortState::Up)
@@ -164,10 +251,13 @@ void FuzzyTextList::add(const data::FuzzyText::Ptr& fuzzyText)
 
     fuzzyText->add_ref();
     _changeFlag = true;
+    internUser(fuzzyText.get());
 
     lst::FindResult fr = _list.find(fuzzyText.get());
     if (fr.success())
     {
+        // Замененный текст исключается из поиска до освобождения списком
+        removeTexts({_list.item(fr.index())});
         _list.replace(fr.index(), fuzzyText.get(), true);
 
         log_debug_m << log_format(
@@ -182,18 +272,79 @@ void FuzzyTextList::add(const data::FuzzyText::Ptr& fuzzyText)
             "Text added to list FuzzyTexts. Chat/User/Msg: %?/%?/%?",
             fuzzyText->chatId, fuzzyText->user->id, fuzzyText->messageId);
     }
+
+    _bufferIndex.add(fuzzyText.get(), keys);
+
+    if (_bufferIndex.count() >= MergeThreshold)
+        flushBuffer();
+}
+
+void FuzzyTextList::listSwap(data::FuzzyText::List& list)
+{
+    while (true)
+    {
+        // Предыдущее построение сегмента должно быть завершено. Ожидание
+        // выполняется без блокировки: поток публикует сегмент под блокиров-
+        // кой _mutex
+        waitIndex();
+
+        QMutexLocker locker {&_mutex}; (void) locker;
+
+        // До получения блокировки могло начаться объединение сегментов
+        if (_indexBuilder.isRunning())
+            continue;
+
+        _list.swap(list);
+        if (_list.sortState() != lst::SortState::Up)
+            _list.sort();
+        _changeFlag = true;
+
+        _users.clear();
+        for (data::FuzzyText* ft : _list)
+            internUser(ft);
+
+        // Состояние без сегментов публикуется сразу, а индекс для нового
+        // списка строится в фоновом потоке: время старта программы не зави-
+        // сит от количества текстов. До окончания построения индекса поиск
+        // выполняется только по текстам, добавленным после загрузки
+        auto snapshot = std::make_shared<Snapshot>();
+        snapshot->removed = std::make_shared<FuzzyTextSet>();
+        snapshot->indexPending = !_list.empty();
+        _snapshot = snapshot;
+
+        _bufferIndex.clear();
+        _indexPendingLookups = 0;
+
+        const int generation = ++_indexGeneration;
+        if (snapshot->indexPending)
+        {
+            log_verbose_m << log_format(
+                "FuzzyTexts index build started. Texts: %?. Until the index is built"
+                " the loaded texts are not used in similarity search",
+                _list.count());
+
+            _indexBuilder.build({}, _list, snapshot->removed, generation);
+        }
+        return;
+    }
 }
 
 void FuzzyTextList::removeByTime()
 {
     QMutexLocker locker {&_mutex}; (void) locker;
 
+    // Удаленные тексты удерживаются до исключения из буфера записи, так
+    // как при удалении из индекса используется текст
+    data::FuzzyText::List removedList;
+
     const qint64 curTime = std::time(nullptr);
-    _list.removeCond([curTime, this](data::FuzzyText* fuzzyText) -> bool
+    _list.removeCond([curTime, &removedList, this](data::FuzzyText* fuzzyText) -> bool
     {
         qint64 timeLife = fuzzyText->timeLife.load();
         if (timeLife < curTime)
         {
+            fuzzyText->add_ref();
+            removedList.add(fuzzyText);
             log_debug_m << log_format(
                 "Text removed from list FuzzyTexts by timeout. Chat/User/Msg: %?/%?/%?",
                 fuzzyText->chatId, fuzzyText->user->id, fuzzyText->messageId);
@@ -201,34 +352,219 @@ void FuzzyTextList::removeByTime()
         }
         return false;
     });
+
+    if (removedList.empty())
+        return;
+
+    QVector<data::FuzzyText*> removed;
+    removed.reserve(removedList.count());
+    for (data::FuzzyText* ft : removedList)
+        removed.append(ft);
+    removeTexts(removed);
+
+    // Удаляются пользователи, для которых не осталось текстов
+    QSet<qint64> userIds;
+    for (data::FuzzyText* ft : _list)
+        userIds.insert(ft->user->id);
+
+    for (auto it = _users.begin(); it != _users.end();)
+        it = userIds.contains(it.key()) ? std::next(it) : _users.erase(it);
+
+    compact();
+}
+
+void FuzzyTextList::waitIndex()
+{
+    _indexBuilder.wait();
+}
+
+void FuzzyTextList::flushBuffer()
+{
+    if (_bufferIndex.count() == 0)
+        return;
+
+    auto segment = std::make_shared<FuzzyTextSegment>();
+    for (data::FuzzyText* ft : _bufferIndex.items())
+    {
+        ft->add_ref();
+        segment->list.add(ft);
+    }
+    segment->index = std::move(_bufferIndex);
+    _bufferIndex.clear();
+
+    auto snapshot = std::make_shared<Snapshot>(*_snapshot);
+    snapshot->segments.append(segment);
+    _snapshot = snapshot;
+
+    compact();
+}
+
+void FuzzyTextList::removeTexts(const QVector<data::FuzzyText*>& texts)
+{
+    std::shared_ptr<FuzzyTextSet> removed;
+    for (data::FuzzyText* ft : texts)
+    {
+        if (_bufferIndex.contains(ft))
+        {
+            _bufferIndex.remove(ft);
+            continue;
+        }
+
+        // Текст сегмента удерживается сегментом до объединения сегментов,
+        // поэтому его адрес не может быть использован повторно
+        if (!removed)
+            removed = std::make_shared<FuzzyTextSet>(*_snapshot->removed);
+        removed->insert(ft);
+    }
+
+    if (removed)
+    {
+        auto snapshot = std::make_shared<Snapshot>(*_snapshot);
+        snapshot->removed = removed;
+        _snapshot = snapshot;
+    }
+}
+
+void FuzzyTextList::compact()
+{
+    if (_indexBuilder.isRunning())
+        return;
+
+    const int segments = _snapshot->segments.count();
+    const int removed = _snapshot->removed->count();
+    if ((segments <= CompactSegments)
+        && (removed <= std::max(CompactRemoved, _list.count() / 8)))
+    {
+        return;
+    }
+
+    _indexBuilder.build(_snapshot->segments, {}, _snapshot->removed, _indexGeneration);
+}
+
+void FuzzyTextList::compactDone(const FuzzyTextSegment::Ptr& segment, int generation,
+                                int segmentCount, const FuzzyTextSetPtr& removed,
+                                qint64 elapsed)
+{
+    QMutexLocker locker {&_mutex}; (void) locker;
+
+    if (generation != _indexGeneration)
+        return;
+
+    // Сегменты, созданные во время построения, сохраняются. Тексты,
+    // удаленные во время построения, остаются в множестве удаленных
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->segments.append(segment);
+    snapshot->segments += _snapshot->segments.mid(segmentCount);
+
+    if (removed->isEmpty())
+    {
+        snapshot->removed = _snapshot->removed;
+    }
+    else
+    {
+        auto rest = std::make_shared<FuzzyTextSet>(*_snapshot->removed);
+        rest->subtract(*removed);
+        snapshot->removed = rest;
+    }
+
+    const bool indexPending = _snapshot->indexPending;
+    _snapshot = snapshot;
+
+    if (indexPending)
+        log_verbose_m << log_format(
+            "FuzzyTexts index built in %? ms. Texts: %?"
+            ". Lookups performed without loaded texts: %?",
+            elapsed, segment->list.count(), _indexPendingLookups.exchange(0));
+    else
+        log_debug_m << log_format(
+            "FuzzyTexts segments compacted in %? ms. Segments: %?, texts: %?",
+            elapsed, segmentCount, segment->list.count());
+}
+
+void FuzzyTextList::internUser(data::FuzzyText* fuzzyText)
+{
+    if (fuzzyText->user.empty())
+        return;
+
+    tbot::User::Ptr& user = _users[fuzzyText->user->id];
+    if (user.empty())
+        user = fuzzyText->user;
+    else
+        fuzzyText->user = user;
 }
 
 data::FuzzyText::List FuzzyTextList::textSimilarity(
                                         const data::FuzzyText::Ptr& fuzzyText) const
 {
-    QMutexLocker locker {&_mutex}; (void) locker;
+    auto sameMessage = [&fuzzyText](data::FuzzyText* ft)
+    {
+        return (fuzzyText->chatId == ft->chatId
+                && fuzzyText->messageId == ft->messageId);
+    };
 
-    data::FuzzyText::List list;
+    const quint64 textHash = FuzzyIndex::textHash(fuzzyText->text);
     const u32string text32 = fuzzyText->text.toLower().toStdU32String();
-    for (data::FuzzyText* ft : _list)
+    const FuzzyIndex::Bands bands = FuzzyIndex::textBands(text32);
+
+    bool exactSpam = false;
+    data::FuzzyText::List exactList;
+    data::FuzzyText::List list;
+
+    auto search = [&](const FuzzyIndex& index, const FuzzyTextSet* removed)
     {
-        if (fuzzyText->chatId == ft->chatId
-            && fuzzyText->messageId == ft->messageId)
-            continue;
+        auto skip = [&](data::FuzzyText* ft)
+        {
+            return sameMessage(ft) || (removed && removed->contains(ft));
+        };
 
-        if (ft->fuzzyCache.empty())
+        // Точные копии текста, отмеченного администратором как спам, находятся
+        // по хешу нормализованного текста без нечеткого сравнения
+        for (data::FuzzyText* ft : index.exact(textHash))
         {
-            const u32string t32 = ft->text.toLower().toStdU32String();
-            ft->fuzzyCache = data::FuzzyText::FuzzyCachePtr::create(t32);
+            if (skip(ft))
+                continue;
+
+            exactSpam = exactSpam || ft->spam;
+            ft->add_ref();
+            exactList.add(ft);
         }
+        if (exactSpam)
+            return;
+
+        QVector<data::FuzzyText*> candidates = index.candidates(bands);
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(), skip),
+                         candidates.end());
 
-        double res = ft->fuzzyCache->similarity(text32, 90);
-        if (res > 90)
+        for (data::FuzzyText* ft : index.similar(text32, candidates, 90))
         {
             ft->add_ref();
             list.add(ft);
         }
+    };
+
+    // Снимок сегментов берется под той же блокировкой, что и поиск по
+    // буферу записи: тексты буфера не могут быть перенесены в новый сегмент
+    // между этими действиями. Сегменты удерживаются снимком до окончания
+    // поиска, поиск по ним выполняется без блокировки
+    Snapshot::Ptr snapshot;
+    { //Block for QMutexLocker
+        QMutexLocker locker {&_mutex}; (void) locker;
+        snapshot = _snapshot;
+        search(_bufferIndex, nullptr);
     }
+    if (snapshot->indexPending)
+        ++_indexPendingLookups;
+
+    for (const FuzzyTextSegment::Ptr& segment : snapshot->segments)
+    {
+        if (exactSpam)
+            break;
+        search(segment->index, snapshot->removed.get());
+    }
+
+    if (exactSpam)
+        return exactList;
+
     return list;
 }
 
@@ -1,7 +1,14 @@
 #pragma once
 
+#include "fuzzy_index.h"
 #include "commands/commands.h"
 
+#include "shared/defmac.h"
+#include "shared/qt/qthreadex.h"
+
+#include <atomic>
+#include <memory>
+
 namespace tbot {
 
 using namespace std;
@@ -96,15 +103,157 @@ public:
 
 WhiteUserList& whiteUsers();
 
+/**
+  Неизменяемый после публикации сегмент текстов FuzzyTextList: список
+  текстов (удерживает ссылки на тексты) и индекс для поиска похожих текстов
+*/
+struct FuzzyTextSegment
+{
+    typedef std::shared_ptr<const FuzzyTextSegment> Ptr;
+
+    data::FuzzyText::List list;
+    FuzzyIndex index;
+};
+
+// Множество текстов, удаленных из списка FuzzyTextList, но еще присутствующих
+// в опубликованных сегментах
+typedef QSet<data::FuzzyText*> FuzzyTextSet;
+typedef std::shared_ptr<const FuzzyTextSet> FuzzyTextSetPtr;
+
+class FuzzyTextList;
+
+/**
+  Поток для построения сегментов FuzzyTextList вне блокировки списка:
+  индекса для списка, загруженного функцией FuzzyTextList::listSwap(), и
+  объединения (уплотнения) опубликованных сегментов с исключением удаленных
+  текстов. Результат публикуется в FuzzyTextList
+*/
+class FuzzyIndexBuilder : public QThreadEx
+{
+public:
+    explicit FuzzyIndexBuilder(FuzzyTextList&);
+
+    // Запускает построение сегмента из сегментов segments и текстов texts
+    // (для них индекс строится заново) без текстов removed. Предыдущее
+    // построение должно быть завершено
+    void build(const QVector<FuzzyTextSegment::Ptr>& segments,
+               const data::FuzzyText::List& texts,
+               const FuzzyTextSetPtr& removed, int generation);
+
+private:
+    DISABLE_DEFAULT_COPY(FuzzyIndexBuilder)
+
+    void run() override;
+
+private:
+    FuzzyTextList& _owner;
+    QVector<FuzzyTextSegment::Ptr> _segments;
+    data::FuzzyText::List _texts;
+    FuzzyTextSetPtr _removed;
+    int _generation = {0};
+};
+
 /**
     Класс для работы с идентичными сообщениями
+
+    Тексты хранятся в неизменяемых сегментах (список текстов и индекс) и в
+    небольшом буфере записи. При переполнении буфер превращается в новый
+    сегмент, удаленные тексты отмечаются в множестве удаленных, поэтому
+    изменение списка не требует копирования индекса. Сегменты и удаленные
+    тексты периодически объединяются в один сегмент в фоновом потоке.
+
+    Поиск похожих текстов: под блокировкой выполняется поиск по буферу
+    записи и берется снимок сегментов, затем поиск по сегментам выполняется
+    без блокировки
 */
 class FuzzyTextList : public DataList<data::FuzzyText>
 {
 public:
+    FuzzyTextList();
+    ~FuzzyTextList();
+
     void add(const data::FuzzyText::Ptr&);
+    void listSwap(data::FuzzyText::List&);
     void removeByTime();
+
+    // Ожидает окончания построения сегмента в фоновом потоке (в том числе
+    // индекса для списка, загруженного через listSwap())
+    void waitIndex();
+
+    // Поиск похожих текстов. Точное сравнение rapidfuzz выполняется только
+    // для кандидатов, найденных с помощью LSH-индекса
     data::FuzzyText::List textSimilarity(const data::FuzzyText::Ptr&) const;
+
+private:
+    // Опубликованное состояние списка. Не изменяется после публикации,
+    // поэтому используется читающими потоками без блокировки
+    struct Snapshot
+    {
+        typedef std::shared_ptr<const Snapshot> Ptr;
+
+        QVector<FuzzyTextSegment::Ptr> segments;
+        FuzzyTextSetPtr removed;
+
+        // Индекс для списка, загруженного через listSwap(), еще строится:
+        // тексты списка в поиске не участвуют
+        bool indexPending = {false};
+    };
+
+    // Превращает буфер записи в новый сегмент. Вызывается под блокировкой
+    // _mutex
+    void flushBuffer();
+
+    // Исключает из поиска тексты, удаленные из списка: текст удаляется из
+    // буфера записи или отмечается в множестве удаленных текстов. Вызывается
+    // под блокировкой _mutex
+    void removeTexts(const QVector<data::FuzzyText*>&);
+
+    // Запускает объединение сегментов в фоновом потоке, если количество
+    // сегментов или удаленных текстов превышает порог. Вызывается под
+    // блокировкой _mutex
+    void compact();
+
+    // Публикует сегмент, построенный в фоновом потоке. Сегмент заменяет
+    // первые segmentCount сегментов, удаленные тексты removed в нем уже
+    // исключены. Параметр elapsed - время построения (мсек)
+    void compactDone(const FuzzyTextSegment::Ptr&, int generation, int segmentCount,
+                     const FuzzyTextSetPtr& removed, qint64 elapsed);
+
+    // Заменяет пользователя текста общей (интернированной) структурой User
+    // с тем же идентификатором. Вызывается под блокировкой _mutex
+    void internUser(data::FuzzyText*);
+
+private:
+    // Максимальный размер буфера записи, при превышении которого буфер
+    // превращается в сегмент
+    static constexpr int MergeThreshold = 256;
+
+    // Пороги количества сегментов и удаленных текстов, при превышении
+    // которых сегменты объединяются
+    static constexpr int CompactSegments = 8;
+    static constexpr int CompactRemoved = 1024;
+
+    // Опубликованное состояние (защищено _mutex, снимок используется
+    // читающими потоками без блокировки)
+    Snapshot::Ptr _snapshot;
+
+    // Индекс буфера записи: тексты, добавленные после создания последнего
+    // сегмента (защищен _mutex). Сами тексты удерживаются списком _list
+    FuzzyIndex _bufferIndex;
+
+    // Интернированные пользователи (защищены _mutex). Тексты одного
+    // пользователя ссылаются на одну структуру User
+    QHash<qint64 /*user id*/, tbot::User::Ptr> _users;
+
+    // Фоновое построение сегментов
+    FuzzyIndexBuilder _indexBuilder {*this};
+    int _indexGeneration = {0};
+
+    // Количество поисков, выполненных до окончания построения индекса
+    // для загруженного списка
+    mutable std::atomic_int _indexPendingLookups = {0};
+
+    friend class FuzzyIndexBuilder;
 };
 
 FuzzyTextList& fuzzyTexts();
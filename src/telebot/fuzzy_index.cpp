@@ -0,0 +1,252 @@
+#include "fuzzy_index.h"
+#include "hash_func.h"
+
+#include "shared/break_point.h"
+
+#include <QRegularExpression>
+
+namespace tbot {
+
+using namespace std;
+
+namespace {
+
+// Размер шингла в символах
+const int ShingleSize = 3;
+
+// Параметры LSH: сигнатура из BandCount * BandRows минимальных хешей.
+// Для пары текстов с коэффициентом Жаккара J вероятность попасть в канди-
+// даты равна 1 - (1 - J^BandRows)^BandCount, для J = 0.35 это около 0.98
+const int BandCount = 32;
+const int BandRows = 2;
+const int HashCount = BandCount * BandRows;
+
+// Параметры хеш-функций вида (a * x + b) >> 32, задающих перестановки
+// для вычисления минимальных хешей
+struct HashParams
+{
+    quint64 a[HashCount];
+    quint64 b[HashCount];
+
+    HashParams()
+    {
+        quint64 seed = 0x54424F5446555A5AULL;
+        for (int i = 0; i < HashCount; ++i)
+        {
+            a[i] = mix64(seed += 0x9E3779B97F4A7C15ULL) | 1;
+            b[i] = mix64(seed += 0x9E3779B97F4A7C15ULL);
+        }
+    }
+};
+
+const HashParams& hashParams()
+{
+    static HashParams params;
+    return params;
+}
+
+} // namespace
+
+QString FuzzyIndex::normalizeText(const QString& text)
+{
+    static const QRegularExpression reUrl {
+        R"((https?://|www\.|t\.me/)\S*)",
+        QRegularExpression::CaseInsensitiveOption};
+
+    QString result = text.toLower();
+    result.remove(reUrl);
+    return result.simplified();
+}
+
+quint64 FuzzyIndex::textHash(const QString& text)
+{
+    const QString normText = normalizeText(text);
+
+    return mix64(fnv1a(normText));
+}
+
+FuzzyIndex::Keys FuzzyIndex::textKeys(const QString& text)
+{
+    const u32string text32 = text.toLower().toStdU32String();
+
+    Keys keys;
+    keys.textHash = textHash(text);
+    keys.bands = textBands(text32);
+    keys.length = int(text32.size());
+    return keys;
+}
+
+FuzzyIndex::Bands FuzzyIndex::textBands(const u32string& text)
+{
+    Bands bands;
+    if (int(text.size()) < ShingleSize)
+        return bands;
+
+    const HashParams& params = hashParams();
+
+    quint32 signature[HashCount];
+    for (int k = 0; k < HashCount; ++k)
+        signature[k] = quint32(-1);
+
+    for (size_t i = 0; i + ShingleSize <= text.size(); ++i)
+    {
+        // Символ UTF-32 занимает не более 21 бита, шингл из трех символов
+        // однозначно упаковывается в 64-битное значение
+        quint64 shingle = (quint64(text[i    ] & 0x1FFFFF) << 42)
+                        | (quint64(text[i + 1] & 0x1FFFFF) << 21)
+                        |  quint64(text[i + 2] & 0x1FFFFF);
+        quint64 h = mix64(shingle);
+
+        for (int k = 0; k < HashCount; ++k)
+        {
+            quint32 v = quint32((params.a[k] * h + params.b[k]) >> 32);
+            if (v < signature[k])
+                signature[k] = v;
+        }
+    }
+
+    bands.reserve(BandCount);
+    for (int band = 0; band < BandCount; ++band)
+    {
+        quint64 key = quint64(band);
+        for (int row = 0; row < BandRows; ++row)
+            key = mix64(key ^ (quint64(signature[band * BandRows + row]) << 8));
+        bands.append(key);
+    }
+    return bands;
+}
+
+void FuzzyIndex::add(data::FuzzyText* fuzzyText, const Keys& keys)
+{
+    remove(fuzzyText);
+
+    for (quint64 key : keys.bands)
+        _buckets[key].append(fuzzyText);
+
+    _exact[keys.textHash].append(fuzzyText);
+    _items.insert(fuzzyText, Item {keys.textHash, keys.length});
+}
+
+void FuzzyIndex::addFrom(const FuzzyIndex& other)
+{
+    for (auto it = other._items.constBegin(); it != other._items.constEnd(); ++it)
+    {
+        remove(it.key());
+        _items.insert(it.key(), it.value());
+    }
+    for (auto it = other._buckets.constBegin(); it != other._buckets.constEnd(); ++it)
+        _buckets[it.key()].append(it.value());
+
+    for (auto it = other._exact.constBegin(); it != other._exact.constEnd(); ++it)
+        _exact[it.key()].append(it.value());
+}
+
+void FuzzyIndex::removeFrom(QHash<quint64, QVector<data::FuzzyText*>>& hash,
+                            quint64 key, data::FuzzyText* fuzzyText)
+{
+    auto it = hash.find(key);
+    if (it == hash.end())
+        return;
+
+    it->removeOne(fuzzyText);
+    if (it->isEmpty())
+        hash.erase(it);
+}
+
+void FuzzyIndex::remove(data::FuzzyText* fuzzyText)
+{
+    auto it = _items.find(fuzzyText);
+    if (it == _items.end())
+        return;
+
+    const u32string text32 = fuzzyText->text.toLower().toStdU32String();
+    for (quint64 key : textBands(text32))
+        removeFrom(_buckets, key, fuzzyText);
+
+    removeFrom(_exact, it->textHash, fuzzyText);
+    _items.erase(it);
+}
+
+void FuzzyIndex::clear()
+{
+    _buckets.clear();
+    _exact.clear();
+    _items.clear();
+}
+
+QVector<data::FuzzyText*> FuzzyIndex::exact(quint64 textHash) const
+{
+    return _exact.value(textHash);
+}
+
+QVector<data::FuzzyText*> FuzzyIndex::candidates(const Bands& bands) const
+{
+    QVector<data::FuzzyText*> result;
+    QSet<data::FuzzyText*> unique;
+
+    for (quint64 key : bands)
+    {
+        auto bucket = _buckets.constFind(key);
+        if (bucket == _buckets.constEnd())
+            continue;
+
+        for (data::FuzzyText* ft : bucket.value())
+            if (!unique.contains(ft))
+            {
+                unique.insert(ft);
+                result.append(ft);
+            }
+    }
+    return result;
+}
+
+QVector<data::FuzzyText*> FuzzyIndex::similar(const u32string& text32,
+                                              const QVector<data::FuzzyText*>& candidates,
+                                              double cutoff) const
+{
+    QVector<data::FuzzyText*> result;
+    QVector<data::FuzzyText*> shortTexts;
+
+    const int length = int(text32.size());
+    for (data::FuzzyText* ft : candidates)
+    {
+        auto it = _items.constFind(ft);
+        if (it == _items.constEnd())
+            continue;
+
+        // Расстояние Indel не меньше разницы длин строк, поэтому оценка
+        // схожести не превышает 2 * min(len1, len2) / (len1 + len2)
+        const int len = it->length;
+        if (200.0 * qMin(length, len) / qMax(length + len, 1) <= cutoff)
+            continue;
+
+#ifdef RAPIDFUZZ_SIMD
+        if (len <= ShortTextLength)
+        {
+            shortTexts.append(ft);
+            continue;
+        }
+#endif
+        if (ft->fuzzyCache().similarity(text32, cutoff) > cutoff)
+            result.append(ft);
+    }
+
+#ifdef RAPIDFUZZ_SIMD
+    if (!shortTexts.isEmpty())
+    {
+        rapidfuzz::experimental::MultiRatio<ShortTextLength> scorer {size_t(shortTexts.count())};
+        for (data::FuzzyText* ft : shortTexts)
+            scorer.insert(ft->text.toLower().toStdU32String());
+
+        std::vector<double> scores(scorer.result_count());
+        scorer.similarity(scores.data(), scores.size(), text32, cutoff);
+
+        for (int i = 0; i < shortTexts.count(); ++i)
+            if (scores[i] > cutoff)
+                result.append(shortTexts[i]);
+    }
+#endif
+    return result;
+}
+
+} // namespace tbot
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "commands/commands.h"
+
+#include <QtCore>
+#include <string>
+
+namespace tbot {
+
+/**
+  Индекс MinHash/LSH для поиска похожих текстов. Текст разбивается на сим-
+  вольные шинглы, по множеству шинглов вычисляется MinHash-сигнатура, кото-
+  рая делится на полосы (bands). Тексты, у которых совпадает хотя бы одна
+  полоса, являются кандидатами для точного сравнения функцией rapidfuzz.
+  Количество кандидатов практически не зависит от общего числа текстов
+
+  Дополнительно индекс содержит хеш-таблицу по 64-битному хешу нормализо-
+  ванного текста, она используется для поиска точных копий текста за O(1)
+
+  Класс не является потокобезопасным, синхронизация доступа выполняется
+  владельцем индекса. Константные методы не изменяют индекс,
+  поэтому могут вызываться одновременно из нескольких потоков
+*/
+class FuzzyIndex
+{
+public:
+    typedef QVector<quint64> Bands;
+
+    struct Keys
+    {
+        quint64 textHash = {0}; // Хеш нормализованного текста
+        Bands bands;            // Ключи LSH-полос
+        int length = {0};       // Длина текста в символах UTF-32
+    };
+
+    // Максимальная длина текста для пакетного (SIMD) сравнения
+    static constexpr int ShortTextLength = 64;
+
+    // Минимальный порог схожести (в процентах), для которого параметры LSH
+    // обеспечивают полноту поиска кандидатов. При меньшем пороге похожие
+    // тексты могут не иметь общих полос, поэтому сравнивать нужно со всеми
+    // текстами
+    static constexpr int MinLshThreshold = 80;
+
+    // Нормализует текст: приводит к нижнему регистру, удаляет URL-ссылки,
+    // заменяет последовательности пробельных символов одним пробелом
+    static QString normalizeText(const QString& text);
+
+    // Вычисляет 64-битный хеш нормализованного текста
+    static quint64 textHash(const QString& text);
+
+    // Вычисляет ключи полос для текста в нижнем регистре
+    static Bands textBands(const std::u32string& text);
+
+    static Keys textKeys(const QString& text);
+
+    void add(data::FuzzyText*, const Keys&);
+
+    // Добавляет все тексты индекса other. Ключи полос берутся из other
+    // без повторного вычисления
+    void addFrom(const FuzzyIndex& other);
+
+    void remove(data::FuzzyText*);
+    void clear();
+
+    int count() const {return _items.count();}
+    bool contains(data::FuzzyText* ft) const {return _items.contains(ft);}
+    QVector<data::FuzzyText*> items() const {return _items.keys().toVector();}
+
+    // Возвращает тексты, нормализованное представление которых имеет хеш
+    // textHash (точные копии)
+    QVector<data::FuzzyText*> exact(quint64 textHash) const;
+
+    // Возвращает тексты, имеющие с bands хотя бы одну общую полосу
+    QVector<data::FuzzyText*> candidates(const Bands&) const;
+
+    // Сравнивает текст text32 (в нижнем регистре) с кандидатами и возвращает
+    // тексты, оценка схожести которых превышает cutoff. Кандидаты, для  кото-
+    // рых оценка заведомо не превысит cutoff из-за разницы длин, пропускаются.
+    // Короткие тексты сравниваются пакетно с использованием SIMD
+    QVector<data::FuzzyText*> similar(const std::u32string& text32,
+                                      const QVector<data::FuzzyText*>& candidates,
+                                      double cutoff) const;
+
+private:
+    // Для текста хранятся только хеш и длина. Ключи полос (32 значения на
+    // текст) не хранятся, при удалении текста они вычисляются повторно
+    struct Item
+    {
+        quint64 textHash = {0};
+        int length = {0};
+    };
+
+    static void removeFrom(QHash<quint64, QVector<data::FuzzyText*>>&,
+                           quint64 key, data::FuzzyText*);
+
+private:
+    QHash<quint64 /*ключ полосы*/, QVector<data::FuzzyText*>> _buckets;
+    QHash<quint64 /*хеш текста*/,  QVector<data::FuzzyText*>> _exact;
+    QHash<data::FuzzyText*, Item> _items;
+};
+
+} // namespace tbot
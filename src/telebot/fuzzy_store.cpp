@@ -0,0 +1,401 @@
+#include "fuzzy_store.h"
+
+#include "shared/break_point.h"
+#include "shared/logger/logger.h"
+#include "shared/logger/format.h"
+
+#define log_error_m   alog::logger().error  (alog_line_location, "FuzzyStore")
+#define log_warn_m    alog::logger().warn   (alog_line_location, "FuzzyStore")
+#define log_info_m    alog::logger().info   (alog_line_location, "FuzzyStore")
+#define log_verbose_m alog::logger().verbose(alog_line_location, "FuzzyStore")
+#define log_debug_m   alog::logger().debug  (alog_line_location, "FuzzyStore")
+#define log_debug2_m  alog::logger().debug2 (alog_line_location, "FuzzyStore")
+
+namespace tbot {
+
+// Сигнатура файла журнала: 'TBFZ'
+static const quint32 storeMagic = 0x5442465A;
+
+// Версия формата журнала, должна увеличиваться при любом изменении состава
+// сохраняемых полей
+static const quint32 storeFormat = 1;
+
+// Журнал уплотняется когда количество записей превышает удвоенное количество
+// текстов более чем на это значение
+static const qint64 compactReserve = 1000;
+
+enum class RecordType : quint8
+{
+    Add    = 1,
+    Update = 2,
+    Remove = 3
+};
+
+static QByteArray addRecord(const data::FuzzyText* ft)
+{
+    QByteArray record;
+    QDataStream s {&record, QIODevice::WriteOnly};
+    s.setVersion(QDATASTREAM_VERSION);
+    s << quint8(RecordType::Add) << ft->chatId << ft->messageId;
+
+    s << bool(ft->user);
+    if (ft->user)
+        s << ft->user->id
+          << ft->user->is_bot
+          << ft->user->first_name
+          << ft->user->last_name
+          << ft->user->username
+          << ft->user->is_premium;
+
+    s << ft->text
+      << ft->spam
+      << ft->time
+      << ft->timeLife.load()
+      << ft->messageDel.load();
+    return record;
+}
+
+static qint64 userId(const data::FuzzyText* ft)
+{
+    return (ft->user) ? ft->user->id : 0;
+}
+
+static QByteArray updateRecord(const data::FuzzyText* ft)
+{
+    QByteArray record;
+    QDataStream s {&record, QIODevice::WriteOnly};
+    s.setVersion(QDATASTREAM_VERSION);
+    s << quint8(RecordType::Update) << ft->chatId << ft->messageId
+      << ft->spam
+      << ft->timeLife.load()
+      << ft->messageDel.load();
+    return record;
+}
+
+static QByteArray removeRecord(qint64 chatId, qint32 messageId)
+{
+    QByteArray record;
+    QDataStream s {&record, QIODevice::WriteOnly};
+    s.setVersion(QDATASTREAM_VERSION);
+    s << quint8(RecordType::Remove) << chatId << messageId;
+    return record;
+}
+
+void FuzzyStore::remember(const data::FuzzyText* ft)
+{
+    State state;
+    state.userId = userId(ft);
+    state.textHash = qHash(ft->text);
+    state.time = ft->time;
+    state.timeLife = ft->timeLife;
+    state.spam = ft->spam;
+    state.messageDel = ft->messageDel;
+    _states.insert(Key {ft->chatId, ft->messageId}, state);
+}
+
+bool FuzzyStore::loadJson(const QByteArray& content, data::FuzzyText::List& list)
+{
+    data::FuzzyTextSerialize serialize;
+    if (!serialize.fromJson(content))
+        return false;
+
+    list.swap(serialize.items);
+    return true;
+}
+
+bool FuzzyStore::load(const QString& fileName, data::FuzzyText::List& list)
+{
+    _states.clear();
+    _recordCount = 0;
+    _compactNeeded = true;
+
+    QFile file {fileName};
+    if (!file.exists())
+    {
+        log_warn_m << "Fuzzy-Text state file not exists " << fileName;
+        return false;
+    }
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        log_error_m << "Failed open Fuzzy-Text state file in read-only mode"
+                    << ". File: " << fileName;
+        return false;
+    }
+
+    const qint64 fileSize = file.size();
+    if (fileSize == 0)
+        return false;
+
+    uchar* mem = file.map(0, fileSize);
+    if (mem == nullptr)
+    {
+        log_error_m << "Failed map Fuzzy-Text state file: " << fileName
+                    << ". Error: " << file.errorString();
+        return false;
+    }
+    QByteArray content = QByteArray::fromRawData((const char*)mem, int(fileSize));
+
+    // Файл в формате предыдущих версий
+    if (content.startsWith('{'))
+    {
+        if (!loadJson(QByteArray(content.constData(), content.size()), list))
+        {
+            log_error_m << "Failed deserialize Fuzzy-Text data from file " << fileName;
+            return false;
+        }
+        for (data::FuzzyText* ft : list)
+            remember(ft);
+
+        log_verbose_m << log_format(
+            "Fuzzy-Text state loaded from JSON file: %?. Texts: %?",
+            fileName, list.count());
+        return true;
+    }
+
+    QDataStream s {content};
+    s.setVersion(QDATASTREAM_VERSION);
+
+    quint32 magic, format;
+    s >> magic >> format;
+
+    if ((magic != storeMagic) || (format != storeFormat))
+    {
+        log_error_m << "Fuzzy-Text state file has unknown format: " << fileName;
+        return false;
+    }
+
+    QHash<Key, data::FuzzyText::Ptr> texts;
+    QHash<qint64, tbot::User::Ptr> users;
+
+    bool truncated = false;
+    bool skipped = false;
+    while (!s.atEnd())
+    {
+        QByteArray record;
+        s >> record;
+        if (s.status() != QDataStream::Ok)
+        {
+            // Последняя запись могла быть записана не полностью
+            truncated = true;
+            break;
+        }
+        ++_recordCount;
+
+        QDataStream r {record};
+        r.setVersion(QDATASTREAM_VERSION);
+
+        quint8 type;
+        Key key;
+        r >> type >> key.first >> key.second;
+
+        if (type == quint8(RecordType::Add))
+        {
+            data::FuzzyText::Ptr ft = data::FuzzyText::Ptr::create();
+            ft->chatId = key.first;
+            ft->messageId = key.second;
+
+            bool hasUser;
+            r >> hasUser;
+            if (hasUser)
+            {
+                tbot::User::Ptr user = tbot::User::Ptr::create();
+                r >> user->id
+                  >> user->is_bot
+                  >> user->first_name
+                  >> user->last_name
+                  >> user->username
+                  >> user->is_premium;
+
+                tbot::User::Ptr& u = users[user->id];
+                if (u.empty())
+                    u = user;
+                ft->user = u;
+            }
+
+            qint64 timeLife;
+            bool messageDel;
+            r >> ft->text
+              >> ft->spam
+              >> ft->time
+              >> timeLife
+              >> messageDel;
+            ft->timeLife = timeLife;
+            ft->messageDel = messageDel;
+
+            // Текст без пользователя не может быть добавлен в список
+            // FuzzyTextList, запись пропускается
+            if (!hasUser)
+            {
+                log_warn_m << log_format(
+                    "Fuzzy-Text record without user is skipped. Chat/Msg: %?/%?",
+                    key.first, key.second);
+                texts.remove(key);
+                skipped = true;
+            }
+            else
+                texts.insert(key, ft);
+        }
+        else if (type == quint8(RecordType::Update))
+        {
+            bool spam, messageDel;
+            qint64 timeLife;
+            r >> spam >> timeLife >> messageDel;
+
+            if (data::FuzzyText::Ptr ft = texts.value(key))
+            {
+                ft->spam = spam;
+                ft->timeLife = timeLife;
+                ft->messageDel = messageDel;
+            }
+        }
+        else if (type == quint8(RecordType::Remove))
+        {
+            texts.remove(key);
+        }
+
+        if (r.status() != QDataStream::Ok)
+        {
+            log_error_m << "Fuzzy-Text state file contains corrupted record: "
+                        << fileName;
+            truncated = true;
+            break;
+        }
+    }
+
+    for (const data::FuzzyText::Ptr& ft : texts)
+    {
+        ft->add_ref();
+        list.add(ft.get());
+        remember(ft.get());
+    }
+
+    // Поврежденный журнал (или журнал с пропущенными записями) будет
+    // перезаписан при следующем сохранении
+    _compactNeeded = truncated || skipped;
+    if (truncated)
+        log_warn_m << "Fuzzy-Text state file is truncated: " << fileName;
+
+    log_verbose_m << log_format(
+        "Fuzzy-Text state loaded: %?. Texts: %?, records: %?",
+        fileName, list.count(), _recordCount);
+    return true;
+}
+
+bool FuzzyStore::save(const QString& fileName, const data::FuzzyText::List& list)
+{
+    if (_compactNeeded || !QFile::exists(fileName))
+        return compact(fileName, list);
+
+    QByteArray buff;
+    QDataStream s {&buff, QIODevice::WriteOnly};
+    s.setVersion(QDATASTREAM_VERSION);
+
+    int added = 0, updated = 0, removed = 0;
+
+    QSet<Key> keys;
+    keys.reserve(list.count());
+    for (const data::FuzzyText* ft : list)
+    {
+        const Key key {ft->chatId, ft->messageId};
+        keys.insert(key);
+
+        auto it = _states.constFind(key);
+        if ((it == _states.constEnd())
+            || (it->time != ft->time)
+            || (it->userId != userId(ft))
+            || (it->textHash != qHash(ft->text)))
+        {
+            s << addRecord(ft);
+            remember(ft);
+            ++added;
+        }
+        else if ((it->spam != ft->spam)
+                 || (it->timeLife != ft->timeLife)
+                 || (it->messageDel != ft->messageDel))
+        {
+            s << updateRecord(ft);
+            remember(ft);
+            ++updated;
+        }
+    }
+    for (auto it = _states.begin(); it != _states.end();)
+    {
+        if (keys.contains(it.key()))
+        {
+            ++it;
+            continue;
+        }
+        s << removeRecord(it.key().first, it.key().second);
+        it = _states.erase(it);
+        ++removed;
+    }
+
+    const int count = added + updated + removed;
+    if (count == 0)
+        return true;
+
+    if (_recordCount + count > 2 * qint64(list.count()) + compactReserve)
+        return compact(fileName, list);
+
+    QFile file {fileName};
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+        log_error_m << "Failed open Fuzzy-Text state file in append mode"
+                    << ". File: " << fileName;
+        _compactNeeded = true;
+        return false;
+    }
+    if (file.write(buff) != buff.size() || !file.flush())
+    {
+        log_error_m << "Failed write Fuzzy-Text state file: " << fileName
+                    << ". Error: " << file.errorString();
+        _compactNeeded = true;
+        return false;
+    }
+    _recordCount += count;
+
+    log_debug_m << log_format(
+        "Fuzzy-Text state saved. Added/updated/removed: %?/%?/%?. Bytes: %?",
+        added, updated, removed, buff.size());
+    return true;
+}
+
+bool FuzzyStore::compact(const QString& fileName, const data::FuzzyText::List& list)
+{
+    _states.clear();
+    _compactNeeded = true;
+
+    QSaveFile file {fileName};
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        log_error_m << "Failed open Fuzzy-Text state file in write mode"
+                    << ". File: " << fileName;
+        return false;
+    }
+
+    QDataStream s {&file};
+    s.setVersion(QDATASTREAM_VERSION);
+    s << storeMagic << storeFormat;
+
+    for (const data::FuzzyText* ft : list)
+    {
+        s << addRecord(ft);
+        remember(ft);
+    }
+
+    if (s.status() != QDataStream::Ok || !file.commit())
+    {
+        log_error_m << "Failed save Fuzzy-Text state file: " << fileName;
+        _states.clear();
+        return false;
+    }
+    _recordCount = list.count();
+    _compactNeeded = false;
+
+    log_verbose_m << log_format("Fuzzy-Text state file compacted: %?. Texts: %?",
+                                fileName, list.count());
+    return true;
+}
+
+} // namespace tbot
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "commands/commands.h"
+
+#include <QtCore>
+
+namespace tbot {
+
+/**
+  Хранилище списка FuzzyText в виде бинарного журнала,  в  который  только
+  дописываются записи: добавление текста, изменение его состояния (признаки
+  spam, messageDel, время жизни) и удаление текста. При сохранении в журнал
+  записываются только изменения относительно предыдущего сохранения, поэтому
+  объем записи пропорционален количеству изменений, а не размеру списка.
+
+  Когда количество записей журнала существенно превышает количество текстов,
+  журнал уплотняется: файл перезаписывается и содержит только добавления
+  актуальных текстов.
+
+  Файл в формате предыдущих версий (JSON) загружается, при первом сохранении
+  он будет заменен бинарным журналом
+*/
+class FuzzyStore
+{
+public:
+    // Загружает тексты из файла. Журнал читается через отображение файла
+    // в память, кеш для нечеткого сравнения и индекс здесь не создаются
+    bool load(const QString& fileName, data::FuzzyText::List&);
+
+    // Записывает в журнал изменения списка, сделанные после предыдущего
+    // сохранения или загрузки
+    bool save(const QString& fileName, const data::FuzzyText::List&);
+
+private:
+    typedef QPair<qint64 /*chat id*/, qint32 /*message id*/> Key;
+
+    // Состояние текста, записанное в журнал. Текст идентифицируется по
+    // значениям (чат, сообщение, пользователь, время, хеш текста), а не по
+    // адресу структуры FuzzyText: после удаления текста по этому адресу
+    // может быть размещен другой текст с тем же ключом
+    struct State
+    {
+        qint64 userId = {0};
+        uint textHash = {0};
+        qint64 time = {0};
+        qint64 timeLife = {0};
+        bool spam = {false};
+        bool messageDel = {false};
+    };
+
+    bool compact(const QString& fileName, const data::FuzzyText::List&);
+    void remember(const data::FuzzyText*);
+
+    bool loadJson(const QByteArray& content, data::FuzzyText::List&);
+
+private:
+    QHash<Key, State> _states;
+
+    // Количество записей в журнале
+    qint64 _recordCount = {0};
+
+    // Файл необходимо перезаписать целиком (журнал отсутствует или имеет
+    // формат предыдущей версии)
+    bool _compactNeeded = {true};
+};
+
+} // namespace tbot
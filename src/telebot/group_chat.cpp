@@ -5,6 +5,7 @@
 #include "shared/logger/format.h"
 
 #include <string>
+#include <exception>
 #include <stdexcept>
 
 #define log_error_m   alog::logger().error  (alog_line_location, "GroupChat")
@@ -35,55 +36,55 @@ void GroupChat::setName(const QString& val)
     _name = val;
 }
 
-QSet<qint64> GroupChat::adminIds() const
+GroupChat::Runtime::Ptr GroupChat::runtime() const
 {
-    QMutexLocker locker {&_lock}; (void) locker;
-    return _adminIds;
+    return std::atomic_load(&_runtime);
 }
 
-void GroupChat::setAdminIds(const QSet<qint64>& val)
+template<typename Func>
+void GroupChat::updateRuntime(Func&& func)
 {
-    QMutexLocker locker {&_lock}; (void) locker;
-    _adminIds = val;
-}
-
-QSet<qint64> GroupChat::ownerIds() const
-{
-    QMutexLocker locker {&_lock}; (void) locker;
-    return _ownerIds;
-}
+    Runtime::Ptr current = std::atomic_load(&_runtime);
+    while (true)
+    {
+        auto runtime = std::make_shared<Runtime>(*current);
+        func(*runtime);
+        runtime->version = current->version + 1;
 
-void GroupChat::setOwnerIds(const QSet<qint64>& val)
-{
-    QMutexLocker locker {&_lock}; (void) locker;
-    _ownerIds = val;
+        if (std::atomic_compare_exchange_weak(&_runtime, &current,
+                                              Runtime::Ptr(std::move(runtime))))
+            break;
+    }
 }
 
-QStringList GroupChat::adminNames() const
+void GroupChat::setAdmins(const QSet<qint64>& adminIds, const QSet<qint64>& ownerIds,
+                          const QStringList& adminNames,
+                          const ChatMemberAdministrator::Ptr& botInfo)
 {
-    QMutexLocker locker {&_lock}; (void) locker;
-    return _adminNames;
+    updateRuntime([&](Runtime& runtime)
+    {
+        runtime.adminIds = adminIds;
+        runtime.ownerIds = ownerIds;
+        runtime.adminNames = adminNames;
+        runtime.botInfo = botInfo;
+    });
 }
 
-void GroupChat::setAdminNames(const QStringList& val)
+bool GroupChat::antiRaidTurnOn() const
 {
-    QMutexLocker locker {&_lock}; (void) locker;
-    _adminNames = val;
+    return runtime()->antiRaidTurnOn;
 }
 
-ChatMemberAdministrator::Ptr GroupChat::botInfo() const
+void GroupChat::setAntiRaidTurnOn(bool val)
 {
-    QMutexLocker locker {&_lock}; (void) locker;
-    return _botInfo;
-}
+    if (runtime()->antiRaidTurnOn == val)
+        return;
 
-void GroupChat::setBotInfo(const ChatMemberAdministrator::Ptr& val)
-{
-    QMutexLocker locker {&_lock}; (void) locker;
-    _botInfo = val;
+    updateRuntime([val](Runtime& runtime) {runtime.antiRaidTurnOn = val;});
 }
 
-GroupChat::Ptr createGroupChat(const YAML::Node& ychat)
+GroupChat::Ptr createGroupChat(const YAML::Node& ychat,
+                               const QHash<QString, Trigger*>& triggers)
 {
     auto checkFiedType = [](const YAML::Node& ynode, const string& field,
                             YAML::NodeType::value type)
@@ -272,13 +273,10 @@ GroupChat::Ptr createGroupChat(const YAML::Node& ychat)
     chat->joinViaChatFolder = joinViaChatFolder;
     chat->antiRaid = antiRaid;
 
-    Trigger::List triggers = tbot::triggers();
     for (const QString& triggerName : triggerNames)
     {
-        lst::FindResult fr = triggers.findRef(triggerName, {lst::BruteForce::Yes});
-        if (fr.success())
+        if (Trigger* t = triggers.value(triggerName))
         {
-            Trigger* t = triggers.item(fr.index());
             t->add_ref();
             chat->triggers.add(t);
         }
@@ -292,10 +290,19 @@ GroupChat::Ptr createGroupChat(const YAML::Node& ychat)
     return chat;
 }
 
-bool loadGroupChats(GroupChat::List& chats, const YamlConfig& config)
+bool loadGroupChats(GroupChat::List& chats, const YamlConfig& config,
+                    Trigger::List& triggers, GroupChat::List* prevChats,
+                    LoadStat* stat)
 {
     auto locker {config.locker()}; (void) locker;
 
+    QHash<QString, Trigger*> triggersMap;
+    for (Trigger* t : triggers)
+        triggersMap.insert(t->name, t);
+
+    if (prevChats && (prevChats->sortState() != lst::SortState::Up))
+        prevChats->sort();
+
     bool result = false;
     try
     {
@@ -306,11 +313,67 @@ bool loadGroupChats(GroupChat::List& chats, const YamlConfig& config)
         if (!ychats.IsSequence())
             throw std::logic_error("'group_chats' node must have sequence type");
 
+        // Описание группы для этапа создания
+        struct Entry
+        {
+            YAML::Node ychat;
+            QByteArray yamlHash;
+            GroupChat::Ptr chat;
+            std::exception_ptr error;
+        };
+        QVector<Entry> entries;
+
         for (const YAML::Node& ychat : ychats)
             try
             {
-                if (GroupChat::Ptr c = createGroupChat(ychat))
-                    chats.add(c.detach());
+                // Хеш группы включает хеши её триггеров, так как изменение
+                // триггера требует пересоздания группы
+                QCryptographicHash hash {QCryptographicHash::Sha1};
+                hash.addData(yamlNodeHash(ychat));
+
+                qint64 id = 0;
+                if (ychat["id"].IsScalar())
+                    id = ychat["id"].as<int64_t>();
+
+                if (ychat["triggers"].IsSequence())
+                    for (const YAML::Node& ytrigger : ychat["triggers"])
+                        if (Trigger* t = triggersMap.value(QString::fromStdString(ytrigger.as<string>())))
+                            hash.addData(t->yamlHash);
+
+                QByteArray yamlHash = hash.result();
+
+                GroupChat* prevChat = (prevChats) ? prevChats->findItem(&id) : nullptr;
+                if (prevChat && (prevChat->yamlHash == yamlHash))
+                {
+                    prevChat->add_ref();
+                    chats.add(prevChat);
+                    if (stat)
+                        ++stat->reused;
+                    continue;
+                }
+
+                // Копия узла нужна для независимого чтения YAML из потоков пула
+                Entry entry;
+                entry.ychat = YAML::Clone(ychat);
+                entry.yamlHash = yamlHash;
+                entries.append(entry);
+            }
+            catch (group_logic_error& e)
+            {
+                log_error_m << "Group configure error. Detail: " << e.what()
+                            << ". Config file: " << config.filePath();
+                ++globalConfigParceErrors;
+            }
+
+        // Группы не зависят друг от друга и создаются параллельно
+        parallelFor(entries.count(), [&](int i)
+        {
+            Entry& entry = entries[i];
+            try
+            {
+                entry.chat = createGroupChat(entry.ychat, triggersMap);
+                if (!entry.chat.empty())
+                    entry.chat->yamlHash = entry.yamlHash;
             }
             catch (group_logic_error& e)
             {
@@ -318,6 +381,24 @@ bool loadGroupChats(GroupChat::List& chats, const YamlConfig& config)
                             << ". Config file: " << config.filePath();
                 ++globalConfigParceErrors;
             }
+            catch (...)
+            {
+                entry.error = std::current_exception();
+            }
+        });
+
+        for (Entry& entry : entries)
+        {
+            if (entry.error)
+                std::rethrow_exception(entry.error);
+
+            if (!entry.chat.empty())
+            {
+                chats.add(entry.chat.detach());
+                if (stat)
+                    ++stat->rebuilt;
+            }
+        }
 
         chats.sort();
         result = true;
@@ -427,12 +508,8 @@ GroupChat::List groupChats(GroupChat::List* list)
         // обновлен через 1-2 секунды
         for (GroupChat* oldChat : *list)
         {
-            QString       chatName               = oldChat->name();
-            QSet<qint64>  adminIds               = oldChat->adminIds();
-            QSet<qint64>  ownerIds               = oldChat->ownerIds();
-            QStringList   adminNames             = oldChat->adminNames();
-            bool          antiRaidTurnOn         = oldChat->antiRaidTurnOn;
-            ChatMemberAdministrator::Ptr botInfo = oldChat->botInfo();
+            QString chatName = oldChat->name();
+            GroupChat::Runtime::Ptr runtime = oldChat->runtime();
 
             if (GroupChat* newChat = chats.findItem(&oldChat->id))
             {
@@ -445,26 +522,31 @@ GroupChat::List groupChats(GroupChat::List* list)
                 if (!chatName.isEmpty())
                     newChat->setName(chatName);
 
+                QSet<qint64> adminIds = runtime->adminIds;
                 if (!adminIds.isEmpty())
                 {
                     if (newChat->anonymousAsAdmin)
                         adminIds.insert(GROUP_ANONYMOUS_BOT_ID);
                     else
                         adminIds.remove(GROUP_ANONYMOUS_BOT_ID);
-
-                    newChat->setAdminIds(adminIds);
                 }
 
-                if (!ownerIds.isEmpty())
-                    newChat->setOwnerIds(ownerIds);
+                newChat->updateRuntime([&](GroupChat::Runtime& newRuntime)
+                {
+                    if (!adminIds.isEmpty())
+                        newRuntime.adminIds = adminIds;
+
+                    if (!runtime->ownerIds.isEmpty())
+                        newRuntime.ownerIds = runtime->ownerIds;
 
-                if (!adminNames.isEmpty())
-                    newChat->setAdminNames(adminNames);
+                    if (!runtime->adminNames.isEmpty())
+                        newRuntime.adminNames = runtime->adminNames;
 
-                newChat->antiRaidTurnOn = antiRaidTurnOn;
+                    if (runtime->botInfo)
+                        newRuntime.botInfo = runtime->botInfo;
 
-                if (botInfo)
-                    newChat->setBotInfo(botInfo);
+                    newRuntime.antiRaidTurnOn = runtime->antiRaidTurnOn;
+                });
             }
         }
     }
@@ -3,6 +3,7 @@
 #include "commands/compare.h"
 #include "trigger.h"
 #include <atomic>
+#include <memory>
 
 namespace tbot {
 
@@ -19,6 +20,10 @@ public:
     // Идентификатор группового чата
     qint64 id = {0};
 
+    // Хеш YAML-описания группы (с учетом хешей её триггеров). Используется
+    // для повторного использования группы при перезагрузке конфигурации
+    QByteArray yamlHash;
+
     // Информационная подпись для чата, используется при выводе в лог
     QString name() const;
     void setName(const QString&);
@@ -106,40 +111,71 @@ public:
     };
     AntiRaid antiRaid;
 
-    // Признак включенного режима Anti-Raid
-    atomic_bool antiRaidTurnOn = {false};
+    // Состояние группы, получаемое от Телеграм в процессе работы бота.
+    // Структура не изменяется после публикации: при обновлении создается
+    // новая копия, которая атомарно подменяет предыдущую. Это позволяет
+    // читать состояние из потоков обработки без блокировок и без копирования
+    // контейнеров
+    struct Runtime
+    {
+        typedef std::shared_ptr<const Runtime> Ptr;
+
+        // Версия состояния, увеличивается при каждом обновлении
+        quint64 version = {0};
 
-    // Список идентификаторов администраторов группы
-    QSet<qint64> adminIds() const;
-    void setAdminIds(const QSet<qint64>&);
+        // Список идентификаторов администраторов группы
+        QSet<qint64> adminIds;
 
-    // Список идентификаторов владельцев группы
-    QSet<qint64> ownerIds() const;
-    void setOwnerIds(const QSet<qint64>&);
+        // Список идентификаторов владельцев группы
+        QSet<qint64> ownerIds;
 
-    // Список username администраторов группы
-    QStringList adminNames() const;
-    void setAdminNames(const QStringList&);
+        // Список username администраторов группы
+        QStringList adminNames;
+
+        // Информация о правах Tele-бота в группе
+        ChatMemberAdministrator::Ptr botInfo;
+
+        // Признак включенного режима Anti-Raid
+        bool antiRaidTurnOn = {false};
+    };
 
-    // Информация о правах Tele-бота в группе
-    ChatMemberAdministrator::Ptr botInfo() const;
-    void setBotInfo(const ChatMemberAdministrator::Ptr&);
+    // Текущее состояние группы
+    Runtime::Ptr runtime() const;
+
+    // Атомарно заменяет сведения об администраторах, владельцах группы
+    // и о правах бота
+    void setAdmins(const QSet<qint64>& adminIds, const QSet<qint64>& ownerIds,
+                   const QStringList& adminNames,
+                   const ChatMemberAdministrator::Ptr& botInfo);
+
+    // Признак включенного режима Anti-Raid
+    bool antiRaidTurnOn() const;
+    void setAntiRaidTurnOn(bool);
 
     typedef lst::List<GroupChat, CompareId<GroupChat>, clife_alloc_ref<GroupChat>> List;
 
 private:
     DISABLE_DEFAULT_COPY(GroupChat)
 
+    friend GroupChat::List groupChats(GroupChat::List*);
+
+    template<typename Func>
+    void updateRuntime(Func&&);
+
     QString _name;
-    QSet<qint64> _adminIds;
-    QSet<qint64> _ownerIds;
-    QStringList  _adminNames;
-    ChatMemberAdministrator::Ptr _botInfo;
+
+    // Доступ к полю выполняется только через функции std::atomic_load()
+    // и std::atomic_compare_exchange_weak()
+    Runtime::Ptr _runtime = {std::make_shared<const Runtime>()};
 
     mutable QMutex _lock {QMutex::Recursive};
 };
 
-bool loadGroupChats(GroupChat::List&, const YamlConfig&);
+// Ссылки на триггеры разрешаются по списку triggers. Если задан список
+// prevChats, то группы с неизмененным YAML-описанием не создаются заново,
+// а берутся из этого списка
+bool loadGroupChats(GroupChat::List&, const YamlConfig&, Trigger::List& triggers,
+                    GroupChat::List* prevChats = nullptr, LoadStat* = nullptr);
 void printGroupChats(GroupChat::List&);
 
 GroupChat::List groupChats(GroupChat::List* = nullptr);
@@ -0,0 +1,509 @@
+#include "groups_cache.h"
+
+#include "shared/break_point.h"
+#include "shared/logger/logger.h"
+#include "shared/logger/format.h"
+
+#define log_error_m   alog::logger().error  (alog_line_location, "GroupsCache")
+#define log_warn_m    alog::logger().warn   (alog_line_location, "GroupsCache")
+#define log_info_m    alog::logger().info   (alog_line_location, "GroupsCache")
+#define log_verbose_m alog::logger().verbose(alog_line_location, "GroupsCache")
+#define log_debug_m   alog::logger().debug  (alog_line_location, "GroupsCache")
+#define log_debug2_m  alog::logger().debug2 (alog_line_location, "GroupsCache")
+
+namespace tbot {
+
+// Сигнатура файла кеша: 'TBGC'
+static const quint32 cacheMagic = 0x54424743;
+
+// Версия формата кеша, должна увеличиваться при любом изменении состава
+// сохраняемых полей
+static const quint32 cacheFormat = 2;
+
+// Идентификатор сборки программы. Кеш, сохраненный другой сборкой,  не
+// используется: изменение разбора конфигурации или сериализации могло
+// остаться без увеличения cacheFormat
+static QByteArray buildId()
+{
+    return QByteArray(VERSION_PROJECT) + "-" + QByteArray(GIT_REVISION);
+}
+
+QDataStream& operator<< (QDataStream& s, const TriggerLinkBase::ItemLink& item)
+{
+    return s << item.host << item.paths;
+}
+
+QDataStream& operator>> (QDataStream& s, TriggerLinkBase::ItemLink& item)
+{
+    return s >> item.host >> item.paths;
+}
+
+QDataStream& operator<< (QDataStream& s, const TriggerTimeLimit::TimeRange& time)
+{
+    return s << time.begin << time.end << time.hint;
+}
+
+QDataStream& operator>> (QDataStream& s, TriggerTimeLimit::TimeRange& time)
+{
+    return s >> time.begin >> time.end >> time.hint;
+}
+
+QDataStream& operator<< (QDataStream& s, const TriggerTimeLimit::Day& day)
+{
+    return s << day.times << day.daysOfWeek;
+}
+
+QDataStream& operator>> (QDataStream& s, TriggerTimeLimit::Day& day)
+{
+    return s >> day.times >> day.daysOfWeek;
+}
+
+QDataStream& operator<< (QDataStream& s, const TriggerBlackUser::Group& group)
+{
+    return s << group.description << group.userIds << group.chatIds;
+}
+
+QDataStream& operator>> (QDataStream& s, TriggerBlackUser::Group& group)
+{
+    return s >> group.description >> group.userIds >> group.chatIds;
+}
+
+static void writeRegexpList(QDataStream& s, const QList<QRegularExpression>& list)
+{
+    s << qint32(list.count());
+    for (const QRegularExpression& re : list)
+        s << re.pattern() << quint32(re.patternOptions());
+}
+
+static void readRegexpList(QDataStream& s, QList<QRegularExpression>& list)
+{
+    qint32 count;
+    s >> count;
+    for (qint32 i = 0; (i < count) && (s.status() == QDataStream::Ok); ++i)
+    {
+        QString pattern;
+        quint32 options;
+        s >> pattern >> options;
+
+        // Шаблоны прошли проверку при загрузке из YAML, поэтому здесь
+        // вызов isValid() не выполняется (это привело бы к немедленной
+        // компиляции выражения)
+        list.append(QRegularExpression(
+            pattern, QRegularExpression::PatternOptions(options)));
+    }
+}
+
+static void writeTrigger(QDataStream& s, const Trigger* trigger)
+{
+    s << trigger->type
+      << trigger->name
+      << trigger->yamlHash
+      << trigger->active
+      << trigger->description
+      << trigger->skipAdmins
+      << trigger->whiteUsers
+      << trigger->inverse
+      << trigger->checkBio
+      << trigger->onlyBio
+      << trigger->reportSpam
+      << trigger->newUserBan
+      << trigger->premiumBan
+      << trigger->immediatelyBan;
+
+    if (const TriggerLinkBase* t = dynamic_cast<const TriggerLinkBase*>(trigger))
+    {
+        s << t->whiteList << t->blackList;
+    }
+    else if (const TriggerWord* t = dynamic_cast<const TriggerWord*>(trigger))
+    {
+        s << t->caseInsensitive << t->wordList;
+    }
+    else if (const TriggerRegexp* t = dynamic_cast<const TriggerRegexp*>(trigger))
+    {
+        s << t->caseInsensitive << t->multiline << t->analyze;
+        writeRegexpList(s, t->regexpRemove);
+        writeRegexpList(s, t->regexpList);
+    }
+    else if (const TriggerFuzzy* t = dynamic_cast<const TriggerFuzzy*>(trigger))
+    {
+        s << qint32(t->threshold) << t->templateList;
+    }
+    else if (const TriggerTimeLimit* t = dynamic_cast<const TriggerTimeLimit*>(trigger))
+    {
+        s << qint32(t->utc)
+          << t->week
+          << t->messageBegin
+          << t->messageEnd
+          << t->messageInfo
+          << t->hideMessageBegin
+          << t->hideMessageEnd;
+    }
+    else if (const TriggerBlackUser* t = dynamic_cast<const TriggerBlackUser*>(trigger))
+    {
+        s << t->groups;
+    }
+    else if (const TriggerEmptyText* t = dynamic_cast<const TriggerEmptyText*>(trigger))
+    {
+        s << qint32(t->userLimit.time) << t->userLimit.threshId << t->userLimit.premium;
+    }
+    else if (const TriggerBigId* t = dynamic_cast<const TriggerBigId*>(trigger))
+    {
+        s << qint32(t->userLimit.time) << t->userLimit.threshId;
+    }
+}
+
+static Trigger::Ptr readTrigger(QDataStream& s)
+{
+    QString type;
+    s >> type;
+
+    Trigger::Ptr trigger;
+
+    if ((type == "link") || (type == "link_disable"))
+        trigger = Trigger::Ptr(new TriggerLinkDisable);
+    else if (type == "link_enable")
+        trigger = Trigger::Ptr(new TriggerLinkEnable);
+    else if (type == "word")
+        trigger = Trigger::Ptr(new TriggerWord);
+    else if (type == "regexp")
+        trigger = Trigger::Ptr(new TriggerRegexp);
+    else if (type == "fuzzy")
+        trigger = Trigger::Ptr(new TriggerFuzzy);
+    else if (type == "timelimit")
+        trigger = Trigger::Ptr(new TriggerTimeLimit);
+    else if (type == "blackuser")
+        trigger = Trigger::Ptr(new TriggerBlackUser);
+    else if (type == "emptytext")
+        trigger = Trigger::Ptr(new TriggerEmptyText);
+    else if (type == "big_id")
+        trigger = Trigger::Ptr(new TriggerBigId);
+
+    if (trigger.empty())
+    {
+        log_error_m << "Unknown trigger type in cache: " << type;
+        return {};
+    }
+
+    trigger->type = type;
+    s >> trigger->name
+      >> trigger->yamlHash
+      >> trigger->active
+      >> trigger->description
+      >> trigger->skipAdmins
+      >> trigger->whiteUsers
+      >> trigger->inverse
+      >> trigger->checkBio
+      >> trigger->onlyBio
+      >> trigger->reportSpam
+      >> trigger->newUserBan
+      >> trigger->premiumBan
+      >> trigger->immediatelyBan;
+
+    if (TriggerLinkBase* t = dynamic_cast<TriggerLinkBase*>(trigger.get()))
+    {
+        s >> t->whiteList >> t->blackList;
+    }
+    else if (TriggerWord* t = dynamic_cast<TriggerWord*>(trigger.get()))
+    {
+        s >> t->caseInsensitive >> t->wordList;
+    }
+    else if (TriggerRegexp* t = dynamic_cast<TriggerRegexp*>(trigger.get()))
+    {
+        s >> t->caseInsensitive >> t->multiline >> t->analyze;
+        readRegexpList(s, t->regexpRemove);
+        readRegexpList(s, t->regexpList);
+    }
+    else if (TriggerFuzzy* t = dynamic_cast<TriggerFuzzy*>(trigger.get()))
+    {
+        qint32 threshold;
+        s >> threshold >> t->templateList;
+        t->threshold = threshold;
+        t->updateIndex();
+    }
+    else if (TriggerTimeLimit* t = dynamic_cast<TriggerTimeLimit*>(trigger.get()))
+    {
+        qint32 utc;
+        s >> utc
+          >> t->week
+          >> t->messageBegin
+          >> t->messageEnd
+          >> t->messageInfo
+          >> t->hideMessageBegin
+          >> t->hideMessageEnd;
+        t->utc = utc;
+        t->updateWeekTable();
+    }
+    else if (TriggerBlackUser* t = dynamic_cast<TriggerBlackUser*>(trigger.get()))
+    {
+        s >> t->groups;
+    }
+    else if (TriggerEmptyText* t = dynamic_cast<TriggerEmptyText*>(trigger.get()))
+    {
+        qint32 time;
+        s >> time >> t->userLimit.threshId >> t->userLimit.premium;
+        t->userLimit.time = time;
+    }
+    else if (TriggerBigId* t = dynamic_cast<TriggerBigId*>(trigger.get()))
+    {
+        qint32 time;
+        s >> time >> t->userLimit.threshId;
+        t->userLimit.time = time;
+    }
+    return trigger;
+}
+
+// Триггеры с одинаковыми данными для сопоставления текста (как правило базовый
+// и производные от него) используют общие экземпляры списков
+static void shareMatchData(Trigger* trigger, const Trigger* other)
+{
+    if (TriggerWord* t = dynamic_cast<TriggerWord*>(trigger))
+    {
+        if (const TriggerWord* o = dynamic_cast<const TriggerWord*>(other))
+            t->wordList = o->wordList;
+    }
+    else if (TriggerRegexp* t = dynamic_cast<TriggerRegexp*>(trigger))
+    {
+        if (const TriggerRegexp* o = dynamic_cast<const TriggerRegexp*>(other))
+        {
+            t->regexpRemove = o->regexpRemove;
+            t->regexpList = o->regexpList;
+        }
+    }
+    else if (TriggerFuzzy* t = dynamic_cast<TriggerFuzzy*>(trigger))
+    {
+        if (const TriggerFuzzy* o = dynamic_cast<const TriggerFuzzy*>(other))
+        {
+            t->templateList = o->templateList;
+            t->shareIndex(*o);
+        }
+    }
+}
+
+static void writeGroupChat(QDataStream& s, GroupChat* chat,
+                           const QHash<const Trigger*, qint32>& triggerIndexes)
+{
+    s << chat->id
+      << chat->yamlHash
+      << chat->name();
+
+    s << qint32(chat->triggers.count());
+    for (Trigger* trigger : chat->triggers)
+        s << triggerIndexes.value(trigger, -1);
+
+    s << chat->skipAdmins
+      << chat->premiumBan
+      << chat->checkBio;
+
+    s << qint32(chat->whiteUsers.count());
+    for (GroupChat::WhiteUser* wu : chat->whiteUsers)
+        s << wu->userId << wu->info;
+
+    s << chat->userSpamLimit
+      << chat->newUserMute
+      << chat->anonymousAsAdmin
+      << chat->removeJoinMessage
+      << chat->joinViaChatFolder.ban
+      << chat->joinViaChatFolder.restrict_
+      << chat->joinViaChatFolder.mute
+      << chat->joinViaChatFolder.reportSpam
+      << chat->userRestricts
+      << chat->antiRaid.active
+      << qint32(chat->antiRaid.timeFrame)
+      << qint32(chat->antiRaid.usersLimit)
+      << qint32(chat->antiRaid.duration);
+}
+
+static GroupChat::Ptr readGroupChat(QDataStream& s, Trigger::List& triggers)
+{
+    GroupChat::Ptr chat {new GroupChat};
+
+    QString name;
+    s >> chat->id
+      >> chat->yamlHash
+      >> name;
+    chat->setName(name);
+
+    qint32 count;
+    s >> count;
+    for (qint32 i = 0; (i < count) && (s.status() == QDataStream::Ok); ++i)
+    {
+        qint32 index;
+        s >> index;
+        if (!lst::inRange(index, 0, triggers.count() - 1))
+        {
+            log_error_m << log_format("Group chat id: %?. Failed trigger index"
+                                      " in cache: %?", chat->id, index);
+            return {};
+        }
+        Trigger* t = triggers.item(index);
+        t->add_ref();
+        chat->triggers.add(t);
+    }
+
+    s >> chat->skipAdmins
+      >> chat->premiumBan
+      >> chat->checkBio;
+
+    s >> count;
+    for (qint32 i = 0; (i < count) && (s.status() == QDataStream::Ok); ++i)
+    {
+        GroupChat::WhiteUser* wu = chat->whiteUsers.add();
+        s >> wu->userId >> wu->info;
+    }
+    chat->whiteUsers.sort();
+
+    qint32 timeFrame, usersLimit, duration;
+    s >> chat->userSpamLimit
+      >> chat->newUserMute
+      >> chat->anonymousAsAdmin
+      >> chat->removeJoinMessage
+      >> chat->joinViaChatFolder.ban
+      >> chat->joinViaChatFolder.restrict_
+      >> chat->joinViaChatFolder.mute
+      >> chat->joinViaChatFolder.reportSpam
+      >> chat->userRestricts
+      >> chat->antiRaid.active
+      >> timeFrame
+      >> usersLimit
+      >> duration;
+
+    chat->antiRaid.timeFrame = timeFrame;
+    chat->antiRaid.usersLimit = usersLimit;
+    chat->antiRaid.duration = duration;
+
+    return chat;
+}
+
+QString groupsCacheFile()
+{
+    return QString(VAROPT_DIR) + "/state/telebot.groups.cache";
+}
+
+bool saveGroupsCache(const QString& cacheFile, const QByteArray& configHash,
+                     Trigger::List& triggers, GroupChat::List& chats)
+{
+    QSaveFile file {cacheFile};
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        log_error_m << "Failed open to save groups cache file: " << cacheFile
+                    << ". Error: " << file.errorString();
+        return false;
+    }
+
+    QDataStream s {&file};
+    s.setVersion(QDATASTREAM_VERSION);
+    s << cacheMagic << cacheFormat << buildId() << configHash;
+
+    QHash<const Trigger*, qint32> triggerIndexes;
+    s << qint32(triggers.count());
+    for (int i = 0; i < triggers.count(); ++i)
+    {
+        Trigger* trigger = triggers.item(i);
+        triggerIndexes.insert(trigger, qint32(i));
+        writeTrigger(s, trigger);
+    }
+
+    s << qint32(chats.count());
+    for (GroupChat* chat : chats)
+        writeGroupChat(s, chat, triggerIndexes);
+
+    if (s.status() != QDataStream::Ok || !file.commit())
+    {
+        log_error_m << "Failed save groups cache file: " << cacheFile;
+        return false;
+    }
+
+    log_verbose_m << log_format("Groups cache saved: %?. Triggers: %?, chats: %?",
+                                cacheFile, triggers.count(), chats.count());
+    return true;
+}
+
+bool loadGroupsCache(const QString& cacheFile, const QByteArray& configHash,
+                     Trigger::List& triggers, GroupChat::List& chats)
+{
+    QFile file {cacheFile};
+    if (!file.exists())
+        return false;
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        log_error_m << "Failed open groups cache file: " << cacheFile
+                    << ". Error: " << file.errorString();
+        return false;
+    }
+
+    const qint64 fileSize = file.size();
+    uchar* mem = file.map(0, fileSize);
+    if (mem == nullptr)
+    {
+        log_error_m << "Failed map groups cache file: " << cacheFile
+                    << ". Error: " << file.errorString();
+        return false;
+    }
+
+    // Данные не копируются, QDataStream читает непосредственно
+    // из отображенной в память области файла
+    QByteArray data = QByteArray::fromRawData((const char*)mem, int(fileSize));
+
+    QDataStream s {data};
+    s.setVersion(QDATASTREAM_VERSION);
+
+    quint32 magic, format;
+    QByteArray build, hash;
+    s >> magic >> format;
+
+    if ((magic == cacheMagic) && (format == cacheFormat))
+        s >> build >> hash;
+
+    if ((magic != cacheMagic) || (format != cacheFormat)
+        || (build != buildId()) || (hash != configHash))
+    {
+        log_verbose_m << "Groups cache is outdated: " << cacheFile;
+        return false;
+    }
+
+    Trigger::List triggersCache;
+    GroupChat::List chatsCache;
+    QHash<QByteArray, Trigger*> matchTriggers;
+
+    qint32 count;
+    s >> count;
+    for (qint32 i = 0; (i < count) && (s.status() == QDataStream::Ok); ++i)
+    {
+        Trigger::Ptr trigger = readTrigger(s);
+        if (trigger.empty())
+            return false;
+
+        trigger->updateMatchHash();
+        if (!trigger->matchHash.isEmpty())
+        {
+            if (Trigger* t = matchTriggers.value(trigger->matchHash))
+                shareMatchData(trigger.get(), t);
+            else
+                matchTriggers.insert(trigger->matchHash, trigger.get());
+        }
+        triggersCache.add(trigger.detach());
+    }
+
+    s >> count;
+    for (qint32 i = 0; (i < count) && (s.status() == QDataStream::Ok); ++i)
+    {
+        GroupChat::Ptr chat = readGroupChat(s, triggersCache);
+        if (chat.empty())
+            return false;
+        chatsCache.add(chat.detach());
+    }
+
+    if (s.status() != QDataStream::Ok)
+    {
+        log_error_m << "Groups cache file is corrupted: " << cacheFile;
+        return false;
+    }
+
+    chatsCache.sort();
+    triggers.swap(triggersCache);
+    chats.swap(chatsCache);
+    return true;
+}
+
+} // namespace tbot
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "trigger.h"
+#include "group_chat.h"
+
+#include <QtCore>
+
+namespace tbot {
+
+/**
+  Бинарный кеш конфигурации групп (файл telebot.groups).  Кеш  содержит
+  готовые к использованию триггеры и группы, ссылки групп на  триггеры
+  хранятся в виде индексов. Кеш привязан к хешу содержимого конфиг-файла,
+  при изменении конфиг-файла кеш считается недействительным.
+
+  Регулярные выражения сохраняются в виде шаблонов и опций, при чтении
+  из кеша повторная проверка шаблонов не выполняется, компиляция выражения
+  происходит при первом его использовании
+*/
+
+// Путь к файлу бинарного кеша конфигурации групп
+QString groupsCacheFile();
+
+// Сохраняет триггеры и группы в кеш. Параметр configHash - хеш содержимого
+// конфиг-файла, на основе которого были созданы триггеры и группы
+bool saveGroupsCache(const QString& cacheFile, const QByteArray& configHash,
+                     Trigger::List&, GroupChat::List&);
+
+// Загружает триггеры и группы из кеша. Функция вернет FALSE если кеш
+// отсутствует, поврежден или создан для другого содержимого конфиг-файла
+bool loadGroupsCache(const QString& cacheFile, const QByteArray& configHash,
+                     Trigger::List&, GroupChat::List&);
+
+} // namespace tbot
@@ -0,0 +1,145 @@
+#include "groups_loader.h"
+#include "groups_cache.h"
+
+#include "shared/break_point.h"
+#include "shared/logger/logger.h"
+#include "shared/logger/format.h"
+
+#define log_error_m   alog::logger().error  (alog_line_location, "GroupsLoader")
+#define log_warn_m    alog::logger().warn   (alog_line_location, "GroupsLoader")
+#define log_info_m    alog::logger().info   (alog_line_location, "GroupsLoader")
+#define log_verbose_m alog::logger().verbose(alog_line_location, "GroupsLoader")
+#define log_debug_m   alog::logger().debug  (alog_line_location, "GroupsLoader")
+#define log_debug2_m  alog::logger().debug2 (alog_line_location, "GroupsLoader")
+
+namespace tbot {
+
+extern atomic_int globalConfigParceErrors;
+
+void GroupsLoader::load(const QString& configFile, bool printTriggers,
+                        bool printGroupChats)
+{
+    QMutexLocker locker {&_threadLock}; (void) locker;
+
+    _task.configFile = configFile;
+    _task.printTriggers = printTriggers;
+    _task.printGroupChats = printGroupChats;
+    _hasTask = true;
+
+    _threadCond.wakeOne();
+}
+
+GroupsLoader::Result::Ptr GroupsLoader::loadGroups(const QString& configFile,
+                                                   bool printTriggers,
+                                                   bool printGroupChats)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QByteArray configHash;
+    { //Block for QFile
+        QFile file {configFile};
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            log_error_m << "Failed open groups config file: " << configFile;
+            return {};
+        }
+        configHash = QCryptographicHash::hash(file.readAll(),
+                                              QCryptographicHash::Sha1);
+    }
+
+    Result::Ptr result = Result::Ptr::create();
+    result->configFile = configFile;
+
+    globalConfigParceErrors = 0;
+
+    // Текущая конфигурация, из нее берутся неизмененные триггеры и группы
+    Trigger::List prevTriggers = tbot::triggers();
+    GroupChat::List prevChats = tbot::groupChats();
+
+    // При старте программы (текущая конфигурация пуста) триггеры и группы
+    // загружаются из бинарного кеша, если конфиг-файл не изменился
+    bool fromCache = false;
+    if (prevChats.empty())
+        fromCache = loadGroupsCache(groupsCacheFile(), configHash,
+                                    result->triggers, result->chats);
+    if (fromCache)
+    {
+        result->triggersStat.reused = result->triggers.count();
+        result->chatsStat.reused = result->chats.count();
+
+        log_verbose_m << "Groups config loaded from cache: " << groupsCacheFile();
+
+        if (printTriggers)
+            tbot::printTriggers(result->triggers);
+
+        if (printGroupChats)
+            tbot::printGroupChats(result->chats);
+    }
+    else
+    {
+        YamlConfig config;
+        if (!config.readFile(configFile.toStdString(), true))
+            return {};
+
+        loadTriggers(result->triggers, config, &prevTriggers, &result->triggersStat);
+
+        if (printTriggers)
+            tbot::printTriggers(result->triggers);
+
+        if (!result->triggers.empty())
+        {
+            loadGroupChats(result->chats, config, result->triggers,
+                           &prevChats, &result->chatsStat);
+
+            if (printGroupChats)
+                tbot::printGroupChats(result->chats);
+        }
+
+        // Кеш сохраняется только для конфигурации загруженной без ошибок
+        if ((globalConfigParceErrors == 0)
+            && !result->triggers.empty() && !result->chats.empty())
+        {
+            saveGroupsCache(groupsCacheFile(), configHash,
+                            result->triggers, result->chats);
+        }
+    }
+
+    result->errors = globalConfigParceErrors;
+    result->elapsed = timer.elapsed();
+
+    return result;
+}
+
+void GroupsLoader::run()
+{
+    log_info_m << "Started";
+
+    while (true)
+    {
+        CHECK_QTHREADEX_STOP
+        Task task;
+
+        { //Block for QMutexLocker
+            QMutexLocker locker {&_threadLock}; (void) locker;
+
+            if (!_hasTask)
+                _threadCond.wait(&_threadLock, 50);
+
+            if (!_hasTask)
+                continue;
+
+            task = _task;
+            _hasTask = false;
+        }
+
+        Result::Ptr result = loadGroups(task.configFile, task.printTriggers,
+                                        task.printGroupChats);
+        if (!result.empty())
+            emit loaded(result);
+    }
+
+    log_info_m << "Stopped";
+}
+
+} // namespace tbot
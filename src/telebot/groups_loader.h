@@ -0,0 +1,79 @@
+#pragma once
+
+#include "trigger.h"
+#include "group_chat.h"
+
+#include "shared/defmac.h"
+#include "shared/container_ptr.h"
+#include "shared/qt/qthreadex.h"
+
+#include <QtCore>
+
+namespace tbot {
+
+/**
+  Поток для загрузки конфигурации групп (файл telebot.groups). Разбор YAML,
+  создание триггеров (с компиляцией регулярных выражений) и групп выполняется
+  вне основного потока приложения. Триггеры и группы, YAML-описание которых
+  не изменилось, повторно используются из текущей конфигурации
+*/
+class GroupsLoader : public QThreadEx
+{
+public:
+    // Результат загрузки конфигурации
+    struct Result
+    {
+        typedef container_ptr<Result> Ptr;
+
+        QString configFile;
+        Trigger::List triggers;
+        GroupChat::List chats;
+
+        LoadStat triggersStat;
+        LoadStat chatsStat;
+
+        // Количество ошибок разбора конфигурации
+        int errors = {0};
+
+        // Время загрузки конфигурации, в миллисекундах
+        qint64 elapsed = {0};
+    };
+
+    GroupsLoader() = default;
+
+    // Ставит конфиг-файл в очередь на загрузку. Если предыдущая загрузка
+    // еще не началась, то она будет заменена новой
+    void load(const QString& configFile, bool printTriggers, bool printGroupChats);
+
+    // Загружает конфигурацию в вызывающем потоке. Возвращает пустой указатель,
+    // если конфиг-файл не удалось прочитать
+    static Result::Ptr loadGroups(const QString& configFile, bool printTriggers,
+                                  bool printGroupChats);
+
+signals:
+    // Сигнал эмитируется после загрузки конфигурации, публикация результата
+    // выполняется получателем сигнала
+    void loaded(const tbot::GroupsLoader::Result::Ptr&);
+
+private:
+    Q_OBJECT
+    DISABLE_DEFAULT_COPY(GroupsLoader)
+
+    void run() override;
+
+private:
+    struct Task
+    {
+        QString configFile;
+        bool printTriggers = {true};
+        bool printGroupChats = {true};
+    };
+
+    Task _task;
+    bool _hasTask = {false};
+
+    QMutex _threadLock;
+    QWaitCondition _threadCond;
+};
+
+} // namespace tbot
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QtCore>
+
+namespace tbot {
+
+// Перемешивание битов 64-битного значения (финализатор splitmix64)
+inline quint64 mix64(quint64 x)
+{
+    x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27; x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Начальное значение хеша FNV-1a
+const quint64 FnvOffsetBasis = 0xCBF29CE484222325ULL;
+
+// Хеш FNV-1a для последовательности байт. Параметр hash позволяет продолжить
+// вычисление хеша для нескольких последовательностей
+inline quint64 fnv1a(const char* data, int size, quint64 hash = FnvOffsetBasis)
+{
+    for (int i = 0; i < size; ++i)
+    {
+        hash ^= quint64(quint8(data[i]));
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// Хеш FNV-1a для строки, вычисляется по символам UTF-16
+inline quint64 fnv1a(const QString& str, quint64 hash = FnvOffsetBasis)
+{
+    for (QChar c : str)
+    {
+        hash ^= quint64(c.unicode());
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+} // namespace tbot
@@ -0,0 +1,699 @@
+#include "http_client.h"
+
+#include "shared/break_point.h"
+#include "shared/logger/logger.h"
+#include "shared/logger/format.h"
+#include "shared/qt/logger_operators.h"
+
+#include <QAbstractEventDispatcher>
+#include <QSslError>
+#include <QSslConfiguration>
+
+#define log_error_m   alog::logger().error  (alog_line_location, "HttpClient")
+#define log_warn_m    alog::logger().warn   (alog_line_location, "HttpClient")
+#define log_info_m    alog::logger().info   (alog_line_location, "HttpClient")
+#define log_verbose_m alog::logger().verbose(alog_line_location, "HttpClient")
+#define log_debug_m   alog::logger().debug  (alog_line_location, "HttpClient")
+#define log_debug2_m  alog::logger().debug2 (alog_line_location, "HttpClient")
+
+namespace tbot {
+
+static std::atomic<quint64> httpReplyNumber = {0};
+
+// Интервал вывода статистики загрузки соединения (мсек)
+static const qint64 reportInterval = 10*60*1000 /*10 мин*/;
+
+QByteArray unicodeDecode(const QByteArray& data)
+{
+    QString source = QString::fromUtf8(data);
+    QString dest; dest.reserve(source.length());
+
+    auto getUint8 = [](uchar h, uchar l) -> uchar
+    {
+        uint8_t ret = 0;
+
+        if      (h - '0' < 10) ret = h - '0';
+        else if (h - 'A' < 6 ) ret = h - 'A' + 0x0A;
+        else if (h - 'a' < 6 ) ret = h - 'a' + 0x0A;
+
+        ret = ret << 4;
+
+        if      (l - '0' < 10) ret |= l - '0';
+        else if (l - 'A' < 6 ) ret |= l - 'A' + 0x0A;
+        else if (l - 'a' < 6 ) ret |= l - 'a' + 0x0A;
+
+        return  ret;
+    };
+
+    for (auto&& it = source.cbegin(); it != source.cend(); ++it)
+    {
+        if (*it == QChar('\\')
+            && std::distance(it, source.cend()) > 5)
+        {
+            if (*(it + 1) == QChar('u'))
+            {
+                uchar c1 = getUint8((it + 2)->cell(), (it + 3)->cell());
+                uchar c2 = getUint8((it + 4)->cell(), (it + 5)->cell());
+
+                quint16 v = (c1 << 8) | c2;
+                dest.append(QChar(v));
+
+                it += 5;
+                continue;
+            }
+        }
+        dest.append(*it);
+    }
+    return dest.toUtf8();
+}
+
+// Декодирует тело ответа, переданное с Transfer-Encoding: chunked. Возвра-
+// щает FALSE если тело ответа принято не полностью
+static bool dechunk(const QByteArray& data, QByteArray& body)
+{
+    body.clear();
+    int pos = 0;
+    while (true)
+    {
+        int end = data.indexOf("\r\n", pos);
+        if (end == -1)
+            return false;
+
+        // Расширения блока (после символа ';') не используются
+        bool ok;
+        QByteArray sizeStr = data.mid(pos, end - pos);
+        int semicolon = sizeStr.indexOf(';');
+        if (semicolon != -1)
+            sizeStr.truncate(semicolon);
+
+        const int size = sizeStr.trimmed().toInt(&ok, 16);
+        if (!ok || size < 0)
+        {
+            // Некорректный ответ, ошибка будет обнаружена при разборе JSON
+            log_error_m << "Failed chunk size in http answer";
+            return true;
+        }
+
+        pos = end + 2;
+        if (size == 0)
+            return true;
+
+        if (data.size() < pos + size + 2)
+            return false;
+
+        body.append(data.constData() + pos, size);
+        pos += size + 2;
+    }
+}
+
+// Для Qt 6.2 и выше имя сокета, начинающееся с символа '@', обозначает
+// абстрактный Unix-сокет (Linux)
+static QString localSocketName(const QString& name, bool& abstract)
+{
+    abstract = name.startsWith(QChar('@'));
+    return abstract ? name.mid(1) : name;
+}
+
+void HttpClient::LocalConnection::clearResponse()
+{
+    buffer.clear();
+    headerSize = -1;
+    status = 0;
+    contentLength = -1;
+    chunked = false;
+    close = false;
+}
+
+HttpClient::HttpClient(int index, const Params& params)
+    : _index(index),
+      _params(params)
+{
+    const QUrl url {_params.url};
+    _requestPath = url.path().toUtf8();
+    _requestHost = url.host().toUtf8();
+    if (_requestHost.isEmpty())
+        _requestHost = "localhost";
+}
+
+void HttpClient::send(const TgParams::Ptr& params)
+{
+    { //Block for QMutexLocker
+        QMutexLocker locker {&_threadLock}; (void) locker;
+        _requests.append(params);
+    }
+
+    // Прерываем ожидание событий в потоке, чтобы запрос был отправлен
+    // без задержки
+    if (QAbstractEventDispatcher* dispatcher = QAbstractEventDispatcher::instance(this))
+        dispatcher->wakeUp();
+}
+
+void HttpClient::setPrintLog(bool printGetChat, bool printGetChatAdmins)
+{
+    _printGetChat = printGetChat;
+    _printGetChatAdmins = printGetChatAdmins;
+}
+
+bool HttpClient::printLog(const QString& funcName) const
+{
+    if (funcName == "getChat")
+        return _printGetChat;
+
+    if (funcName == "getChatAdministrators")
+        return _printGetChatAdmins;
+
+    return true;
+}
+
+void HttpClient::run()
+{
+    log_info_m << "Started";
+
+    QNetworkAccessManager manager;
+
+    _clock.start();
+    _statsTime = 0;
+    _inFlightChangeTime = 0;
+
+    const bool unixSocket = !_params.unixSocket.isEmpty();
+
+    // Предварительное установление соединения, чтобы первые запросы
+    // не ожидали TCP/TLS рукопожатия
+    const QUrl url {_params.url};
+    if (unixSocket)
+    {
+        log_verbose_m << "Http requests are sent through unix socket: "
+                      << _params.unixSocket;
+
+        _localConnections.resize(_params.maxInFlight);
+        localConnect(0);
+    }
+    else if (url.scheme() == "https")
+    {
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 13, 0))
+        // Протокол HTTP/2 согласуется при установлении TLS-соединения
+        QSslConfiguration sslConfig = QSslConfiguration::defaultConfiguration();
+        if (_params.http2)
+            sslConfig.setAllowedNextProtocols({QSslConfiguration::ALPNProtocolHTTP2,
+                                               QSslConfiguration::NextProtocolHttp1_1});
+        manager.connectToHostEncrypted(url.host(), quint16(url.port(443)), sslConfig);
+#else
+        manager.connectToHostEncrypted(url.host(), quint16(url.port(443)));
+#endif
+    }
+    else
+        manager.connectToHost(url.host(), quint16(url.port(80)));
+
+    // Таймер гарантирует периодический выход из ожидания событий для
+    // проверки признака остановки потока
+    QTimer wakeTimer;
+    wakeTimer.start(50);
+
+    while (true)
+    {
+        CHECK_QTHREADEX_STOP
+
+        QList<TgParams::Ptr> requests;
+        { //Block for QMutexLocker
+            QMutexLocker locker {&_threadLock}; (void) locker;
+
+            _stats.queuePeak = qMax(_stats.queuePeak, _requests.count());
+
+            // Количество одновременно выполняемых запросов ограничено,
+            // остальные запросы остаются в очереди
+            int free = _params.maxInFlight - inFlight();
+            while (free-- > 0 && !_requests.isEmpty())
+                requests.append(_requests.takeFirst());
+        }
+        for (const TgParams::Ptr& params : requests)
+        {
+            if (unixSocket)
+                postLocal(params);
+            else
+                post(manager, params);
+        }
+
+        if (_clock.elapsed() - _statsTime >= reportInterval)
+            report();
+
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+
+    for (auto it = _replies.cbegin(); it != _replies.cend(); ++it)
+    {
+        QNetworkReply* reply = it.key();
+        QObject::disconnect(reply, nullptr, &manager, nullptr);
+        reply->abort();
+        delete reply;
+    }
+    _replies.clear();
+
+    for (LocalConnection& conn : _localConnections)
+        if (conn.socket)
+        {
+            QObject::disconnect(conn.socket, nullptr, nullptr, nullptr);
+            conn.socket->abort();
+            delete conn.socket;
+            conn.socket = nullptr;
+        }
+    _localConnections.clear();
+
+    log_info_m << "Stopped";
+}
+
+void HttpClient::post(QNetworkAccessManager& manager, const TgParams::Ptr& params)
+{
+    // Параметры команды передаются в теле POST запроса в формате JSON,
+    // это снимает ограничение на длину URL для длинных текстов сообщений
+    if (params->body.isEmpty())
+        params->body = tgRequestBody(params->api);
+
+    QNetworkRequest request {QUrl(_params.url + params->funcName)};
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+
+    // Для соединений без TLS (local_server) используется HTTP/1.1
+    const bool http2 = _params.http2 && _params.url.startsWith("https");
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, http2);
+#else
+    request.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, http2);
+#endif
+    QNetworkReply* reply = manager.post(request, params->body);
+
+    inFlightChanged();
+
+    HttpReply& rd = _replies[reply];
+    rd.replyNumber = ++httpReplyNumber;
+    rd.params = params;
+    _sendTimes[reply] = _clock.elapsed();
+    _stats.inFlightPeak = qMax(_stats.inFlightPeak, inFlight());
+
+    // Обработчики выполняются в потоке HttpClient, так как в нем
+    // находится объект manager
+    QObject::connect(reply, &QIODevice::readyRead, &manager, [this, reply]()
+    {
+        _replies[reply].data.append(reply->readAll());
+    });
+
+    QObject::connect(reply, &QNetworkReply::finished, &manager, [this, reply]()
+    {
+        replyFinished(reply);
+    });
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    QObject::connect(reply, &QNetworkReply::errorOccurred, &manager,
+#else
+    QObject::connect(reply, qOverload<QNetworkReply::NetworkError>(&QNetworkReply::error), &manager,
+#endif
+                     [this, reply](QNetworkReply::NetworkError)
+    {
+        HttpReply& rd = _replies[reply];
+        rd.success = false;
+        log_error_m << log_format("Http error (reply id: %?). %?",
+                                  rd.replyNumber, reply->errorString());
+    });
+
+    QObject::connect(reply, &QNetworkReply::sslErrors, &manager,
+                     [](const QList<QSslError>&)
+    {
+        log_error_m << "http_sslErrors()";
+    });
+
+    if (printLog(params->funcName))
+        log_debug_m << log_format("Http call %? (reply id: %?). Send command: %?",
+                                  params->funcName, rd.replyNumber, params->body);
+}
+
+void HttpClient::replyFinished(QNetworkReply* reply)
+{
+    inFlightChanged();
+
+    HttpReply rd = _replies.take(reply);
+    reply->deleteLater();
+
+    rd.data.append(reply->readAll());
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    bool http2 = reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool();
+#else
+    bool http2 = reply->attribute(QNetworkRequest::HTTP2WasUsedAttribute).toBool();
+#endif
+    complete(rd, _sendTimes.take(reply), http2);
+}
+
+void HttpClient::postLocal(const TgParams::Ptr& params)
+{
+    if (params->body.isEmpty())
+        params->body = tgRequestBody(params->api);
+
+    int index = -1;
+    for (int i = 0; i < _localConnections.count(); ++i)
+        if (!_localConnections[i].busy)
+        {
+            index = i;
+            break;
+        }
+
+    if (index == -1)
+    {
+        // Количество запросов ограничено количеством соединений, поэтому
+        // ситуация не должна возникать
+        log_error_m << "No free unix socket connection. Request is requeued";
+        QMutexLocker locker {&_threadLock}; (void) locker;
+        _requests.prepend(params);
+        return;
+    }
+
+    inFlightChanged();
+
+    LocalConnection& conn = _localConnections[index];
+    conn.busy = true;
+    conn.sent = false;
+    conn.reply = HttpReply();
+    conn.reply.replyNumber = ++httpReplyNumber;
+    conn.reply.params = params;
+    conn.sendTime = _clock.elapsed();
+    conn.clearResponse();
+
+    _stats.inFlightPeak = qMax(_stats.inFlightPeak, inFlight());
+
+    if (printLog(params->funcName))
+        log_debug_m << log_format("Http call %? (reply id: %?). Send command: %?",
+                                  params->funcName, conn.reply.replyNumber, params->body);
+
+    if (conn.socket == nullptr)
+        localConnect(index);
+
+    // Если соединение еще не установлено, то запрос будет отправлен после
+    // установления соединения. При ошибке соединения запрос завершается
+    // в обработчике ошибки и сокет удаляется
+    if (conn.socket && conn.socket->state() == QLocalSocket::ConnectedState)
+        localWrite(index);
+}
+
+void HttpClient::localConnect(int index)
+{
+    LocalConnection& conn = _localConnections[index];
+    conn.socket = new QLocalSocket;
+    conn.served = 0;
+    conn.clearResponse();
+
+    QLocalSocket* socket = conn.socket;
+
+    // Обработчики выполняются в потоке HttpClient, так как в нем
+    // находится объект socket
+    QObject::connect(socket, &QLocalSocket::connected, socket, [this, index]()
+    {
+        localWrite(index);
+    });
+
+    QObject::connect(socket, &QIODevice::readyRead, socket, [this, index]()
+    {
+        localReadyRead(index);
+    });
+
+    QObject::connect(socket, &QLocalSocket::disconnected, socket, [this, index]()
+    {
+        localDisconnected(index, false);
+    });
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    QObject::connect(socket, &QLocalSocket::errorOccurred, socket,
+#else
+    QObject::connect(socket, qOverload<QLocalSocket::LocalSocketError>(&QLocalSocket::error), socket,
+#endif
+                     [this, index](QLocalSocket::LocalSocketError error)
+    {
+        // Закрытие соединения сервером обрабатывается в localDisconnected()
+        if (error == QLocalSocket::PeerClosedError)
+            return;
+
+        log_error_m << log_format("Unix socket error (connection %?): %?",
+                                  index, _localConnections[index].socket->errorString());
+        localDisconnected(index, true);
+    });
+
+    bool abstract;
+    const QString name = localSocketName(_params.unixSocket, abstract);
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 2, 0))
+    if (abstract)
+        socket->setSocketOptions(QLocalSocket::AbstractNamespaceOption);
+#else
+    if (abstract)
+        log_error_m << "Abstract unix sockets are supported since Qt 6.2";
+#endif
+    socket->connectToServer(name);
+}
+
+void HttpClient::localWrite(int index)
+{
+    LocalConnection& conn = _localConnections[index];
+    if (!conn.busy || conn.sent)
+        return;
+
+    conn.sent = true;
+    ++conn.served;
+
+    const TgParams::Ptr& params = conn.reply.params;
+    const QByteArray funcName = params->funcName.toUtf8();
+
+    QByteArray request;
+    request.reserve(params->body.size() + 256);
+    request += "POST " + _requestPath + funcName + " HTTP/1.1\r\n";
+    request += "Host: " + _requestHost + "\r\n";
+    request += "Content-Type: application/json\r\n";
+    request += "Content-Length: " + QByteArray::number(params->body.size()) + "\r\n";
+    request += "Connection: keep-alive\r\n";
+    request += "\r\n";
+    request += params->body;
+
+    conn.socket->write(request);
+    conn.socket->flush();
+}
+
+void HttpClient::localReadyRead(int index)
+{
+    LocalConnection& conn = _localConnections[index];
+    conn.buffer.append(conn.socket->readAll());
+
+    if (!conn.busy)
+    {
+        log_warn_m << log_format("Unexpected data in unix socket (connection %?)", index);
+        conn.clearResponse();
+        return;
+    }
+
+    if (conn.headerSize == -1)
+    {
+        // Разбираем заголовок
+        int pos = conn.buffer.indexOf("\r\n\r\n");
+        if (pos == -1)
+            return;
+
+        conn.headerSize = pos + 4;
+        const QList<QByteArray> lines = conn.buffer.left(pos).split('\n');
+
+        // Строка статуса: HTTP/1.1 200 OK
+        const QList<QByteArray> status = lines[0].simplified().split(' ');
+        conn.status = (status.count() > 1) ? status[1].toInt() : 0;
+
+        for (int i = 1; i < lines.count(); ++i)
+        {
+            int colon = lines[i].indexOf(':');
+            if (colon <= 0)
+                continue;
+
+            const QByteArray name  = lines[i].left(colon).trimmed().toLower();
+            const QByteArray value = lines[i].mid(colon + 1).trimmed().toLower();
+
+            if (name == "content-length")
+                conn.contentLength = value.toLongLong();
+            else if (name == "transfer-encoding")
+                conn.chunked = value.contains("chunked");
+            else if (name == "connection")
+                conn.close = (value == "close");
+        }
+    }
+
+    if (conn.chunked)
+    {
+        if (!dechunk(conn.buffer.mid(conn.headerSize), conn.reply.data))
+            return;
+    }
+    else if (conn.contentLength >= 0)
+    {
+        if (conn.buffer.size() - conn.headerSize < conn.contentLength)
+            return;
+
+        conn.reply.data = conn.buffer.mid(conn.headerSize, int(conn.contentLength));
+    }
+    else
+    {
+        // Ответ без Content-Length завершается закрытием соединения
+        return;
+    }
+
+    const bool close = conn.close;
+    localFinished(index, (conn.status >= 200) && (conn.status < 300));
+
+    if (close)
+        localReset(index);
+}
+
+void HttpClient::localDisconnected(int index, bool error)
+{
+    LocalConnection& conn = _localConnections[index];
+    if (!conn.busy)
+    {
+        localReset(index);
+        return;
+    }
+
+    if (!error && conn.headerSize != -1
+        && conn.contentLength == -1 && !conn.chunked)
+    {
+        conn.reply.data = conn.buffer.mid(conn.headerSize);
+        localFinished(index, (conn.status >= 200) && (conn.status < 300));
+        localReset(index);
+        return;
+    }
+
+    // Сервер мог закрыть неактивное соединение одновременно с отправкой
+    // запроса. Если ответ еще не начал поступать, то запрос повторяется
+    // в новом соединении
+    if (conn.sent && conn.served > 1 && conn.buffer.isEmpty())
+    {
+        log_verbose_m << log_format(
+            "Unix socket connection %? closed by server (reply id: %?)."
+            " Request is resent", index, conn.reply.replyNumber);
+
+        localReset(index);
+        conn.sent = false;
+        localConnect(index);
+        return;
+    }
+
+    log_error_m << log_format("Http error (reply id: %?). Unix socket connection"
+                              " closed before answer received", conn.reply.replyNumber);
+    localFinished(index, false);
+    localReset(index);
+}
+
+void HttpClient::localFinished(int index, bool success)
+{
+    LocalConnection& conn = _localConnections[index];
+    if (!conn.busy)
+        return;
+
+    inFlightChanged();
+
+    HttpReply rd = conn.reply;
+    rd.success = success;
+    const qint64 sendTime = conn.sendTime;
+
+    if (!success && conn.status != 0)
+        log_error_m << log_format("Http error (reply id: %?). Status: %?",
+                                  rd.replyNumber, conn.status);
+
+    conn.busy = false;
+    conn.sent = false;
+    conn.reply = HttpReply();
+    conn.clearResponse();
+
+    complete(rd, sendTime, false);
+}
+
+void HttpClient::localReset(int index)
+{
+    // Вызывается из обработчиков сигналов сокета, поэтому сокет удаляется
+    // через deleteLater()
+    LocalConnection& conn = _localConnections[index];
+    if (conn.socket)
+    {
+        QObject::disconnect(conn.socket, nullptr, nullptr, nullptr);
+        conn.socket->abort();
+        conn.socket->deleteLater();
+        conn.socket = nullptr;
+    }
+    conn.clearResponse();
+}
+
+void HttpClient::complete(HttpReply& rd, qint64 sendTime, bool http2)
+{
+    ++_stats.requests;
+    _stats.latency += _clock.elapsed() - sendTime;
+    if (!rd.success)
+        ++_stats.errors;
+    if (http2)
+        ++_stats.http2;
+
+    rd.data = unicodeDecode(rd.data);
+
+    if (!rd.success)
+    {
+        HttpResult httpResult;
+        httpResult.fromJson(rd.data);
+
+        rd.errorCode = httpResult.error_code;
+        if (httpResult.parameters)
+            rd.retryAfter = httpResult.parameters->retry_after;
+    }
+
+    if (printLog(rd.params->funcName))
+    {
+        log_debug_m << log_format("Http answer (reply id: %?) func   : %? (attempt: %?)",
+                                  rd.replyNumber, rd.params->funcName, rd.params->attempt);
+        log_debug_m << log_format("Http answer (reply id: %?) params : %?",
+                                  rd.replyNumber, rd.params->body);
+        log_debug_m << log_format("Http answer (reply id: %?) return : %?",
+                                  rd.replyNumber, rd.data);
+    }
+
+    emit finished(rd);
+}
+
+int HttpClient::inFlight() const
+{
+    int count = _replies.count();
+    for (const LocalConnection& conn : _localConnections)
+        if (conn.busy)
+            ++count;
+    return count;
+}
+
+void HttpClient::inFlightChanged()
+{
+    // Вызывается до изменения списка выполняемых запросов
+    const qint64 time = _clock.elapsed();
+    _stats.inFlightTime += qint64(inFlight()) * (time - _inFlightChangeTime);
+    _inFlightChangeTime = time;
+}
+
+void HttpClient::report()
+{
+    const qint64 time = _clock.elapsed();
+    const qint64 interval = qMax(time - _statsTime, qint64(1));
+
+    _stats.inFlightTime += qint64(inFlight()) * (time - _inFlightChangeTime);
+    _inFlightChangeTime = time;
+
+    if (_stats.requests)
+    {
+        // Загрузка соединения: среднее количество выполняемых запросов
+        // относительно допустимого максимума
+        double utilization = 100.0 * _stats.inFlightTime
+                             / (double(interval) * _params.maxInFlight);
+
+        log_info_m << log_format(
+            "Http client %?. Requests: %? (errors: %?, http2: %?)"
+            ", avg latency: %? ms, in-flight peak: %?/%?, queue peak: %?"
+            ", utilization: %?%",
+            _index, _stats.requests, _stats.errors, _stats.http2,
+            _stats.latency / _stats.requests, _stats.inFlightPeak,
+            _params.maxInFlight, _stats.queuePeak, qRound(utilization));
+    }
+    _stats = Stats();
+    _statsTime = time;
+}
+
+} // namespace tbot
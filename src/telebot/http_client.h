@@ -0,0 +1,189 @@
+#pragma once
+
+#include "processing.h"
+
+#include "shared/list.h"
+#include "shared/defmac.h"
+#include "shared/qt/qthreadex.h"
+
+#include <QtCore>
+#include <QNetworkReply>
+#include <QNetworkAccessManager>
+#include <QLocalSocket>
+#include <atomic>
+
+namespace tbot {
+
+/**
+  Результат выполнения http запроса для Телеграм-команды
+*/
+struct HttpReply
+{
+    quint64 replyNumber = {0};
+
+    // Параметры для функции sendTgCommand()
+    TgParams::Ptr params;
+
+    // Результат выполнения http запроса (с декодированными \u-последова-
+    // тельностями)
+    QByteArray data;
+
+    // Признак успешно выполненного http запроса
+    bool success = {true};
+
+    // Код ошибки и значение retry_after (в секундах) из ответа Телеграм,
+    // заполняются только для неуспешных запросов
+    qint32 errorCode = {0};
+    qint32 retryAfter = {0};
+};
+
+// Заменяет \uXXXX последовательности в JSON-тексте символами UTF-8
+QByteArray unicodeDecode(const QByteArray&);
+
+/**
+  Поток для выполнения исходящих http запросов к Телеграм. Поток имеет
+  собственный цикл обработки событий и собственный QNetworkAccessManager
+  (пул соединений). В потоке выполняется сериализация параметров команды,
+  декодирование и разбор ответа, а также вывод запросов и ответов в лог.
+  В поток приложения передается только результат запроса (HttpReply).
+
+  Для соединений с api.telegram.org используется HTTP/2: все запросы потока
+  мультиплексируются в одном TLS-соединении. Соединение устанавливается
+  при старте потока. Количество одновременно выполняемых запросов ограни-
+  чено, остальные запросы ожидают в очереди потока. Статистика загрузки
+  соединения периодически выводится в лог.
+
+  Для локального telegram-bot сервера запросы могут выполняться через Unix-
+  сокет (HTTP/1.1 с постоянными соединениями), что исключает накладные рас-
+  ходы TCP-стека на обмен данными в пределах одного хоста
+*/
+class HttpClient : public QThreadEx
+{
+public:
+    typedef lst::List<HttpClient, lst::CompareItemDummy> List;
+
+    struct Params
+    {
+        // Адрес Телеграм-сервера с идентификатором бота, имя функции
+        // добавляется к адресу при отправке команды
+        QString url;
+
+        // Использовать HTTP/2 для https-соединений
+        bool http2 = {true};
+
+        // Максимальное количество одновременно выполняемых запросов
+        int maxInFlight = {6};
+
+        // Путь к Unix-сокету локального сервера. Если путь задан, запросы
+        // выполняются через Unix-сокет, из адреса url используется только
+        // путь запроса
+        QString unixSocket;
+    };
+
+    // index - порядковый номер потока, используется для вывода в лог
+    HttpClient(int index, const Params&);
+
+    void send(const TgParams::Ptr&);
+
+    void setPrintLog(bool printGetChat, bool printGetChatAdmins);
+
+signals:
+    // Сигнал эмитируется после завершения http запроса
+    void finished(const tbot::HttpReply&);
+
+private:
+    Q_OBJECT
+    DISABLE_DEFAULT_COPY(HttpClient)
+
+    void run() override;
+
+    void post(QNetworkAccessManager&, const TgParams::Ptr&);
+    void replyFinished(QNetworkReply*);
+
+    // Выполнение запросов через Unix-сокет, index - номер соединения
+    void postLocal(const TgParams::Ptr&);
+    void localConnect(int index);
+    void localWrite(int index);
+    void localReadyRead(int index);
+    void localDisconnected(int index, bool error);
+    void localFinished(int index, bool success);
+    void localReset(int index);
+
+    // Учитывает в статистике завершенный запрос, разбирает ответ и  пере-
+    // дает его в поток приложения
+    void complete(HttpReply&, qint64 sendTime, bool http2);
+
+    bool printLog(const QString& funcName) const;
+
+    // Количество выполняемых запросов
+    int inFlight() const;
+
+    // Учитывает изменение количества выполняемых запросов
+    void inFlightChanged();
+
+    // Выводит в лог статистику загрузки соединения
+    void report();
+
+private:
+    const int _index;
+    const Params _params;
+
+    QMutex _threadLock;
+    QList<TgParams::Ptr> _requests;
+
+    // Запросы, выполняемые в потоке. Используется только внутри потока
+    QHash<QNetworkReply*, HttpReply> _replies;
+    QHash<QNetworkReply*, qint64 /*время отправки*/> _sendTimes;
+
+    // Путь запроса и значение заголовка Host для запросов через Unix-сокет
+    QByteArray _requestPath;
+    QByteArray _requestHost;
+
+    // Соединение с локальным сервером через Unix-сокет. По  соединению
+    // одновременно выполняется не более одного запроса. Используется
+    // только внутри потока
+    struct LocalConnection
+    {
+        QLocalSocket* socket = {nullptr};
+        int served = {0};          // Количество запросов, выполненных
+                                   // по соединению
+        // Текущий запрос
+        bool busy = {false};
+        bool sent = {false};
+        HttpReply reply;
+        qint64 sendTime = {0};
+
+        // Принятые данные и разобранный заголовок ответа
+        QByteArray buffer;
+        int headerSize = {-1};
+        int status = {0};
+        qint64 contentLength = {-1};
+        bool chunked = {false};
+        bool close = {false};
+
+        void clearResponse();
+    };
+    QVector<LocalConnection> _localConnections;
+
+    // Статистика загрузки соединения, используется только внутри потока
+    struct Stats
+    {
+        qint64 requests = {0};
+        qint64 errors = {0};
+        qint64 http2 = {0};        // Количество запросов, выполненных по HTTP/2
+        qint64 latency = {0};      // Суммарное время выполнения запросов (мсек)
+        qint64 inFlightTime = {0}; // Интеграл количества выполняемых запросов
+                                   // по времени (мсек)
+        int inFlightPeak = {0};
+        int queuePeak = {0};       // Максимальная длина очереди потока
+    };
+    Stats _stats;
+    QElapsedTimer _clock;
+    qint64 _statsTime = {0};
+    qint64 _inFlightChangeTime = {0};
+
+    std::atomic_bool _printGetChat = {true};
+    std::atomic_bool _printGetChatAdmins = {true};
+};
+
+} // namespace tbot
@@ -0,0 +1,334 @@
+#include "outbound_scheduler.h"
+
+#include "shared/break_point.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace tbot {
+
+// Количество корзин групп, при превышении которого из списка удаляются
+// корзины давно не используемых групп
+static const int chatBucketsReserve = 1000;
+
+TokenBucket::TokenBucket(double rate, double burst, qint64 now)
+    : _rate(std::max(rate, 0.001)),
+      _burst(std::max(burst, 1.0)),
+      _tokens(_burst),
+      _time(now)
+{}
+
+double TokenBucket::tokens(qint64 now) const
+{
+    double tokens = _tokens + double(now - _time) * _rate / 1000;
+    return std::min(tokens, _burst);
+}
+
+qint64 TokenBucket::wait(qint64 now) const
+{
+    double tokens = this->tokens(now);
+    if (tokens >= 1)
+        return 0;
+
+    return qint64(std::ceil((1 - tokens) * 1000 / _rate));
+}
+
+void TokenBucket::take(qint64 now)
+{
+    _tokens = tokens(now) - 1;
+    _time = now;
+}
+
+bool TokenBucket::full(qint64 now) const
+{
+    return (tokens(now) >= _burst);
+}
+
+OutboundScheduler::OutboundScheduler()
+{
+    setLimits(Limits());
+}
+
+void OutboundScheduler::setLimits(const Limits& limits)
+{
+    _limits = limits;
+    _limits.global    = std::max(_limits.global, 1);
+    _limits.chat      = std::max(_limits.chat, 1);
+    _limits.chatBurst = std::max(_limits.chatBurst, 1);
+    _limits.getChat   = std::max(_limits.getChat, 1);
+
+    // Пачка запросов ограничена секундным лимитом, поэтому общее ограничение
+    // не будет превышено на любом односекундном интервале
+    _globalBucket = TokenBucket(_limits.global, _limits.global, 0);
+    _getChatBucket = TokenBucket(_limits.getChat, _limits.getChat, 0);
+    _chatBuckets.clear();
+
+    // Корзины групп заполнены, время готовности групп определяется только
+    // временем отправки первой команды
+    for (auto it = _chatQueues.constBegin(); it != _chatQueues.constEnd(); ++it)
+        updateChat(it.key(), 0);
+}
+
+OutboundScheduler::Priority OutboundScheduler::priority(const QString& funcName)
+{
+    if (funcName == "deleteMessage"
+        || funcName == "deleteMessages"
+        || funcName == "banChatMember"
+        || funcName == "banChatSenderChat"
+        || funcName == "restrictChatMember")
+    {
+        return Priority::High;
+    }
+
+    if (funcName == "getChat"
+        || funcName == "getChatAdministrators"
+        || funcName == "getChatMember")
+    {
+        return Priority::Low;
+    }
+
+    return Priority::Normal;
+}
+
+void OutboundScheduler::enqueue(const TgParams::Ptr& params, qint64 now)
+{
+    const Priority p = priority(params->funcName);
+    const Key key {now + std::max(params->delay, 0), ++_sequence};
+
+    if (p == Priority::Normal)
+    {
+        const qint64 chatId = this->chatId(params);
+        _chatQueues[chatId].insert(key, params);
+        ++_chatCommandCount;
+        updateChat(chatId, now);
+        return;
+    }
+    _queues[int(p)].insert(key, params);
+}
+
+void OutboundScheduler::hold(Priority p, qint64 until)
+{
+    qint64& holdUntil = _holdUntil[int(p)];
+    holdUntil = std::max(holdUntil, until);
+}
+
+TokenBucket OutboundScheduler::chatBucket(qint64 chatId, qint64 now) const
+{
+    auto it = _chatBuckets.constFind(chatId);
+    if (it != _chatBuckets.constEnd())
+        return it.value();
+
+    return TokenBucket(_limits.chat / 60.0, _limits.chatBurst, now);
+}
+
+qint64 OutboundScheduler::chatId(const TgParams::Ptr& params)
+{
+    return params->api.value("chat_id").toLongLong();
+}
+
+qint64 OutboundScheduler::bucketsWait(Priority p, const TgParams::Ptr& params,
+                                      qint64 now) const
+{
+    qint64 wait = _globalBucket.wait(now);
+
+    if (p == Priority::Normal)
+    {
+        // Ограничение на количество сообщений распространяется только на
+        // команды, публикующие сообщения в группе
+        const qint64 chatId = this->chatId(params);
+        if (chatId != 0)
+            wait = std::max(wait, chatBucket(chatId, now).wait(now));
+    }
+    else if (p == Priority::Low)
+    {
+        wait = std::max(wait, _getChatBucket.wait(now));
+    }
+    return wait;
+}
+
+void OutboundScheduler::bucketsTake(Priority p, const TgParams::Ptr& params,
+                                    qint64 now)
+{
+    _globalBucket.take(now);
+
+    if (p == Priority::Normal)
+    {
+        const qint64 chatId = this->chatId(params);
+        if (chatId != 0)
+        {
+            if (_chatBuckets.count() > chatBucketsReserve)
+            {
+                for (auto it = _chatBuckets.begin(); it != _chatBuckets.end();)
+                    it = it.value().full(now) ? _chatBuckets.erase(it) : ++it;
+            }
+
+            TokenBucket bucket = chatBucket(chatId, now);
+            bucket.take(now);
+            _chatBuckets[chatId] = bucket;
+        }
+    }
+    else if (p == Priority::Low)
+    {
+        _getChatBucket.take(now);
+    }
+}
+
+void OutboundScheduler::updateChat(qint64 chatId, qint64 now)
+{
+    auto state = _chatStates.find(chatId);
+    if (state != _chatStates.end())
+    {
+        if (state->ready)
+            _readyChats.remove(state->key);
+        else
+            _waitingChats.remove(state->key);
+    }
+
+    auto queue = _chatQueues.find(chatId);
+    if (queue->isEmpty())
+    {
+        _chatQueues.erase(queue);
+        if (state != _chatStates.end())
+            _chatStates.erase(state);
+        return;
+    }
+    if (state == _chatStates.end())
+        state = _chatStates.insert(chatId, ChatState());
+
+    // Лимит группы изменяется только при отправке команды в эту группу,
+    // поэтому время готовности группы вычисляется один раз
+    const Key head = queue->firstKey();
+    qint64 readyTime = head.first;
+    if (chatId != 0)
+        readyTime = std::max(readyTime, now + chatBucket(chatId, now).wait(now));
+
+    state->ready = (readyTime <= now);
+    if (state->ready)
+    {
+        state->key = head;
+        _readyChats.insert(head, chatId);
+    }
+    else
+    {
+        state->key = Key {readyTime, head.second};
+        _waitingChats.insert(state->key, chatId);
+    }
+}
+
+TgParams::Ptr OutboundScheduler::nextChatCommand(qint64 now)
+{
+    // Группы, для которых наступило время готовности, переводятся в список
+    // готовых групп. Готовые группы упорядочены по ключу первой команды,
+    // поэтому команды разных групп отправляются в порядке поступления
+    while (!_waitingChats.isEmpty() && (_waitingChats.firstKey().first <= now))
+    {
+        const qint64 chatId = _waitingChats.take(_waitingChats.firstKey());
+        ChatState& state = _chatStates[chatId];
+        state.key = _chatQueues[chatId].firstKey();
+        state.ready = true;
+        _readyChats.insert(state.key, chatId);
+    }
+
+    if (_readyChats.isEmpty())
+        return {};
+
+    const qint64 chatId = _readyChats.first();
+    Queue& queue = _chatQueues[chatId];
+    TgParams::Ptr params = queue.take(queue.firstKey());
+    --_chatCommandCount;
+
+    bucketsTake(Priority::Normal, params, now);
+    updateChat(chatId, now);
+    return params;
+}
+
+TgParams::Ptr OutboundScheduler::next(qint64 now)
+{
+    if (_globalBucket.wait(now) > 0)
+        return {};
+
+    for (int i = 0; i < PriorityCount; ++i)
+    {
+        const Priority p = Priority(i);
+        if (_holdUntil[i] > now)
+            continue;
+
+        if (p == Priority::Normal)
+        {
+            TgParams::Ptr params = nextChatCommand(now);
+            if (!params.empty())
+                return params;
+            continue;
+        }
+
+        // Ограничения классов High и Low общие для всех команд класса,
+        // поэтому достаточно проверить первую команду очереди
+        Queue& queue = _queues[i];
+        if (queue.isEmpty())
+            continue;
+
+        auto it = queue.begin();
+        if ((it.key().first > now) || (bucketsWait(p, it.value(), now) > 0))
+            continue;
+
+        TgParams::Ptr params = it.value();
+        queue.erase(it);
+        bucketsTake(p, params, now);
+        return params;
+    }
+    return {};
+}
+
+qint64 OutboundScheduler::wait(qint64 now) const
+{
+    qint64 wait = -1;
+    for (int i = 0; i < PriorityCount; ++i)
+    {
+        const Priority p = Priority(i);
+
+        qint64 w;
+        if (p == Priority::Normal)
+        {
+            if (!_readyChats.isEmpty())
+                w = 0;
+            else if (!_waitingChats.isEmpty())
+                w = std::max(_waitingChats.firstKey().first - now, qint64(0));
+            else
+                continue;
+
+            w = std::max(w, _globalBucket.wait(now));
+        }
+        else
+        {
+            const Queue& queue = _queues[i];
+            if (queue.isEmpty())
+                continue;
+
+            auto it = queue.constBegin();
+            w = std::max(it.key().first - now, qint64(0));
+            w = std::max(w, bucketsWait(p, it.value(), now));
+        }
+        w = std::max(w, _holdUntil[i] - now);
+
+        if ((wait < 0) || (w < wait))
+            wait = w;
+
+        if (wait == 0)
+            return 0;
+    }
+    return wait;
+}
+
+void OutboundScheduler::clear()
+{
+    for (Queue& queue : _queues)
+        queue.clear();
+
+    _chatQueues.clear();
+    _chatCommandCount = 0;
+    _waitingChats.clear();
+    _readyChats.clear();
+    _chatStates.clear();
+}
+
+} // namespace tbot
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "processing.h"
+
+#include <QtCore>
+
+namespace tbot {
+
+/**
+  Корзина токенов: токены пополняются с постоянной скоростью rate (токенов
+  в секунду) до емкости burst. Отправка команды расходует один токен
+*/
+class TokenBucket
+{
+public:
+    TokenBucket() = default;
+    TokenBucket(double rate, double burst, qint64 now);
+
+    // Время (в миллисекундах), через которое будет доступен токен.
+    // Значение 0 - токен доступен сейчас
+    qint64 wait(qint64 now) const;
+
+    void take(qint64 now);
+
+    // Корзина заполнена полностью, т.е. давно не использовалась
+    bool full(qint64 now) const;
+
+private:
+    double tokens(qint64 now) const;
+
+private:
+    double _rate   = {1};
+    double _burst  = {1};
+    double _tokens = {1};
+    qint64 _time   = {0}; // Время последнего расчета токенов (мсек)
+};
+
+/**
+  Планировщик исходящих Телеграм-команд. Команды отправляются с  учетом
+  ограничений Телеграм: общего ограничения  на  количество  запросов  от
+  бота, ограничения на количество сообщений в одну группу и ограничений
+  для отдельных функций (getChat, getChatAdministrators).
+
+  Команды разделены на классы приоритета: удаление сообщений и блокировка
+  пользователей отправляются в первую очередь, затем информационные сооб-
+  щения, затем служебные запросы (getChat). Внутри класса команды отправ-
+  ляются в порядке поступления. Параметр TgParams::delay задает наиболее
+  раннее время отправки команды.
+
+  Для классов High и Low действуют только общие для класса ограничения,
+  поэтому проверяется только первая команда очереди. Команды класса Normal
+  хранятся в очередях групп, группы упорядочены по времени готовности первой
+  команды с учетом лимита группы: выбор команды не требует перебора групп,
+  для которых исчерпан лимит.
+
+  Класс не является потокобезопасным, используется в потоке приложения
+*/
+class OutboundScheduler
+{
+public:
+    enum class Priority
+    {
+        High   = 0, // Удаление сообщений, блокировка пользователей
+        Normal = 1, // Информационные сообщения и прочие команды
+        Low    = 2  // Служебные запросы
+    };
+
+    struct Limits
+    {
+        // Общее ограничение на количество запросов от бота (в секунду)
+        int global = {30};
+
+        // Ограничение на количество сообщений в одну группу (в минуту)
+        // и допустимая пачка сообщений
+        int chat = {20};
+        int chatBurst = {3};
+
+        // Ограничение для функций getChat и getChatAdministrators
+        // (в секунду)
+        int getChat = {5};
+    };
+
+    OutboundScheduler();
+
+    void setLimits(const Limits&);
+    Limits limits() const {return _limits;}
+
+    void enqueue(const TgParams::Ptr&, qint64 now);
+
+    // Извлекает из очереди команду, которую можно отправить в момент now.
+    // Если таких команд нет, то возвращает пустой указатель
+    TgParams::Ptr next(qint64 now);
+
+    // Время (в миллисекундах) до момента, когда может  быть  отправлена
+    // следующая команда. Значение -1 - очередь пуста
+    qint64 wait(qint64 now) const;
+
+    // Приостанавливает отправку команд класса priority до момента until
+    // (превышение лимита запросов, ошибка 429)
+    void hold(Priority, qint64 until);
+
+    int count() const {return _queues[int(Priority::High)].count()
+                            + _chatCommandCount
+                            + _queues[int(Priority::Low)].count();}
+
+    void clear();
+
+    static Priority priority(const QString& funcName);
+
+private:
+    typedef QPair<qint64 /*время отправки*/, quint64 /*порядковый номер*/> Key;
+    typedef QMap<Key, TgParams::Ptr> Queue;
+
+    // Время, через которое для команды будут доступны токены всех корзин
+    qint64 bucketsWait(Priority, const TgParams::Ptr&, qint64 now) const;
+    void bucketsTake(Priority, const TgParams::Ptr&, qint64 now);
+
+    TokenBucket chatBucket(qint64 chatId, qint64 now) const;
+
+    // Идентификатор группы для ограничения количества сообщений. Значение 0 -
+    // команда не публикует сообщения в группе
+    static qint64 chatId(const TgParams::Ptr&);
+
+    // Извлекает готовую к отправке команду класса Normal
+    TgParams::Ptr nextChatCommand(qint64 now);
+
+    // Обновляет положение группы в _waitingChats/_readyChats после изменения
+    // очереди группы или ее корзины токенов
+    void updateChat(qint64 chatId, qint64 now);
+
+private:
+    static constexpr int PriorityCount = 3;
+
+    Limits _limits;
+
+    // Очереди команд классов High и Low. Команды класса Normal хранятся
+    // в очередях групп _chatQueues
+    Queue _queues[PriorityCount];
+    quint64 _sequence = {0};
+
+    // Очереди команд класса Normal по группам
+    QHash<qint64 /*chat id*/, Queue> _chatQueues;
+    int _chatCommandCount = {0};
+
+    // Группы, первая команда которых станет готова к отправке позже (ключ -
+    // время готовности с учетом лимита группы), и группы,  первая  команда
+    // которых готова к отправке (ключ - ключ первой команды)
+    QMap<Key, qint64 /*chat id*/> _waitingChats;
+    QMap<Key, qint64 /*chat id*/> _readyChats;
+
+    struct ChatState
+    {
+        Key key;
+        bool ready = {false};
+    };
+    QHash<qint64 /*chat id*/, ChatState> _chatStates;
+
+    // Время, до которого приостановлена отправка команд класса
+    qint64 _holdUntil[PriorityCount] = {0};
+
+    TokenBucket _globalBucket;
+    TokenBucket _getChatBucket;
+    QHash<qint64 /*chat id*/, TokenBucket> _chatBuckets;
+};
+
+} // namespace tbot
@@ -3,6 +3,8 @@
 #include "trigger.h"
 #include "functions.h"
 #include "group_chat.h"
+#include "bio_cache.h"
+#include "campaign_detector.h"
 
 #include "shared/break_point.h"
 #include "shared/utils.h"
@@ -31,6 +33,28 @@ QMap<Processing::TemporaryKey, steady_timer> Processing::_temporaryNewUsers;
 QMap<QString, Processing::MediaGroup> Processing::_mediaGroups;
 Processing::VerifyAdmin::List Processing::_verifyAdmins;
 
+QByteArray tgRequestBody(const QMap<QString, QVariant>& api)
+{
+    QJsonObject obj;
+    for (auto it = api.cbegin(); it != api.cend(); ++it)
+    {
+        const QVariant& value = it.value();
+        if (value.type() == QVariant::ByteArray)
+        {
+            QJsonDocument doc = QJsonDocument::fromJson(value.toByteArray());
+            if (doc.isObject())
+                obj.insert(it.key(), doc.object());
+            else if (doc.isArray())
+                obj.insert(it.key(), doc.array());
+            else
+                obj.insert(it.key(), QString::fromUtf8(value.toByteArray()));
+        }
+        else
+            obj.insert(it.key(), QJsonValue::fromVariant(value));
+    }
+    return QJsonDocument(obj).toJson(QJsonDocument::Compact);
+}
+
 Processing::Processing()
 {}
 
@@ -222,7 +246,6 @@ void Processing::run()
             auto params = tgfunction("deleteMessage");
             params->api["chat_id"] = chatId;
             params->api["message_id"] = messageId;
-            params->delay = 200 /*0.2 сек*/;
             emit sendTgCommand(params);
             continue;
         }
@@ -238,8 +261,9 @@ void Processing::run()
         }
 
         GroupChat* chat = chats.item(fr.index());
-        QSet<qint64> adminIds = chat->adminIds();
-        ChatMemberAdministrator::Ptr botInfo = chat->botInfo();
+        GroupChat::Runtime::Ptr runtime = chat->runtime();
+        const QSet<qint64>& adminIds = runtime->adminIds;
+        const ChatMemberAdministrator::Ptr& botInfo = runtime->botInfo;
 
         if (botInfo.empty())
             log_error_m << "Information about bot permissions is not available";
@@ -308,7 +332,6 @@ void Processing::run()
                 auto params = tgfunction("deleteMessage");
                 params->api["chat_id"] = chatId;
                 params->api["message_id"] = messageId;
-                params->delay = 200 /*0.2 сек*/;
                 emit sendTgCommand(params);
                 continue;
             }
@@ -414,7 +437,6 @@ void Processing::run()
                 auto params = tgfunction("deleteMessage");
                 params->api["chat_id"] = chatId;
                 params->api["message_id"] = messageId;
-                params->delay = 200 /*0.2 сек*/;
                 emit sendTgCommand(params);
             };
 
@@ -521,7 +543,6 @@ void Processing::run()
                 params->api["chat_id"] = chatId;
                 params->api["text"] = botMsg;
                 params->api["parse_mode"] = "Markdown";
-                params->delay = 300 /*0.3 сек*/;
                 params->messageDel = 15 /*15 сек*/;
                 emit sendTgCommand(params);
             }
@@ -558,7 +579,6 @@ void Processing::run()
             auto params = tgfunction("deleteMessage");
             params->api["chat_id"] = chatId;
             params->api["message_id"] = messageId;
-            params->delay = 100 /*мсек*/;
             emit sendTgCommand(params);
         }
 
@@ -662,7 +682,6 @@ void Processing::run()
                         auto params = tgfunction("deleteMessage");
                         params->api["chat_id"] = mg.chatId;
                         params->api["message_id"] = msgId;
-                        params->delay = 200 /*0.2 сек*/;
                         emit sendTgCommand(params);
                     }
                     mg.messageIds.clear();
@@ -672,7 +691,6 @@ void Processing::run()
                     auto params = tgfunction("deleteMessage");
                     params->api["chat_id"] = chatId;
                     params->api["message_id"] = messageId;
-                    params->delay = 200 /*0.2 сек*/;
                     emit sendTgCommand(params);
                 }
             };
@@ -708,7 +726,6 @@ void Processing::run()
                     params->api["chat_id"] = chatId;
                     params->api["text"] = botMsg.arg(stringUserInfo(user));
                     params->api["parse_mode"] = "Markdown";
-                    params->delay = 500 /*0.5 сек*/;
                     emit sendTgCommand(params);
                 }
 
@@ -727,9 +744,6 @@ void Processing::run()
                     fuzzyText->timeLife = fuzzyText->time + 72*60*60 /*72 часа*/;
                     fuzzyText->messageDel = true;
 
-                    const u32string text32 = fuzzyText->text.toLower().toStdU32String();
-                    fuzzyText->fuzzyCache = data::FuzzyText::FuzzyCachePtr::create(text32);
-
                     fuzzyTexts().add(fuzzyText);
                 }
 
@@ -752,7 +766,6 @@ void Processing::run()
                         params->api["user_id"] = user->id;
                         params->api["until_date"] = qint64(std::time(nullptr));
                         params->api["revoke_messages"] = false;
-                        params->delay = 400 /*0.4 сек*/;
                         sendTgCommand(params);
 
                         botMsg =
@@ -764,7 +777,6 @@ void Processing::run()
                         params2->api["chat_id"] = chatId;
                         params2->api["text"] = botMsg.arg(stringUserInfo(user));
                         params2->api["parse_mode"] = "Markdown";
-                        params2->delay = 500 /*0.5 сек*/;
                         emit sendTgCommand(params2);
                     }
                     else
@@ -784,7 +796,6 @@ void Processing::run()
                         params->api["chat_id"] = chatId;
                         params->api["text"] = botMsg.arg(stringUserInfo(user));
                         params->api["parse_mode"] = "Markdown";
-                        params->delay = 500 /*0.5 сек*/;
                         emit sendTgCommand(params);
                     }
 
@@ -829,7 +840,6 @@ void Processing::run()
                     params->api["chat_id"] = spamCollectorChatId;
                     params->api["text"] = botMsg;
                     params->api["parse_mode"] = "Markdown";
-                    params->delay = 100 /*0.10 сек*/;
                     params->messageDel = -1;
                     emit sendTgCommand(params);
 
@@ -841,7 +851,6 @@ void Processing::run()
                     params2->api["chat_id"] = spamCollectorChatId;
                     params2->api["text"] = text;
                     params2->api["parse_mode"] = "HTML";
-                    params2->delay = 150 /*0.15 сек*/;
                     params2->messageDel = -1;
                     emit sendTgCommand(params2);
 
@@ -849,7 +858,6 @@ void Processing::run()
                     params3->api["chat_id"] = spamCollectorChatId;
                     params3->api["text"] = "---";
                     params3->api["parse_mode"] = "HTML";
-                    params3->delay = 200 /*0.20 сек*/;
                     params3->messageDel = -1;
                     emit sendTgCommand(params3);
                 }
@@ -910,7 +918,6 @@ void Processing::run()
                     params->api["user_id"] = user->id;
                     params->api["until_date"] = qint64(std::time(nullptr));
                     params->api["revoke_messages"] = false;
-                    params->delay = 400 /*0.4 сек*/;
                     sendTgCommand(params);
 
                     botMsg =
@@ -922,7 +929,6 @@ void Processing::run()
                     params2->api["chat_id"] = chatId;
                     params2->api["text"] = botMsg.arg(stringUserInfo(user));
                     params2->api["parse_mode"] = "Markdown";
-                    params2->delay = 500 /*0.5 сек*/;
                     emit sendTgCommand(params2);
                 }
                 else
@@ -988,7 +994,6 @@ void Processing::run()
                     params2->api["chat_id"] = chatId;
                     params2->api["text"] = botMsg;
                     params2->api["parse_mode"] = "Markdown";
-                    params2->delay = 500 /*0.5 сек*/;
                     emit sendTgCommand(params2);
                 }
                 else
@@ -1013,7 +1018,6 @@ void Processing::run()
                     params->api["chat_id"] = chatId;
                     params->api["text"] = botMsg;
                     params->api["parse_mode"] = "Markdown";
-                    params->delay = 500 /*0.5 сек*/;
                     emit sendTgCommand(params);
                 }
                 continue;
@@ -1035,7 +1039,6 @@ void Processing::run()
                     auto params = tgfunction("deleteMessage");
                     params->api["chat_id"] = chatId;
                     params->api["message_id"] = messageId;
-                    params->delay = 200 /*0.2 сек*/;
                     emit sendTgCommand(params);
 
                     // Формируем сообщение с идентификатором пользователя
@@ -1046,7 +1049,6 @@ void Processing::run()
                     params3->api["chat_id"] = chatId;
                     params3->api["text"] = botMsg;
                     params3->api["parse_mode"] = "Markdown";
-                    params3->delay = 800 /*0.8 сек*/;
                     emit sendTgCommand(params3);
 
                     if (chat->joinViaChatFolder.reportSpam
@@ -1063,7 +1065,7 @@ void Processing::run()
             if (chat->antiRaid.active && isNewUser && !isBioMessage)
             {
                 emit antiRaidUser(chatId, message->from);
-                if (chat->antiRaidTurnOn)
+                if (chat->antiRaidTurnOn())
                     continue;
             }
 
@@ -1171,7 +1173,6 @@ void Processing::run()
                         auto params = tgfunction("deleteMessage");
                         params->api["chat_id"] = mg.chatId;
                         params->api["message_id"] = msgId;
-                        params->delay = 200 /*0.2 сек*/;
                         emit sendTgCommand(params);
                     }
                     mg.messageIds.clear();
@@ -1183,7 +1184,6 @@ void Processing::run()
                     auto params = tgfunction("deleteMessage");
                     params->api["chat_id"] = chatId;
                     params->api["message_id"] = messageId;
-                    params->delay = 200 /*0.2 сек*/;
                     emit sendTgCommand(params);
                 }
 
@@ -1226,7 +1226,6 @@ void Processing::run()
                 params2->api["chat_id"] = chatId;
                 params2->api["text"] = botMsg;
                 params2->api["parse_mode"] = "HTML";
-                params2->delay = 500 /*0.5 сек*/;
                 emit sendTgCommand(params2);
 
                 // Формируем сообщение с идентификатором пользователя
@@ -1237,7 +1236,6 @@ void Processing::run()
                 params3->api["chat_id"] = chatId;
                 params3->api["text"] = botMsg;
                 params3->api["parse_mode"] = "Markdown";
-                params3->delay = 800 /*0.8 сек*/;
                 emit sendTgCommand(params3);
 
                 if (TriggerTimeLimit* trg = dynamic_cast<TriggerTimeLimit*>(trigger))
@@ -1259,7 +1257,6 @@ void Processing::run()
                         params->api["chat_id"] = chatId;
                         params->api["text"] = message;
                         params->api["parse_mode"] = "HTML";
-                        params->delay = 1.2*1000 /*1.2 сек*/;
                         params->messageDel = 3*60 /*3 мин*/;
                         emit sendTgCommand(params);
                     }
@@ -1283,7 +1280,6 @@ void Processing::run()
                         params->api["user_id"] = user->id;
                         params->api["until_date"] = qint64(std::time(nullptr));
                         params->api["revoke_messages"] = true;
-                        params->delay = 200 /*0.2 сек*/;
                         emit sendTgCommand(params);
 
                         // Отправляем в Телеграм сообщение с описанием причины
@@ -1322,7 +1318,6 @@ void Processing::run()
                         params2->api["chat_id"] = chatId;
                         params2->api["text"] = botMsg;
                         params2->api["parse_mode"] = "Markdown";
-                        params2->delay = 500 /*0.5 сек*/;
                         emit sendTgCommand(params2);
 
                         return true;
@@ -1381,6 +1376,33 @@ void Processing::run()
 
             bool messageDeleted = false;
             bool userBanned = false;
+            bool triggerActivated = false;
+
+            // Вердикт проверки BIO не зависит от группы, если ни один триггер
+            // не был пропущен из-за прав или белого списка пользователя
+            bool bioVerdictShared = true;
+
+            // Ключ набора BIO-триггеров группы для кеша BIO. Значение 0 -
+            // вердикт не кешируется: результат триггера TriggerTimeLimit
+            // зависит от времени проверки
+            auto bioTriggerKey = [&]() -> quint64
+            {
+                QStringList names;
+                for (Trigger* trigger : chat->triggers)
+                {
+                    if (!trigger->active || !trigger->checkBio)
+                        continue;
+
+                    if (dynamic_cast<TriggerTimeLimit*>(trigger))
+                        return 0;
+
+                    names.append(trigger->name);
+                }
+                return BioCache::triggerKey(names, isNewUser);
+            };
+
+            // Результаты сопоставления предыдущего сообщения не действительны
+            Trigger::clearMatchResults();
 
             for (Trigger* trigger : chat->triggers)
             {
@@ -1393,8 +1415,9 @@ void Processing::run()
                 }
 
                 // Для анализа новых пользователей используются следующие триггеры:
-                // TriggerRegexp, TriggerBlackUser, TriggerBigId
+                // TriggerRegexp, TriggerFuzzy, TriggerBlackUser, TriggerBigId
                 bool newUserAllowedTrigger = dynamic_cast<TriggerRegexp*>(trigger)
+                                             || dynamic_cast<TriggerFuzzy*>(trigger)
                                              || dynamic_cast<TriggerBlackUser*>(trigger)
                                              || dynamic_cast<TriggerBigId*>(trigger);
                 if (isNewUser && !newUserAllowedTrigger)
@@ -1409,6 +1432,7 @@ void Processing::run()
                 // Проверка пользователя на принадлежность к списку администраторов
                 if (trigger->skipAdmins && adminIds.contains(user->id))
                 {
+                    bioVerdictShared = false;
                     log_verbose_m << log_format(
                         u8"\"update_id\":%?. Chat: %?. Trigger '%?' skipped, user %?/%?/@%?/%? is admin",
                         update.update_id, chat->name(), trigger->name,
@@ -1419,6 +1443,7 @@ void Processing::run()
                 // Проверка пользователя на принадлежность к белому списку триггера
                 if (trigger->whiteUsers.contains(user->id))
                 {
+                    bioVerdictShared = false;
                     log_verbose_m << log_format(
                         u8"\"update_id\":%?. Chat: %?. Trigger '%?' skipped, user %?/%?/@%?/%? in trigger whitelist",
                         update.update_id, chat->name(), trigger->name,
@@ -1434,6 +1459,8 @@ void Processing::run()
                 if (!triggerActive)
                     continue;
 
+                triggerActivated = true;
+
                 // Если триггер активирован, то запускаем механизмы удаления сообщения
                 // и бана пользователя
 
@@ -1468,13 +1495,36 @@ void Processing::run()
                 break;
             }
 
-            // Отправляем запрос на получение BIO
+            // Вердикт проверки BIO сохраняется в кеше и используется во всех
+            // группах с таким же набором BIO-триггеров
+            if (isBioMessage && bioVerdictShared)
+                if (quint64 triggerKey = bioTriggerKey())
+                    bioCache().setVerdict(user->id, triggerKey, triggerActivated);
+
+            // BIO пользователя, которое недавно проверялось тем же  набором
+            // триггеров и не активировало ни одного из них, повторно не про-
+            // веряется
+            bool bioClean = false;
             if (chat->checkBio
                 && !isBioMessage && !messageDeleted && !userBanned)
+            {
+                if (quint64 triggerKey = bioTriggerKey())
+                    bioClean = (bioCache().verdict(user->id, triggerKey)
+                                == BioCache::Verdict::Clean);
+                if (bioClean)
+                    log_verbose_m << log_format(
+                        u8"\"update_id\":%?. Chat: %?. BIO check skipped, user %?/%?/@%?/%?"
+                        u8" has clean BIO in cache",
+                        update.update_id, chat->name(),
+                        user->first_name, user->last_name, user->username, user->id);
+            }
+
+            // Отправляем запрос на получение BIO
+            if (chat->checkBio && !bioClean
+                && !isBioMessage && !messageDeleted && !userBanned)
             {
                 auto params = tgfunction("getChat");
                 params->api["chat_id"] = user->id;
-                params->delay = 200 /*0.2 сек*/;
                 params->bio.userId = user->id;
                 params->bio.chatId = chatId;
                 params->bio.updateId = update.update_id;
@@ -1532,7 +1582,6 @@ void Processing::run()
                         params2->api["chat_id"] = chatId;
                         params2->api["text"] = botMsg;
                         params2->api["parse_mode"] = "Markdown";
-                        params2->delay = 500 /*0.5 сек*/;
                         emit sendTgCommand(params2);
                     }
                     else
@@ -1557,7 +1606,6 @@ void Processing::run()
                         params->api["chat_id"] = chatId;
                         params->api["text"] = botMsg;
                         params->api["parse_mode"] = "Markdown";
-                        params->delay = 500 /*0.5 сек*/;
                         emit sendTgCommand(params);
                     }
                 }
@@ -1576,7 +1624,6 @@ void Processing::run()
                     params->api["chat_id"] = chatId;
                     params->api["text"] = botMsg;
                     params->api["parse_mode"] = "Markdown";
-                    params->delay = 100 /*0.1 сек*/;
                     emit sendTgCommand(params);
                 }
             }
@@ -1610,14 +1657,9 @@ void Processing::run()
                     fuzzyText->time = std::time(nullptr);
                     fuzzyText->timeLife = fuzzyText->time + 1*60*60 /*1 час*/;
 
-                    const u32string text32 = fuzzyText->text.toLower().toStdU32String();
-                    fuzzyText->fuzzyCache = data::FuzzyText::FuzzyCachePtr::create(text32);
-
                     // Получение списка идентичных сообщений
                     data::FuzzyText::List list = fuzzyTexts().textSimilarity(fuzzyText);
 
-                    fuzzyTexts().add(fuzzyText);
-
                     bool spamMessage = false;
                     for (data::FuzzyText* ft : list)
                         if (ft->spam)
@@ -1626,6 +1668,41 @@ void Processing::run()
                             break;
                         }
 
+                    // Обнаружение спам-кампании: текст (или ссылки на домен)
+                    // за короткое время появились в нескольких группах или
+                    // от нескольких новых пользователей. Текст кампании
+                    // отмечается как спам, после этого его копии удаляются
+                    if (!spamMessage)
+                    {
+                        bool newUser = false;
+                        if (data::UserJoinTime::Ptr ujt =
+                                userJoinTimes().find(tuple{chatId, user->id}))
+                        {
+                            qint64 diffTime = std::abs(ujt->time - fuzzyText->time);
+                            newUser = (diffTime <= 72*60*60 /*72 часа*/);
+                        }
+
+                        CampaignDetector::Verdict verdict = campaignDetector().update(
+                            chatId, user->id, newUser, text, fuzzyText->time);
+
+                        if (verdict.campaign)
+                        {
+                            log_verbose_m << log_format(
+                                u8"Spam campaign detected (message_id: %?)"
+                                u8". Chats/NewUsers: %?/%?, domain: %?/%?"
+                                u8". Chat: %?, user %?/%?/@%?/%?. Text: %?",
+                                messageId, verdict.chats, verdict.newUsers,
+                                verdict.domain, verdict.domainNewUsers, chat->name(),
+                                user->first_name, user->last_name, user->username, user->id,
+                                fuzzyText->text);
+
+                            fuzzyText->spam = true;
+                            spamMessage = true;
+                        }
+                    }
+
+                    fuzzyTexts().add(fuzzyText);
+
                     // Найдено идентичное сообщение отмеченное администратором как спам
                     if (spamMessage)
                     {
@@ -1644,7 +1721,6 @@ void Processing::run()
                             auto params = tgfunction("deleteMessage");
                             params->api["chat_id"] = chatId;
                             params->api["message_id"] = messageId;
-                            params->delay = 100 /*мсек*/;
                             emit sendTgCommand(params);
 
                             QString botMsg =
@@ -1664,7 +1740,6 @@ void Processing::run()
                             params2->api["chat_id"] = chatId;
                             params2->api["text"] = botMsg;
                             params2->api["parse_mode"] = "HTML";
-                            params2->delay = 200 /*мсек*/;
                             emit sendTgCommand(params2);
                         }
 
@@ -1705,7 +1780,6 @@ void Processing::run()
                             params->api["chat_id"] = spamCollectorChatId;
                             params->api["text"] = botMsg;
                             params->api["parse_mode"] = "Markdown";
-                            params->delay = 100 /*мсек*/;
                             params->messageDel = -1;
                             emit sendTgCommand(params);
 
@@ -1713,7 +1787,6 @@ void Processing::run()
                             params2->api["chat_id"] = spamCollectorChatId;
                             params2->api["text"] = fuzzyText->text;
                             params2->api["parse_mode"] = "HTML";
-                            params2->delay = 150 /*мсек*/;
                             params2->messageDel = -1;
                             emit sendTgCommand(params2);
 
@@ -1721,7 +1794,6 @@ void Processing::run()
                             params3->api["chat_id"] = spamCollectorChatId;
                             params3->api["text"] = "---";
                             params3->api["parse_mode"] = "HTML";
-                            params3->delay = 200 /*мсек*/;
                             params3->messageDel = -1;
                             emit sendTgCommand(params3);
                         }
@@ -1742,7 +1814,7 @@ void Processing::run()
                         if (GroupChat* chat = chats.findItem(&ft->chatId))
                         {
                             chatName = chat->name();
-                            botInfoFt = chat->botInfo();
+                            botInfoFt = chat->runtime()->botInfo;
                         }
 
                         if (chatName.isEmpty())
@@ -1778,7 +1850,6 @@ void Processing::run()
                                 auto params = tgfunction("deleteMessage");
                                 params->api["chat_id"] = ft->chatId;
                                 params->api["message_id"] = ft->messageId;
-                                params->delay = k * 200 /*мсек*/;
                                 emit sendTgCommand(params);
 
                                 QString botMsg =
@@ -1798,7 +1869,6 @@ void Processing::run()
                                 params2->api["chat_id"] = ft->chatId;
                                 params2->api["text"] = botMsg;
                                 params2->api["parse_mode"] = "HTML";
-                                params2->delay = k * 200 + 100 /*мсек*/;
                                 emit sendTgCommand(params2);
 
                                 // Отправляем отчет о спаме
@@ -1831,7 +1901,6 @@ void Processing::run()
                                 params->api["chat_id"] = spamCollectorChatId;
                                 params->api["text"] = botMsg;
                                 params->api["parse_mode"] = "Markdown";
-                                params->delay = 100 /*0.10 сек*/;
                                 params->messageDel = -1;
                                 emit sendTgCommand(params);
 
@@ -1839,7 +1908,6 @@ void Processing::run()
                                 params2->api["chat_id"] = spamCollectorChatId;
                                 params2->api["text"] = ft->text;
                                 params2->api["parse_mode"] = "HTML";
-                                params2->delay = 150 /*0.15 сек*/;
                                 params2->messageDel = -1;
                                 emit sendTgCommand(params2);
 
@@ -1847,7 +1915,6 @@ void Processing::run()
                                 params3->api["chat_id"] = spamCollectorChatId;
                                 params3->api["text"] = "---";
                                 params3->api["parse_mode"] = "HTML";
-                                params3->delay = 200 /*0.20 сек*/;
                                 params3->messageDel = -1;
                                 emit sendTgCommand(params3);
                             }
@@ -1858,7 +1925,7 @@ void Processing::run()
             }
 
             // Проверка на Anti-Raid режим
-            if (chat->antiRaid.active && chat->antiRaidTurnOn
+            if (chat->antiRaid.active && chat->antiRaidTurnOn()
                 && !isBioMessage && !messageDeleted && !userBanned)
             {
                 emit antiRaidMessage(chatId, user->id, messageId);
@@ -66,8 +66,18 @@ struct TgParams
     // Идентификатор спам-сообщения, используется как признак информационного
     // сообщения о спаме
     qint32 spamMessageId = {0};
+
+    // Тело http запроса в формате JSON. Формируется из параметров api один
+    // раз при первой отправке команды, при повторных попытках используется
+    // готовое значение
+    QByteArray body;
 };
 
+// Сериализует параметры Телеграм-команды в JSON. Значения типа QByteArray
+// содержат JSON-документ (например ChatPermissions) и включаются в  тело
+// запроса как объекты/массивы, остальные значения сохраняют свой тип
+QByteArray tgRequestBody(const QMap<QString, QVariant>& api);
+
 inline TgParams::Ptr tgfunction(const char* funcName)
 {
     TgParams::Ptr p = TgParams::Ptr::create_join();
@@ -0,0 +1,94 @@
+#include "request_coalescer.h"
+
+#include "shared/break_point.h"
+#include "shared/logger/logger.h"
+#include "shared/logger/format.h"
+
+#define log_error_m   alog::logger().error  (alog_line_location, "RequestCoalescer")
+#define log_warn_m    alog::logger().warn   (alog_line_location, "RequestCoalescer")
+#define log_info_m    alog::logger().info   (alog_line_location, "RequestCoalescer")
+#define log_verbose_m alog::logger().verbose(alog_line_location, "RequestCoalescer")
+#define log_debug_m   alog::logger().debug  (alog_line_location, "RequestCoalescer")
+#define log_debug2_m  alog::logger().debug2 (alog_line_location, "RequestCoalescer")
+
+namespace tbot {
+
+// Интервал вывода статистики объединения запросов в лог (мсек)
+static const qint64 reportInterval = 10*60*1000 /*10 мин*/;
+
+// Время (мсек), после которого выполняемый запрос считается потерянным.
+// Превышает суммарное время повторных попыток для служебных запросов
+static const qint64 pendingTimeout = 15*60*1000 /*15 мин*/;
+
+bool RequestCoalescer::coalescible(const QString& funcName)
+{
+    return (funcName == "getChat")
+           || (funcName == "getChatAdministrators");
+}
+
+RequestCoalescer::Key RequestCoalescer::key(const TgParams& params)
+{
+    return {params.funcName, params.api["chat_id"].toLongLong()};
+}
+
+bool RequestCoalescer::attach(const TgParams::Ptr& params, qint64 now)
+{
+    const Key key = this->key(*params);
+    _statsChanged = true;
+
+    auto it = _pending.find(key);
+    if ((it != _pending.end()) && (now - it->time < pendingTimeout))
+    {
+        it->waiters.append(params);
+        ++_stats.coalesced;
+
+        log_debug2_m << log_format(
+            "Call %? (chat_id: %?) attached to pending request. Waiters: %?",
+            key.first, key.second, it->waiters.count());
+
+        report(now);
+        return true;
+    }
+
+    if (it != _pending.end())
+    {
+        _stats.dropped += it->waiters.count();
+        log_warn_m << log_format(
+            "Pending request %? (chat_id: %?) timed out. Dropped waiters: %?",
+            key.first, key.second, it->waiters.count());
+    }
+
+    Pending& pending = _pending[key];
+    pending.time = now;
+    pending.waiters.clear();
+    ++_stats.requests;
+
+    report(now);
+    return false;
+}
+
+QVector<TgParams::Ptr> RequestCoalescer::take(const TgParams& params)
+{
+    return _pending.take(key(params)).waiters;
+}
+
+void RequestCoalescer::clear()
+{
+    _pending.clear();
+}
+
+void RequestCoalescer::report(qint64 now)
+{
+    if (!_statsChanged || (now - _reportTime < reportInterval))
+        return;
+
+    log_info_m << log_format(
+        "Coalescing stat. Requests: %?, attached calls: %?, dropped calls: %?"
+        ", pending: %?",
+        _stats.requests, _stats.coalesced, _stats.dropped, _pending.count());
+
+    _statsChanged = false;
+    _reportTime = now;
+}
+
+} // namespace tbot
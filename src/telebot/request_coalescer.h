@@ -0,0 +1,69 @@
+#pragma once
+
+#include "processing.h"
+
+#include <QtCore>
+
+namespace tbot {
+
+/**
+  Объединение одинаковых запросов getChat и getChatAdministrators. Запрос
+  идентифицируется парой (функция, chat_id). Если аналогичный запрос уже
+  ожидает отправки или выполняется, то новая команда присоединяется к нему
+  и в Телеграм не отправляется. После получения ответа он обрабатывается
+  для основной команды и для каждой присоединенной команды с ее собствен-
+  ными параметрами (например, BIO-сообщение формируется для каждого сооб-
+  щения пользователя).
+
+  Повторные попытки основной команды не меняют состав группы. Если основная
+  команда завершилась ошибкой без повторных попыток, то присоединенные  ко-
+  манды отбрасываются.
+
+  Класс не является потокобезопасным, используется в потоке приложения
+*/
+class RequestCoalescer
+{
+public:
+    // Функция поддерживает объединение запросов
+    static bool coalescible(const QString& funcName);
+
+    // Регистрирует команду, now - текущее время (мсек). Возвращает TRUE если
+    // команда присоединена к выполняемому запросу и не должна отправляться
+    bool attach(const TgParams::Ptr&, qint64 now);
+
+    // Завершает запрос, соответствующий команде, и возвращает присоединенные
+    // к нему команды
+    QVector<TgParams::Ptr> take(const TgParams&);
+
+    int count() const {return _pending.count();}
+    void clear();
+
+private:
+    typedef QPair<QString /*функция*/, qint64 /*chat id*/> Key;
+
+    static Key key(const TgParams&);
+
+    // Выводит в лог статистику объединения запросов, не чаще одного раза
+    // за интервал reportInterval
+    void report(qint64 now);
+
+private:
+    struct Pending
+    {
+        qint64 time = {0}; // Время регистрации основной команды
+        QVector<TgParams::Ptr> waiters;
+    };
+    QHash<Key, Pending> _pending;
+
+    struct Stats
+    {
+        int requests  = {0}; // Количество отправленных запросов
+        int coalesced = {0}; // Количество присоединенных команд
+        int dropped   = {0}; // Количество отброшенных команд
+    };
+    Stats _stats;
+    bool _statsChanged = {false};
+    qint64 _reportTime = {0};
+};
+
+} // namespace tbot
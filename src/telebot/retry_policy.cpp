@@ -0,0 +1,168 @@
+#include "retry_policy.h"
+
+#include "shared/break_point.h"
+#include "shared/logger/logger.h"
+#include "shared/logger/format.h"
+
+#include <algorithm>
+#include <chrono>
+
+#define log_error_m   alog::logger().error  (alog_line_location, "RetryPolicy")
+#define log_warn_m    alog::logger().warn   (alog_line_location, "RetryPolicy")
+#define log_info_m    alog::logger().info   (alog_line_location, "RetryPolicy")
+#define log_verbose_m alog::logger().verbose(alog_line_location, "RetryPolicy")
+#define log_debug_m   alog::logger().debug  (alog_line_location, "RetryPolicy")
+#define log_debug2_m  alog::logger().debug2 (alog_line_location, "RetryPolicy")
+
+namespace tbot {
+
+// Интервал вывода статистики повторных вызовов в лог (мсек)
+static const qint64 reportInterval = 10*60*1000 /*10 мин*/;
+
+static const char* className(RetryPolicy::MethodClass mc)
+{
+    switch (mc)
+    {
+        case RetryPolicy::MethodClass::High:   return "moderation";
+        case RetryPolicy::MethodClass::Normal: return "message";
+        case RetryPolicy::MethodClass::Low:    return "chat-info";
+    }
+    return "unknown";
+}
+
+RetryPolicy::RetryPolicy()
+    : _generator(std::random_device()())
+{}
+
+RetryPolicy::Backoff RetryPolicy::backoff(MethodClass mc)
+{
+    switch (mc)
+    {
+        // Удаление сообщений и блокировка пользователей
+        case MethodClass::High:
+            return {4, 5*1000 /*5 сек*/, 60*1000 /*60 сек*/, false};
+
+        // Повторная отправка сообщения после сетевой ошибки может привести
+        // к дублированию сообщения, поэтому сообщения повторяются только
+        // после ошибки 429 (запрос не был выполнен)
+        case MethodClass::Normal:
+            return {3, 5*1000 /*5 сек*/, 60*1000 /*60 сек*/, true};
+
+        // Запросы getChat/getChatAdministrators
+        case MethodClass::Low:
+            return {7, 20*1000 /*20 сек*/, 3*60*1000 /*3 мин*/, false};
+    }
+    return {1, 0, 0, true};
+}
+
+bool RetryPolicy::isPermanent(int errorCode)
+{
+    // Ошибки клиента (400 - сообщение не найдено, 403 - бот удален из группы
+    // и т.п.), кроме превышения лимита запросов
+    return (errorCode >= 400) && (errorCode < 500) && (errorCode != 429);
+}
+
+RetryPolicy::Decision RetryPolicy::decide(const QString& funcName, int attempt,
+                                          int errorCode, int retryAfter)
+{
+    using namespace std::chrono;
+    const qint64 now =
+        duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+
+    const MethodClass mc = OutboundScheduler::priority(funcName);
+    const Backoff bo = backoff(mc);
+    Stats& stats = _stats[int(mc)];
+
+    Decision decision;
+    _statsChanged = true;
+
+    if (isPermanent(errorCode))
+    {
+        decision.permanent = true;
+        ++stats.permanent;
+
+        log_verbose_m << log_format(
+            "Call %? failed with permanent error %? (attempt: %?). Not retried",
+            funcName, errorCode, attempt);
+        report(now);
+        return decision;
+    }
+
+    if (errorCode == 429)
+    {
+        // Если Телеграм не сообщил время ожидания, то ожидаем одну секунду
+        decision.floodWait = qint64(std::max(retryAfter, 1)) * 1000;
+        ++stats.floodWaits;
+
+        log_warn_m << log_format(
+            "Call %? exceeded flood limit, retry after %? sec. Calls of class"
+            " '%?' are suspended",
+            funcName, decision.floodWait / 1000, className(mc));
+    }
+    else if (bo.onlyFlood)
+    {
+        log_verbose_m << log_format(
+            "Call %? failed with error %? (attempt: %?). Not retried",
+            funcName, errorCode, attempt);
+        report(now);
+        return decision;
+    }
+
+    if (attempt >= bo.maxAttempts)
+    {
+        ++stats.exhausted;
+        log_error_m << log_format(
+            "Call %? failed with error %?. Retry attempts exhausted (%?)",
+            funcName, errorCode, attempt);
+        report(now);
+        return decision;
+    }
+
+    if (decision.floodWait > 0)
+    {
+        // Небольшое случайное отклонение исключает одновременную отправку
+        // всех задержанных команд после окончания ожидания
+        std::uniform_int_distribution<int> jitter {0, 500};
+        decision.delay = decision.floodWait + jitter(_generator);
+    }
+    else
+    {
+        qint64 delay = bo.baseDelay << std::min(attempt - 1, 16);
+        delay = std::min(delay, bo.maxDelay);
+
+        // Отклонение +/- 20%
+        std::uniform_real_distribution<double> jitter {0.8, 1.2};
+        decision.delay = qint64(delay * jitter(_generator));
+    }
+    decision.retry = true;
+
+    ++stats.retries;
+    stats.waitTime += decision.delay;
+
+    log_verbose_m << log_format(
+        "Call %? failed with error %? (attempt: %?). Retry through %? ms",
+        funcName, errorCode, attempt, decision.delay);
+
+    report(now);
+    return decision;
+}
+
+void RetryPolicy::report(qint64 now)
+{
+    if (!_statsChanged || (now - _reportTime < reportInterval))
+        return;
+
+    for (int i = 0; i < ClassCount; ++i)
+    {
+        const Stats& stats = _stats[i];
+        log_info_m << log_format(
+            "Retry stat for class '%?'. Retries: %?, flood waits: %?"
+            ", permanent errors: %?, attempts exhausted: %?, wait time: %? sec",
+            className(MethodClass(i)), stats.retries, stats.floodWaits,
+            stats.permanent, stats.exhausted, stats.waitTime / 1000);
+    }
+    _statsChanged = false;
+    _reportTime = now;
+}
+
+} // namespace tbot
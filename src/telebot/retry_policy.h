@@ -0,0 +1,93 @@
+#pragma once
+
+#include "outbound_scheduler.h"
+
+#include <QtCore>
+#include <random>
+
+namespace tbot {
+
+/**
+  Политика повторных вызовов Телеграм-функций, завершившихся ошибкой.
+
+  Ошибки делятся на временные и постоянные. Временные ошибки: сетевые ошиб-
+  ки (ответ не получен), ошибки сервера (5xx) и превышение лимита запросов
+  (429). Постоянные ошибки (прочие 4xx: сообщение не найдено, недостаточно
+  прав и т.п.) при повторном вызове не исправятся, такие вызовы не повторя-
+  ются.
+
+  Для ошибки 429 повторный вызов выполняется через время, указанное Телеграм
+  в параметре retry_after, и на это же время приостанавливается  отправка
+  других команд того же класса. Для прочих временных ошибок используется
+  экспоненциальная задержка со случайным отклонением, параметры задержки
+  и количество попыток определяются классом функции.
+
+  Класс функции совпадает с классом приоритета планировщика исходящих команд.
+  Класс не является потокобезопасным, используется в потоке приложения
+*/
+class RetryPolicy
+{
+public:
+    typedef OutboundScheduler::Priority MethodClass;
+
+    struct Decision
+    {
+        bool retry = {false};
+
+        // Ошибка не исправится при повторном вызове
+        bool permanent = {false};
+
+        // Задержка повторного вызова (в миллисекундах)
+        qint64 delay = {0};
+
+        // Время (в миллисекундах), на которое должна быть приостановлена
+        // отправка команд того же класса
+        qint64 floodWait = {0};
+    };
+
+    struct Stats
+    {
+        int retries    = {0}; // Количество повторных вызовов
+        int floodWaits = {0}; // Количество ошибок 429
+        int permanent  = {0}; // Количество постоянных ошибок
+        int exhausted  = {0}; // Количество вызовов с исчерпанными попытками
+        qint64 waitTime = {0}; // Суммарное время ожидания (мсек)
+    };
+
+    RetryPolicy();
+
+    // Принимает решение о повторном вызове функции funcName. Параметр attempt -
+    // номер завершившейся попытки, errorCode - код ошибки из ответа Телеграм
+    // (0 если ответ не получен), retryAfter - значение параметра retry_after
+    // (в секундах)
+    Decision decide(const QString& funcName, int attempt,
+                    int errorCode, int retryAfter);
+
+    static bool isPermanent(int errorCode);
+
+private:
+    struct Backoff
+    {
+        int maxAttempts;   // Максимальное количество попыток (включая первую)
+        qint64 baseDelay;  // Задержка перед второй попыткой (мсек)
+        qint64 maxDelay;   // Максимальная задержка (мсек)
+        bool onlyFlood;    // Повторять только при ошибке 429
+    };
+
+    static Backoff backoff(MethodClass);
+
+    // Выводит в лог статистику повторных вызовов, не чаще одного раза
+    // за интервал reportInterval
+    void report(qint64 now);
+
+private:
+    static constexpr int ClassCount = 3;
+
+    Stats _stats[ClassCount];
+    bool _statsChanged = {false};
+    qint64 _reportTime = {0};
+
+    std::mt19937 _generator;
+};
+
+} // namespace tbot
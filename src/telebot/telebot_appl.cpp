@@ -3,6 +3,8 @@
 #include "trigger.h"
 #include "functions.h"
 #include "group_chat.h"
+#include "campaign_detector.h"
+#include "bio_cache.h"
 
 #include "shared/spin_locker.h"
 #include "shared/logger/logger.h"
@@ -30,55 +32,18 @@ namespace tbot {
 extern std::atomic_int globalConfigParceErrors;
 }
 
+// Монотонное время в миллисекундах, используется планировщиком исходящих
+// команд
+static qint64 steadyTime()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
 QUuidEx Application::_applId;
 volatile bool Application::_stop = false;
 std::atomic_int Application::_exitCode = {0};
 
-static quint64 httpReplyNumber = {0};
-
-static QByteArray unicodeDecode(const QByteArray& data)
-{
-    QString source = QString::fromUtf8(data);
-    QString dest; dest.reserve(source.length());
-
-    auto getUint8 = [](uchar h, uchar l) -> uchar
-    {
-        uint8_t ret = 0;
-
-        if      (h - '0' < 10) ret = h - '0';
-        else if (h - 'A' < 6 ) ret = h - 'A' + 0x0A;
-        else if (h - 'a' < 6 ) ret = h - 'a' + 0x0A;
-
-        ret = ret << 4;
-
-        if      (l - '0' < 10) ret |= l - '0';
-        else if (l - 'A' < 6 ) ret |= l - 'A' + 0x0A;
-        else if (l - 'a' < 6 ) ret |= l - 'a' + 0x0A;
-
-        return  ret;
-    };
-
-    for (auto&& it = source.cbegin(); it != source.cend(); ++it)
-    {
-        if (*it == QChar('\\')
-            && std::distance(it, source.cend()) > 5)
-        {
-            if (*(it + 1) == QChar('u'))
-            {
-                uchar c1 = getUint8((it + 2)->cell(), (it + 3)->cell());
-                uchar c2 = getUint8((it + 4)->cell(), (it + 5)->cell());
-
-                quint16 v = (c1 << 8) | c2;
-                dest.append(QChar(v));
-
-                it += 5;
-                continue;
-            }
-        }
-        dest.append(*it);
-    }
-    return dest.toUtf8();
-}
 
 void SslServer::incomingConnection(qintptr socketDescriptor)
 {
@@ -93,7 +58,6 @@ Application::Application(int& argc, char** argv)
     _stopTimerId         = startTimer(1000);
     _slaveTimerId        = startTimer(10*1000 /*10 сек*/);
     _antiraidTimerId     = startTimer( 2*1000 /* 2 сек*/);
-    _timelimitTimerId    = startTimer(15*1000 /*15 сек*/);
     _userJoinTimerId     = startTimer(30*1000 /*30 сек*/);
     _whiteUserTimerId    = startTimer(30*1000 /*30 сек*/);
     _spamUserTimerId     = startTimer(30*1000 /*30 сек*/);
@@ -122,9 +86,13 @@ Application::Application(int& argc, char** argv)
 
     #undef FUNC_REGISTRATION
 
-    qRegisterMetaType<ReplyData>("ReplyData");
+    qRegisterMetaType<tbot::HttpReply>("tbot::HttpReply");
     qRegisterMetaType<tbot::User::Ptr>("tbot::User::Ptr");
     qRegisterMetaType<tbot::TgParams::Ptr>("tbot::TgParams::Ptr");
+    qRegisterMetaType<tbot::GroupsLoader::Result::Ptr>("tbot::GroupsLoader::Result::Ptr");
+
+    chk_connect_q(&_groupsLoader, &tbot::GroupsLoader::loaded,
+                  this, &Application::groupsLoaded)
 }
 
 bool Application::init()
@@ -134,7 +102,6 @@ bool Application::init()
         return false;
 
     _webhookServer = SslServer::Ptr::create();
-    _networkAccManager = QNetworkAccessManagerPtr::create();
 
     chk_connect_a(_webhookServer.get(), &QTcpServer::newConnection,
                   this, &Application::webhook_newConnection)
@@ -148,8 +115,22 @@ bool Application::init()
     _localServerPort = 0;
     config::base().getValue("local_server.port", _localServerPort);
 
-    quint16 port = 0;
+    // Unix-сокеты для обмена с локальным telegram-bot сервером
+    QString unixSocket;
+    QString webhookSocket;
     if (_localServer)
+    {
+        config::base().getValue("local_server.unix_socket", unixSocket);
+        config::base().getValue("local_server.webhook_socket", webhookSocket);
+    }
+
+    quint16 port = 0;
+    if (_localServer && !webhookSocket.isEmpty())
+    {
+        log_verbose_m << "Start webhook local-server"
+                      << ". Unix socket: " << webhookSocket;
+    }
+    else if (_localServer)
     {
         config::base().getValue("local_server.webhook_port", port);
         log_verbose_m << "Start webhook local-server"
@@ -164,7 +145,39 @@ bool Application::init()
                       << ". Port: " << port;
     }
 
-    if (!_webhookServer->listen(QHostAddress::AnyIPv4, port))
+    if (!webhookSocket.isEmpty())
+    {
+        _webhookLocalServer = container_ptr<QLocalServer>::create();
+
+        chk_connect_a(_webhookLocalServer.get(), &QLocalServer::newConnection,
+                      this, &Application::webhook_newLocalConnection)
+
+        QString name = webhookSocket;
+        if (webhookSocket.startsWith(QChar('@')))
+        {
+            // Абстрактный Unix-сокет (Linux)
+            name = webhookSocket.mid(1);
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 2, 0))
+            _webhookLocalServer->setSocketOptions(QLocalServer::AbstractNamespaceOption);
+#else
+            log_error_m << "Abstract unix sockets are supported since Qt 6.2";
+            return false;
+#endif
+        }
+        else
+        {
+            // Файл сокета мог остаться после аварийного завершения программы
+            QLocalServer::removeServer(name);
+        }
+
+        if (!_webhookLocalServer->listen(name))
+        {
+            log_error_m << "Failed start unix socket server"
+                        << ". Error: " << _webhookLocalServer->errorString();
+            return false;
+        }
+    }
+    else if (!_webhookServer->listen(QHostAddress::AnyIPv4, port))
     {
         log_error_m << "Failed start TCP-server"
                     << ". Error: " << _webhookServer->errorString();
@@ -218,12 +231,51 @@ bool Application::init()
         }
     }
 
+    QString urlStr = "https://api.telegram.org";
+    if (_localServer && !unixSocket.isEmpty())
+    {
+        // При обмене через Unix-сокет адрес используется только для
+        // формирования пути запроса
+        urlStr = "http://localhost";
+    }
+    else if (_localServer)
+    {
+        urlStr = "http://%1:%2";
+        urlStr = urlStr.arg(_localServerAddr).arg(_localServerPort);
+    }
+    urlStr += "/bot%1/";
+    urlStr = urlStr.arg(_botId);
+
+    int httpThreads = 1;
+    config::base().getValue("outbound.http_threads", httpThreads);
+
+    tbot::HttpClient::Params httpParams;
+    httpParams.url = urlStr;
+    httpParams.unixSocket = unixSocket;
+    config::base().getValue("outbound.http2", httpParams.http2);
+    config::base().getValue("outbound.max_in_flight", httpParams.maxInFlight);
+    httpParams.maxInFlight = qBound(1, httpParams.maxInFlight, 100);
+
+    for (int i = 0; i < qBound(1, httpThreads, 8); ++i)
+    {
+        tbot::HttpClient* client = new tbot::HttpClient(i + 1, httpParams);
+        client->setPrintLog(_printGetChat, _printGetChatAdmins);
+
+        chk_connect_q(client, &tbot::HttpClient::finished,
+                      this, &Application::http_finished)
+
+        _httpClients.add(client);
+        client->start();
+    }
+
     loadReportSpam();
     reportSpam(0, {}); // Выводим в лог текущий спам-список
 
     loadBotCommands();
     loadAntiRaidCache();
 
+    _groupsLoader.start();
+
     // Делаем небольшую задержку, чтобы telegram-bot-api сервис
     // успел запуститься
     QTimer::singleShot(5*1000 /*5 сек*/, [this](){startRequest();});
@@ -243,6 +295,8 @@ void Application::deinit()
     for (tbot::Processing* p : _procList)
         p->stop();
 
+    _groupsLoader.stop();
+
     for (auto&& it = _webhookMap.cbegin(); it != _webhookMap.cend(); ++it)
     {
         const WebhookData& wd = it.value();
@@ -253,24 +307,27 @@ void Application::deinit()
         QObject::disconnect(wd.socket, nullptr, this, nullptr);
     }
 
-    for (auto&& it = _httpReplyMap.cbegin(); it != _httpReplyMap.cend(); ++it)
+    for (tbot::HttpClient* client : _httpClients)
     {
-        const ReplyData& rd = it.value();
-        log_debug_m << log_format(
-            "QObject::disconnect(). Http reply id: %?", rd.replyNumber);
-
-        QObject::disconnect(rd.reply, nullptr, this, nullptr);
+        QObject::disconnect(client, nullptr, this, nullptr);
+        client->stop();
     }
 
     _procList.clear();
     _webhookServer->close();
+    if (!_webhookLocalServer.empty())
+        _webhookLocalServer->close();
 
     _webhookServer.reset();
-    _networkAccManager.reset();
+    _webhookLocalServer.reset();
+    _httpClients.clear();
 
     saveReportSpam();
     saveAntiRaidCache();
 
+    if (_timingWheel.changed())
+        saveDelayedCommands();
+
     qint64 timemark = QDateTime::currentDateTimeUtc().toMSecsSinceEpoch();
 
     if (tbot::userJoinTimes().changed())
@@ -304,6 +361,7 @@ void Application::timerEvent(QTimerEvent* event)
             KILL_TIMER(_slaveTimerId)
             KILL_TIMER(_antiraidTimerId)
             KILL_TIMER(_timelimitTimerId)
+            KILL_TIMER(_outboundTimerId)
             KILL_TIMER(_userJoinTimerId)
             KILL_TIMER(_whiteUserTimerId)
             KILL_TIMER(_fuzzyTextTimerId)
@@ -375,12 +433,12 @@ void Application::timerEvent(QTimerEvent* event)
             if (!chat->antiRaid.active)
                 continue;
 
-            if (chat->antiRaidTurnOn)
+            if (chat->antiRaidTurnOn())
             {
                 QDateTime currentTime = QDateTime::currentDateTimeUtc();
                 if ((currentTime > antiRaid->deactiveTime) || !chat->antiRaid.active)
                 {
-                    chat->antiRaidTurnOn = false;
+                    chat->setAntiRaidTurnOn(false);
                     antiRaid->deactiveTime = QDateTime();
 
                     log_verbose_m << log_format("Chat: %?. Anti-Raid mode turn off",
@@ -412,7 +470,7 @@ void Application::timerEvent(QTimerEvent* event)
                 if (antiRaid->usersTmp.count() >= usersLimit)
                 {
                     // Активируем Anti-Raid режим
-                    chat->antiRaidTurnOn = true;
+                    chat->setAntiRaidTurnOn(true);
 
                     log_verbose_m << log_format("Chat: %?. Anti-Raid mode turn on",
                                                 chat->name());
@@ -456,7 +514,7 @@ void Application::timerEvent(QTimerEvent* event)
                         u8"\r\n%1";
 
                     QString anames;
-                    for (const QString& s : chat->adminNames())
+                    for (const QString& s : chat->runtime()->adminNames)
                         anames += "@" + s + " ";
 
                     auto params = tbot::tgfunction("sendMessage");
@@ -483,19 +541,20 @@ void Application::timerEvent(QTimerEvent* event)
                 && !antiRaid->skipMessageIds
                 && !antiRaid->sleepMsgCount)
             {
-                qint32 messageId = antiRaid->messageIds[0];
+                // Сообщения удаляются пакетами, следующий пакет отправляется
+                // после подтверждения удаления текущего пакета
+                QList<qint32> messageIds =
+                    antiRaid->messageIds.mid(0, tbot::DeleteAggregator::MaxBatch);
                 antiRaid->skipMessageIds = true;
                 antiRaid->skipMessageIdsTimer.reset();
 
-                auto params = tbot::tgfunction("deleteMessage");
-                params->api["chat_id"] = chatId;
-                params->api["message_id"] = messageId;
+                auto params = tbot::DeleteAggregator::command(chatId, messageIds);
                 params->isAntiRaid = true;
                 sendTgCommand(params);
 
                 log_verbose_m << log_format(
-                    "Chat: %?. Anti-Raid mode active, remove message %?",
-                    chat->name(), messageId);
+                    "Chat: %?. Anti-Raid mode active, remove %? message(s)",
+                    chat->name(), messageIds.count());
             }
         }
 
@@ -513,7 +572,6 @@ void Application::timerEvent(QTimerEvent* event)
             auto params = tbot::tgfunction("deleteMessage");
             params->api["chat_id"] = adjacentMsg->chatId;
             params->api["message_id"] = adjacentMsg->messageId;
-            params->delay = 200 /*0.2 сек*/;
             sendTgCommand(params);
 
             if (!adjacentMsg->text.trimmed().isEmpty())
@@ -529,7 +587,6 @@ void Application::timerEvent(QTimerEvent* event)
                 params2->api["chat_id"] = adjacentMsg->chatId;
                 params2->api["text"] = botMsg.arg(adjacentMsg->text);
                 params2->api["parse_mode"] = "HTML";
-                params2->delay = 1*1000 /*1 сек*/;
                 sendTgCommand(params2);
             }
         };
@@ -596,26 +653,6 @@ void Application::timerEvent(QTimerEvent* event)
                 }
         }
 
-        //--- DeleteDelay ---
-        bool deleteDelayActive = false;
-        qint64 currentTime = QDateTime::currentDateTimeUtc().toMSecsSinceEpoch();
-        for (int i = 0; i < _deleteDelays.count(); ++i)
-        {
-            const data::DeleteDelay& dd = _deleteDelays[i];
-            if (currentTime > dd.deleteTime)
-            {
-                auto params = tbot::tgfunction("deleteMessage");
-                params->api["chat_id"] = dd.chatId;
-                params->api["message_id"] = dd.messageId;
-                sendTgCommand(params);
-
-                _deleteDelays.removeAt(i--);
-                deleteDelayActive = true;
-            }
-        }
-        if (deleteDelayActive)
-            updateBotCommands(delete_delay);
-
         //--- UserSpanInform ---
         for (int i = 0; i < _userSpanInforms.count(); ++i)
         {
@@ -696,11 +733,15 @@ void Application::timerEvent(QTimerEvent* event)
     }
     else if (event->timerId() == _timelimitTimerId)
     {
-        if (_masterMode || (_slaveSocket && !_slaveSocket->isConnected()))
-        {
-            // Проверяем необходимость публикации сообщений для timelimit триггеров
-            timelimitCheck();
-        }
+        KILL_TIMER(_timelimitTimerId)
+
+        // Публикуем сообщения для наступивших событий timelimit триггеров
+        timelimitCheck();
+    }
+    else if (event->timerId() == _outboundTimerId)
+    {
+        // Отправляем команды, ожидающие в очереди планировщика
+        outboundDispatch();
     }
     else if (event->timerId() == _userJoinTimerId)
     {
@@ -744,6 +785,9 @@ void Application::timerEvent(QTimerEvent* event)
     {
         if (config::state().changed())
             config::state().saveFile();
+
+        if (_timingWheel.changed())
+            saveDelayedCommands();
     }
     else if (event->timerId() == _updateAdminsTimerId)
     {
@@ -921,7 +965,7 @@ void Application::command_SlaveAuth(const Message::Ptr& message)
 
         data::DeleteDelaySync deleteDelaySync;
         deleteDelaySync.timemark = timemark;
-        deleteDelaySync.items = _deleteDelays;
+        deleteDelaySync.items = deleteDelays();
 
         m = createJsonMessage(deleteDelaySync);
         m->appendDestinationSocket(answer->socketDescriptor());
@@ -1085,6 +1129,7 @@ void Application::command_TimelimitSync(const Message::Ptr& message)
     {
         tbot::setTimelimitInactiveChats(timelimitSync.chats);
         saveBotCommands(timelimit_inactive, timelimitSync.timemark);
+        timelimitSchedule();
 
         log_verbose_m << "Updated 'timelimit' settings for groups";
     }
@@ -1159,7 +1204,7 @@ void Application::command_DeleteDelaySync(const Message::Ptr& message)
     // Для master и slave режимов перезаписываем устаревшие данные
     if (deleteDelaySync.timemark > timemark)
     {
-        _deleteDelays = deleteDelaySync.items;
+        setDeleteDelays(deleteDelaySync.items);
         saveBotCommands(delete_delay, deleteDelaySync.timemark);
 
         log_verbose_m << "Updated 'delete_delay' settings for groups";
@@ -1176,7 +1221,7 @@ void Application::command_DeleteDelaySync(const Message::Ptr& message)
 
             data::DeleteDelaySync deleteDelaySync;
             deleteDelaySync.timemark = timemark;
-            deleteDelaySync.items = _deleteDelays;
+            deleteDelaySync.items = deleteDelays();
 
             writeToJsonMessage(deleteDelaySync, answer);
             _slaveSocket->send(answer);
@@ -1409,6 +1454,30 @@ void Application::webhook_newConnection()
         socket->peerAddress(), socket->peerPort(), socket->socketDescriptor());
 }
 
+void Application::webhook_newLocalConnection()
+{
+    QLocalSocket* socket = _webhookLocalServer->nextPendingConnection();
+
+    chk_connect_a(socket, &QLocalSocket::readyRead,    this, &Application::webhook_readyRead);
+    chk_connect_a(socket, &QLocalSocket::disconnected, this, &Application::webhook_disconnected);
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    chk_connect_a(socket, &QLocalSocket::errorOccurred, this, &Application::webhook_localSocketError);
+#else
+    chk_connect_a(socket, qOverload<QLocalSocket::LocalSocketError>(&QLocalSocket::error),
+                  this,   &Application::webhook_localSocketError);
+#endif
+
+    quint64 socketId = reinterpret_cast<quint64>(socket);
+    WebhookData& wd = _webhookMap[socketId];
+    wd.socket = socket;
+    wd.socketDescr = socket->socketDescriptor();
+
+    log_debug_m << log_format(
+        "Webhook connection through unix socket. Socket descriptor: %?",
+        socket->socketDescriptor());
+}
+
 void Application::webhook_readyConnection()
 {
     QSslSocket* socket = qobject_cast<QSslSocket*>(sender());
@@ -1420,7 +1489,7 @@ void Application::webhook_readyConnection()
 
 void Application::webhook_disconnected()
 {
-    QSslSocket* socket = qobject_cast<QSslSocket*>(sender());
+    QIODevice* socket = qobject_cast<QIODevice*>(sender());
     quint64 socketId = reinterpret_cast<quint64>(socket);
 
     log_debug_m << log_format("Webhook disconnected. Socket descriptor: %?",
@@ -1432,7 +1501,7 @@ void Application::webhook_disconnected()
 
 void Application::webhook_readyRead()
 {
-    QSslSocket* socket = qobject_cast<QSslSocket*>(sender());
+    QIODevice* socket = qobject_cast<QIODevice*>(sender());
     QByteArray data = socket->readAll();
 
     log_debug_m << "Webhook TCP input: " << data;
@@ -1477,7 +1546,7 @@ void Application::webhook_readyRead()
 
     if (wd.data.size() == wd.dataSize)
     {
-        wd.data = unicodeDecode(wd.data);
+        wd.data = tbot::unicodeDecode(wd.data);
         int pos = wd.data.indexOf('\n');
         if (pos > 0)
             wd.data.remove(pos, 1);
@@ -1499,7 +1568,18 @@ void Application::webhook_readyRead()
                     tbot::GroupChat::List chats = tbot::groupChats();
 
                     lst::FindResult fr = chats.findRef(chatId);
-                    if (fr.failed())
+                    if (chats.empty())
+                    {
+                        // Конфигурация групп еще не загружена, сообщение будет
+                        // обработано после её публикации
+                        chatInList = false;
+                        if (_pendingUpdates.count() < 10000)
+                            _pendingUpdates.append(msgData);
+                        else
+                            log_warn_m << log_format("Groups config not loaded yet"
+                                                     ". Message of chat %? skipped", chatId);
+                    }
+                    else if (fr.failed())
                     {
                         chatInList = false;
                         log_warn_m << log_format("Group chat %? not belong to list chats"
@@ -1533,7 +1613,10 @@ void Application::webhook_readyRead()
         else
             socket->write("HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n");
 
-        socket->flush();
+        if (QAbstractSocket* tcpSocket = qobject_cast<QAbstractSocket*>(socket))
+            tcpSocket->flush();
+        else if (QLocalSocket* localSocket = qobject_cast<QLocalSocket*>(socket))
+            localSocket->flush();
         return;
     }
 
@@ -1575,55 +1658,21 @@ void Application::webhook_sslSocketError(const QList<QSslError>& /*errors*/)
     log_error_m << "Webhook: sslSocketError";
 }
 
-void Application::http_readyRead()
+void Application::webhook_localSocketError(QLocalSocket::LocalSocketError error)
 {
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-
-    quint64 replyId = reinterpret_cast<quint64>(reply);
-    ReplyData& rd = _httpReplyMap[replyId];
-
-    rd.data.append(reply->readAll());
-}
-
-void Application::http_finished()
-{
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-
-    quint64 replyId = reinterpret_cast<quint64>(reply);
-    ReplyData rd = _httpReplyMap[replyId];
-
-    rd.data = unicodeDecode(rd.data);
-
-    auto printToLog = [&rd]()
-    {
-        log_debug_m << log_format("Http answer (reply id: %?) func   : %? (attempt: %?)",
-                                  rd.replyNumber, rd.params->funcName, rd.params->attempt);
-
-        { //Block for alog::Line
-            alog::Line logLine = log_debug_m << log_format(
-                                  "Http answer (reply id: %?) params : ", rd.replyNumber);
-
-            for (auto&& it = rd.params->api.cbegin(); it != rd.params->api.cend(); ++it)
-                logLine << it.key() << ": " << it.value().toString() << "; ";
-        }
-        log_debug_m << log_format("Http answer (reply id: %?) return : %?",
-                                  rd.replyNumber, rd.data);
-    };
+    QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
 
-    if (rd.params->funcName == "getChat"
-        || (rd.params->funcName == "getChatAdministrators"))
+    if (error == QLocalSocket::PeerClosedError)
     {
-        if (_printGetChat
-            && rd.params->funcName == "getChat")
-            printToLog();
-
-        if (_printGetChatAdmins
-            && rd.params->funcName == "getChatAdministrators")
-            printToLog();
+        log_verbose_m << "Webhook remote host closed";
+        return;
     }
-    else
-        printToLog();
+    log_error_m << "Webhook error: " << socket->errorString()
+                << ". Socket descriptor: " << socket->socketDescriptor();
+}
 
+void Application::http_finished(const tbot::HttpReply& rd)
+{
     if (rd.params->isAntiRaid)
     {
         qint64 chatId = rd.params->api["chat_id"].toLongLong();
@@ -1653,7 +1702,8 @@ void Application::http_finished()
                     antiRaid->usersBan.remove(fr.index());
                 }
             }
-            if (rd.params->funcName == "deleteMessage")
+            if (rd.params->funcName == "deleteMessage"
+                || rd.params->funcName == "deleteMessages")
             {
                 if (!rd.success)
                 {
@@ -1664,115 +1714,79 @@ void Application::http_finished()
                         chatId, antiRaid->sleepMsgCount);
                 }
 
-                // Удаляем сообщение из списка, чтобы избежать зацикливания
-                qint32 messageId = rd.params->api["message_id"].toInt();
+                // Удаляем сообщения из списка, чтобы избежать зацикливания
+                QList<qint32> messageIds = tbot::DeleteAggregator::messageIds(*rd.params);
                 log_verbose_m << log_format(
-                    "Chat: %?. Remove from Anti-Raid list message %?",
-                    chatId, messageId);
+                    "Chat: %?. Remove from Anti-Raid list %? message(s)",
+                    chatId, messageIds.count());
 
                 antiRaid->skipMessageIds = false;
-                antiRaid->messageIds.removeAll(messageId);
+                for (qint32 messageId : messageIds)
+                    antiRaid->messageIds.removeAll(messageId);
             }
         }
     }
 
     if (rd.success)
     {
-        QMetaObject::invokeMethod(this, "httpResultHandler", Qt::QueuedConnection,
-                                  Q_ARG(ReplyData, rd));
+        QVector<tbot::TgParams::Ptr> waiters;
+        if (tbot::RequestCoalescer::coalescible(rd.params->funcName))
+            waiters = _requestCoalescer.take(*rd.params);
+
+        httpResultHandler(rd);
+
+        // Результат запроса передается всем присоединенным командам
+        for (const tbot::TgParams::Ptr& params : waiters)
+        {
+            tbot::HttpReply reply = rd;
+            reply.params = params;
+            httpResultHandler(reply);
+        }
     }
     else
     {
-        if (rd.params->funcName == "deleteMessage"
-            || rd.params->funcName == "banChatMember"
-            || rd.params->funcName == "restrictChatMember")
+        // Если пакетное удаление сообщений завершилось постоянной ошибкой,
+        // то сообщения удаляются по одному
+        if (rd.params->funcName == "deleteMessages"
+            && tbot::RetryPolicy::isPermanent(rd.errorCode))
         {
-            tbot::HttpResult httpResult;
-            httpResult.fromJson(rd.data);
+            log_verbose_m << log_format(
+                "Call deleteMessages failed with error %?. Delete messages one by one",
+                rd.errorCode);
 
-            // Ошибка 400: сообщение не найдено или недостаточно прав
-            // для ограничения пользователя
-            if (httpResult.error_code != 400)
-            {
-                auto params = tbot::TgParams::Ptr::create(*rd.params);
-                params->attempt += 1;
+            const qint64 now = steadyTime();
+            for (const tbot::TgParams::Ptr& params : tbot::DeleteAggregator::split(*rd.params))
+                _outboundScheduler.enqueue(params, now);
 
-                if (rd.params->attempt == 1)
-                {
-                    params->delay = 30*1000 /*30 сек*/;
-                    sendTgCommand(params);
-                }
-                if (rd.params->attempt == 2)
-                {
-                    params->delay = 60*1000 /*60 сек*/;
-                    sendTgCommand(params);
-                }
-            }
+            outboundDispatch();
         }
 
-        if (rd.params->funcName == "getChat"
-            || rd.params->funcName == "getChatAdministrators")
+        tbot::RetryPolicy::Decision decision =
+            _retryPolicy.decide(rd.params->funcName, rd.params->attempt,
+                                rd.errorCode, rd.retryAfter);
+
+        // Во время ожидания, назначенного Телеграм, не отправляем команды
+        // того же класса, чтобы не продлевать ограничение
+        if (decision.floodWait > 0)
+            _outboundScheduler.hold(tbot::OutboundScheduler::priority(rd.params->funcName),
+                                    steadyTime() + decision.floodWait);
+
+        if (decision.retry)
         {
             auto params = tbot::TgParams::Ptr::create(*rd.params);
             params->attempt += 1;
-
-            if (rd.params->attempt == 1)
-            {
-                params->delay = 20*1000 /*20 сек*/;
-                sendTgCommand(params);
-            }
-            if (rd.params->attempt == 2)
-            {
-                params->delay = 30*1000 /*30 сек*/;
-                sendTgCommand(params);
-            }
-            if (rd.params->attempt == 3)
-            {
-                params->delay = 60*1000 /*60 сек*/;
-                sendTgCommand(params);
-            }
-            if (rd.params->attempt == 4)
-            {
-                params->delay = 2*60*1000 /*2 мин*/;
-                sendTgCommand(params);
-            }
-            if (rd.params->attempt == 5)
-            {
-                params->delay = 2*60*1000 /*2 мин*/;
-                sendTgCommand(params);
-            }
-            if (rd.params->attempt == 6)
-            {
-                params->delay = 3*60*1000 /*3 мин*/;
-                sendTgCommand(params);
-            }
+            params->delay = int(decision.delay);
+            sendTgCommand(params);
+        }
+        else if (tbot::RequestCoalescer::coalescible(rd.params->funcName))
+        {
+            QVector<tbot::TgParams::Ptr> waiters = _requestCoalescer.take(*rd.params);
+            if (!waiters.isEmpty())
+                log_verbose_m << log_format(
+                    "Call %? failed. Dropped attached calls: %?",
+                    rd.params->funcName, waiters.count());
         }
     }
-
-    _httpReplyMap.remove(replyId);
-    reply->deleteLater();
-}
-
-void Application::http_error(QNetworkReply::NetworkError /*error*/)
-{
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-
-    quint64 replyId = reinterpret_cast<quint64>(reply);
-    ReplyData& rd = _httpReplyMap[replyId];
-
-    rd.success = false;
-    log_error_m << log_format("Http error (reply id: %?). %?",
-                              rd.replyNumber, reply->errorString());
-}
-
-void Application::http_encrypted()
-{
-    log_debug2_m << "http_encrypted()";
-}
-
-void Application::http_sslErrors(const QList<QSslError>&)
-{
-    log_error_m << "http_sslErrors()";
 }
 
 void Application::reloadConfig()
@@ -1814,12 +1828,39 @@ void Application::reloadConfig()
     _printGetChatAdmins = true;
     config::base().getValue("print_log.get_chat_administrators", _printGetChatAdmins);
 
+    for (tbot::HttpClient* client : _httpClients)
+        client->setPrintLog(_printGetChat, _printGetChatAdmins);
+
     _spamIsActive = false;
     config::base().getValue("bot.spam_message.active", _spamIsActive);
 
     _spamMessage.clear();
     config::base().getValue("bot.spam_message.text", _spamMessage);
 
+    tbot::CampaignDetector::Params campaignParams;
+    config::base().getValue("campaign.active",           campaignParams.active);
+    config::base().getValue("campaign.window",           campaignParams.window);
+    config::base().getValue("campaign.chats",            campaignParams.chats);
+    config::base().getValue("campaign.new_users",        campaignParams.newUsers);
+    config::base().getValue("campaign.domain_new_users", campaignParams.domainNewUsers);
+    tbot::campaignDetector().setParams(campaignParams);
+
+    tbot::BioCache::Params bioCacheParams;
+    config::base().getValue("bio_cache.ttl",       bioCacheParams.ttl);
+    config::base().getValue("bio_cache.max_users", bioCacheParams.maxUsers);
+    tbot::bioCache().setParams(bioCacheParams);
+
+    tbot::OutboundScheduler::Limits outboundLimits;
+    config::base().getValue("outbound.global",     outboundLimits.global);
+    config::base().getValue("outbound.chat",       outboundLimits.chat);
+    config::base().getValue("outbound.chat_burst", outboundLimits.chatBurst);
+    config::base().getValue("outbound.get_chat",   outboundLimits.getChat);
+    _outboundScheduler.setLimits(outboundLimits);
+
+    int deleteWindow = _deleteAggregator.window();
+    config::base().getValue("outbound.delete_window", deleteWindow);
+    _deleteAggregator.setWindow(deleteWindow);
+
     reloadBotMode();
     reloadGroups(configFile);
 }
@@ -1929,50 +1970,49 @@ void Application::reloadGroups(const QString& configFile)
     if (configInfo.fileName() != "telebot.groups")
         return;
 
-    YamlConfig config;
-    if (!config.readFile(configFile.toStdString(), true))
+    // Первая конфигурация загружается синхронно: пока группы не опубликова-
+    // ны, webhook-сообщения отбрасываются как не принадлежащие ни одной группе
+    if (tbot::groupChats().empty())
+    {
+        tbot::GroupsLoader::Result::Ptr result =
+            tbot::GroupsLoader::loadGroups(configFile, _printTriggers, _printGroupChats);
+        if (!result.empty())
+            groupsLoaded(result);
         return;
+    }
 
-    tbot::globalConfigParceErrors = 0;
-
-    { //Block for tbot::Trigger::List
-        tbot::Trigger::List triggers;
-        tbot::loadTriggers(triggers, config);
-
-        if (_printTriggers)
-            tbot::printTriggers(triggers);
+    // Разбор конфигурации выполняется в отдельном потоке, результат будет
+    // опубликован в функции groupsLoaded()
+    _groupsLoader.load(configFile, _printTriggers, _printGroupChats);
+}
 
-        if (triggers.empty())
-        {
-            log_error_m << "---";
-            log_error_m << "Triggers list is empty";
-            log_error_m << "---";
-            return;
-        }
-        tbot::triggers(&triggers);
+void Application::groupsLoaded(const tbot::GroupsLoader::Result::Ptr& result)
+{
+    if (result->triggers.empty())
+    {
+        log_error_m << "---";
+        log_error_m << "Triggers list is empty";
+        log_error_m << "---";
+        return;
+    }
+    if (result->chats.empty())
+    {
+        log_error_m << "---";
+        log_error_m << "Chats list is empty";
+        log_error_m << "---";
+        return;
     }
 
-    tbot::GroupChat::List oldChats;
-
-    { //Block for tbot::Trigger::List
-        tbot::GroupChat::List chats;
-        tbot::loadGroupChats(chats, config);
+    tbot::triggers(&result->triggers);
 
-        if (_printGroupChats)
-            tbot::printGroupChats(chats);
+    tbot::GroupChat::List oldChats;
+    tbot::groupChats(&result->chats);
+    oldChats.swap(result->chats);
 
-        if (chats.empty())
-        {
-            log_error_m << "---";
-            log_error_m << "Chats list is empty";
-            log_error_m << "---";
-            return;
-        }
-        tbot::groupChats(&chats);
-        oldChats.swap(chats);
-    }
+    // Вердикты BIO вынесены прежними триггерами
+    tbot::bioCache().clearVerdicts();
 
-    if (tbot::globalConfigParceErrors == 0)
+    if (result->errors == 0)
     {
         log_info_m << "---";
         log_info_m << "Success parse groups from config-file";
@@ -1982,30 +2022,49 @@ void Application::reloadGroups(const QString& configFile)
     {
         log_error_m << "---";
         log_error_m << "Failed parse groups from config-file"
-                    << ". Error count: " << int(tbot::globalConfigParceErrors);
+                    << ". Error count: " << result->errors;
         log_error_m << "---";
     }
 
+    log_info_m << log_format(
+        "Groups config loaded in %? ms. Triggers reused/rebuilt: %?/%?"
+        ". Chats reused/rebuilt: %?/%?",
+        result->elapsed,
+        result->triggersStat.reused, result->triggersStat.rebuilt,
+        result->chatsStat.reused, result->chatsStat.rebuilt);
+
+    timelimitSchedule();
+
     tbot::GroupChat::List newChats = tbot::groupChats();
 
+    // Обработка webhook-сообщений, полученных до публикации конфигурации
+    QList<tbot::MessageData::Ptr> pendingUpdates;
+    pendingUpdates.swap(_pendingUpdates);
+    for (const tbot::MessageData::Ptr& msgData : pendingUpdates)
+    {
+        tbot::Message::Ptr message = (msgData->update.message)
+                                     ? msgData->update.message
+                                     : msgData->update.edited_message;
+        if (newChats.findRef(message->chat->id).failed())
+            continue;
+
+        if (!botCommand(msgData))
+            sendToProcessing(msgData);
+    }
+
     // Получение/обновление информации о группах и их администраторах
     if (newChats.count() > oldChats.count())
     {
-        int index = 0;
         for (tbot::GroupChat* newChat : newChats)
         {
             if (oldChats.findRef(newChat->id))
                 continue;
 
+            // Интервал между командами getChat определяет планировщик исходящих
+            // команд, команды имеют низкий приоритет и не задерживают удаление
+            // сообщений
             auto params = tbot::tgfunction("getChat");
             params->api["chat_id"] = newChat->id;
-
-            // Команды getChat отправляются с интервалом 100 миллисекунд, чтобы
-            // уложиться в ограничение Телеграм на 30 запросов в секунду от бота.
-            // Интервал 100 миллисекунд обеспечивает существенный временной запас,
-            // это обусловлено тем, что после вызова getChat идет вызов команды
-            // getChatAdministrators
-            params->delay = 100 * index++;
             sendTgCommand(params);
         }
     }
@@ -2015,7 +2074,7 @@ void Application::reloadGroups(const QString& configFile)
         {
             QDateTime currentTime = QDateTime::currentDateTimeUtc();
             if (antiRaid->deactiveTime > currentTime)
-                chat->antiRaidTurnOn = true;
+                chat->setAntiRaidTurnOn(true);
         }
 
     if (_masterMode)
@@ -2044,257 +2103,401 @@ void Application::startRequest()
     sendTgCommand(params);
 }
 
-void Application::timelimitCheck()
+void Application::timelimitSchedule()
 {
     using namespace tbot;
 
-    for (int i = 0; i < _timelimitBegins.count(); ++i)
-        if (_timelimitBegins[i].timer.elapsed() > 3*60*1000 /*3 мин*/)
-            _timelimitBegins.remove(i--);
+    _timelimitEvents.clear();
 
-    for (int i = 0; i < _timelimitEnds.count(); ++i)
-        if (_timelimitEnds[i].timer.elapsed() > 3*60*1000 /*3 мин*/)
-            _timelimitEnds.remove(i--);
+    qint64 curTime = std::time(nullptr);
+    QSet<qint64> inactiveChats = timelimitInactiveChats();
 
     GroupChat::List chats = tbot::groupChats();
     for (GroupChat* chat : chats)
     {
-        if (timelimitInactiveChats().contains(chat->id))
+        if (inactiveChats.contains(chat->id))
             continue;
 
         for (Trigger* trigger : chat->triggers)
             if (TriggerTimeLimit* trg = dynamic_cast<TriggerTimeLimit*>(trigger))
             {
-                QDateTime dtime = QDateTime::currentDateTimeUtc();
-                dtime = dtime.addSecs(trg->utc * 60*60); // Учитываем сдвиг UTC
-                int dayOfWeek = dtime.date().dayOfWeek();
-                QTime curTime = dtime.time();
-
-                TriggerTimeLimit::Times times;
-                trg->timesRangeOfDay(dayOfWeek, times);
-                for (const TriggerTimeLimit::TimeRange& time : times)
-                {
-                    if (!time.begin.isNull()
-                        && !_timelimitBegins.findRef(qMakePair(chat->id, trg->name)))
-                    {
-                        QTime timeBeginL = time.begin.addSecs(+1  /*+1 сек*/);
-                        QTime timeBeginR = time.begin.addSecs(+45 /*+45 сек*/);
-                        if (timeInRange(timeBeginL, curTime, timeBeginR))
-                        {
-                            TimeLimit* tl = _timelimitBegins.add();
-                            tl->chatId = chat->id;
-                            tl->triggerName = trg->name;
+                qint64 time = trg->nextTransition(curTime);
+                if (time > 0)
+                    _timelimitEvents.insert(time, {chat->id, trg->name});
+            }
+    }
+    timelimitTimerStart();
+}
 
-                            _timelimitBegins.sort();
+void Application::timelimitTimerStart()
+{
+    KILL_TIMER(_timelimitTimerId)
 
-                            if (trg->active)
-                            {
-                                log_verbose_m << log_format(
-                                    "Trigger timelimit '%?' started. Chat: %?",
-                                    trg->name, chat->name());
-
-                                if (!trg->messageBegin.isEmpty())
-                                {
-                                    QTime timeBegin = !time.begin.isNull() ? time.begin : time.hint;
-                                    QTime timeEnd   = !time.end.isNull()   ? time.end   : time.hint;
-
-                                    QString message = trg->messageBegin;
-                                    message.replace("{begin}", timeBegin.toString("HH:mm"))
-                                           .replace("{end}",   timeEnd.toString("HH:mm"));
-
-                                    auto params = tbot::tgfunction("sendMessage");
-                                    params->api["chat_id"] = chat->id;
-                                    params->api["text"] = message;
-                                    params->api["parse_mode"] = "HTML";
-                                    //params->messageDel = trg->hideMessageBegin ? 0 : 6*60*60 /*6 часов*/;
-                                    params->messageDel = 0;
-                                    if (!trg->hideMessageBegin)
-                                    {
-                                        random_device rd;
-                                        mt19937 generator {rd()};
-                                        uniform_int_distribution<> distribution {5*60*60 /*5 часов*/,
-                                                                                 6*60*60 /*6 часов*/};
-
-                                        // Псевдослучайное время удаления сообщения (в секундах)
-                                        params->messageDel = distribution(generator);
-                                    }
-                                    sendTgCommand(params);
-                                }
-                            }
-                            else
-                            {
-                                log_verbose_m << log_format(
-                                    "Trigger timelimit '%?'  skipped, it not active. Chat: %?",
-                                    trg->name, chat->name());
-                            }
-                        }
-                    }
+    if (_timelimitEvents.isEmpty() || _stop)
+        return;
 
-                    if (!time.end.isNull()
-                        && !_timelimitEnds.findRef(qMakePair(chat->id, trg->name)))
-                    {
-                        QTime timeEndL = time.end.addSecs(+1  /*+1 сек*/);
-                        QTime timeEndR = time.end.addSecs(+45 /*+45 сек*/);
-                        if (timeInRange(timeEndL, curTime, timeEndR))
-                        {
-                            TimeLimit* tl = _timelimitEnds.add();
-                            tl->chatId = chat->id;
-                            tl->triggerName = trg->name;
+    qint64 interval = _timelimitEvents.firstKey() * 1000
+                      - QDateTime::currentMSecsSinceEpoch();
 
-                            _timelimitEnds.sort();
+    // Ограничение интервала защищает от накопления погрешности таймера
+    // при длительном ожидании и при переводе системных часов
+    interval = qBound(qint64(0), interval, qint64(10*60*1000 /*10 мин*/));
+    _timelimitTimerId = startTimer(int(interval), Qt::PreciseTimer);
+}
 
-                            if (trg->active)
-                            {
-                                log_verbose_m << log_format(
-                                    "Trigger timelimit '%?' stopped. Chat: %?",
-                                    trg->name, chat->name());
-
-                                if (!trg->messageEnd.isEmpty())
-                                {
-                                    QTime timeBegin = !time.begin.isNull() ? time.begin : time.hint;
-                                    QTime timeEnd   = !time.end.isNull()   ? time.end   : time.hint;
-
-                                    QString message = trg->messageEnd;
-                                    message.replace("{begin}", timeBegin.toString("HH:mm"))
-                                           .replace("{end}",   timeEnd.toString("HH:mm"));
-
-                                    auto params = tbot::tgfunction("sendMessage");
-                                    params->api["chat_id"] = chat->id;
-                                    params->api["text"] = message;
-                                    params->api["parse_mode"] = "HTML";
-                                    //params->messageDel = trg->hideMessageEnd ? 0 : 1*60*60 /*1 час*/;
-                                    params->messageDel = 0;
-                                    if (!trg->hideMessageEnd)
-                                    {
-                                        random_device rd;
-                                        mt19937 generator {rd()};
-                                        uniform_int_distribution<> distribution (1.0*60*60 /*1 час*/,
-                                                                                 1.5*60*60 /*1.5 часа*/);
-
-                                        // Псевдослучайное время удаления сообщения (в секундах)
-                                        params->messageDel = distribution(generator);
-                                    }
-                                    sendTgCommand(params);
-                                }
-                            }
-                            else
-                            {
-                                log_verbose_m << log_format(
-                                    "Trigger timelimit '%?'  skipped, it not active. Chat: %?",
-                                    trg->name, chat->name());
-                            }
-                        }
-                    }
-                }
+void Application::timelimitCheck()
+{
+    using namespace tbot;
+
+    // Сообщения публикуются master-ботом, или slave-ботом при потере связи
+    // с master-ботом
+    bool sendMessages = _masterMode || (_slaveSocket && !_slaveSocket->isConnected());
+
+    qint64 curTimeMs = QDateTime::currentMSecsSinceEpoch();
+    GroupChat::List chats = tbot::groupChats();
+
+    while (!_timelimitEvents.isEmpty()
+           && (_timelimitEvents.firstKey() * 1000 <= curTimeMs))
+    {
+        qint64 time = _timelimitEvents.firstKey();
+        TimelimitEvent event = _timelimitEvents.take(time);
+
+        GroupChat* chat = chats.findItem(&event.chatId);
+        if (chat == nullptr)
+            continue;
+
+        TriggerTimeLimit* trg = nullptr;
+        for (Trigger* trigger : chat->triggers)
+            if (trigger->name == event.triggerName)
+            {
+                trg = dynamic_cast<TriggerTimeLimit*>(trigger);
+                break;
             }
+
+        if (trg == nullptr)
+            continue;
+
+        if (sendMessages)
+            for (const TriggerTimeLimit::Transition& transition : trg->transitions(time))
+                timelimitMessage(chat, trg, transition);
+
+        qint64 nextTime = trg->nextTransition(time);
+        if (nextTime > 0)
+            _timelimitEvents.insert(nextTime, event);
+    }
+    timelimitTimerStart();
+}
+
+void Application::timelimitMessage(tbot::GroupChat* chat, tbot::TriggerTimeLimit* trg,
+                                   const tbot::TriggerTimeLimit::Transition& transition)
+{
+    if (!trg->active)
+    {
+        log_verbose_m << log_format(
+            "Trigger timelimit '%?'  skipped, it not active. Chat: %?",
+            trg->name, chat->name());
+        return;
+    }
+
+    log_verbose_m << log_format(
+        "Trigger timelimit '%?' %?. Chat: %?",
+        trg->name, (transition.begin ? "started" : "stopped"), chat->name());
+
+    QString message = transition.begin ? trg->messageBegin : trg->messageEnd;
+    if (message.isEmpty())
+        return;
+
+    const tbot::TriggerTimeLimit::TimeRange& time = transition.range;
+    QTime timeBegin = !time.begin.isNull() ? time.begin : time.hint;
+    QTime timeEnd   = !time.end.isNull()   ? time.end   : time.hint;
+
+    message.replace("{begin}", timeBegin.toString("HH:mm"))
+           .replace("{end}",   timeEnd.toString("HH:mm"));
+
+    auto params = tbot::tgfunction("sendMessage");
+    params->api["chat_id"] = chat->id;
+    params->api["text"] = message;
+    params->api["parse_mode"] = "HTML";
+    params->messageDel = 0;
+
+    if (transition.begin && !trg->hideMessageBegin)
+    {
+        random_device rd;
+        mt19937 generator {rd()};
+        uniform_int_distribution<> distribution {5*60*60 /*5 часов*/,
+                                                 6*60*60 /*6 часов*/};
+
+        // Псевдослучайное время удаления сообщения (в секундах)
+        params->messageDel = distribution(generator);
+    }
+    if (!transition.begin && !trg->hideMessageEnd)
+    {
+        random_device rd;
+        mt19937 generator {rd()};
+        uniform_int_distribution<> distribution (1.0*60*60 /*1 час*/,
+                                                 1.5*60*60 /*1.5 часа*/);
+
+        // Псевдослучайное время удаления сообщения (в секундах)
+        params->messageDel = distribution(generator);
     }
+    sendTgCommand(params);
 }
 
 void Application::sendTgCommand(const tbot::TgParams::Ptr& params)
 {
-    QTimer::singleShot(params->delay, [=]()
+    // Не обрабатываем команды если приложение получило команду на остановку
+    if (_stop)
+        return;
+
+    // BIO пользователя, полученное недавно, берется из кеша без обращения
+    // к Телеграм
+    if (params->bio.userId > 0)
     {
-        // Не обрабатываем команды если приложение получило команду на остановку
-        if (_stop)
+        QByteArray bioData;
+        tbot::UserBio userBio;
+        if (tbot::bioCache().data(params->bio.userId, bioData)
+            && userBio.fromJson(bioData))
+        {
+            sendBioToProcessing(params, userBio);
             return;
+        }
+    }
 
-        if (params->funcName == "banChatMember"
-            && params->funcName == "restrictChatMember")
-        {
-            qint64 chatId = params->api["chat_id"].toLongLong();
-            qint64 userId = params->api["user_id"].toLongLong();
+    const qint64 now = steadyTime();
 
-            tbot::GroupChat::List chats = tbot::groupChats();
-            if (tbot::GroupChat* chat = chats.findItem(&chatId))
-            {
-                QSet<qint64> ownerIds = chat->ownerIds();
-                if (ownerIds.contains(userId))
-                {
-                    log_error_m << log_format(
-                        "Prohibited call the function %? for owner of chat %?/%?",
-                        params->funcName, userId, chatId);
-                    return;
-                }
+    // Отложенные команды ожидают времени отправки в колесе таймеров
+    if (params->delay > 0)
+        delayedCommand(params, now + params->delay, false);
+    else
+        outboundEnqueue(params, now);
 
-                QSet<qint64> adminIds = chat->adminIds();
-                if (adminIds.contains(userId))
-                {
-                    log_error_m << log_format(
-                        "Prohibited call the function %? for admin of chat %?/%?",
-                        params->funcName, userId, chatId);
-                    return;
-                }
-            }
-            if (userId  == GROUP_ANONYMOUS_BOT_ID)
-            {
-                log_error_m << log_format(
-                    "Prohibited call the function %? for GroupAnonymousBot",
-                    params->funcName);
-                return;
-            }
+    outboundDispatch();
+}
+
+void Application::outboundEnqueue(const tbot::TgParams::Ptr& params, qint64 now)
+{
+    // Команда присоединяется к аналогичному запросу, который ожидает от-
+    // правки или выполняется, и получит результат этого запроса
+    if (params->attempt == 1
+        && tbot::RequestCoalescer::coalescible(params->funcName)
+        && _requestCoalescer.attach(params, now))
+    {
+        return;
+    }
+
+    if (params->funcName == "deleteMessage")
+    {
+        qint64 chatId = params->api["chat_id"].toLongLong();
+        qint32 messageId = params->api["message_id"].toInt();
+
+        // Немедленное удаление сообщения отменяет его отложенное удаление
+        auto it = _delayedDeletes.find(DeleteKey {chatId, messageId});
+        if (it != _delayedDeletes.end())
+        {
+            _timingWheel.cancel(it.value());
+            _delayedDeletes.erase(it);
         }
 
-        QString urlStr = "https://api.telegram.org";
-        if (_localServer)
+        // Команды удаления сообщений объединяются в пакеты deleteMessages.
+        // Повторные попытки и команды Anti-Raid режима отправляются без
+        // объединения, так как Anti-Raid ожидает подтверждения удаления
+        // сообщения
+        if (params->attempt == 1 && !params->isAntiRaid)
         {
-            urlStr = "http://%1:%2";
-            urlStr = urlStr.arg(_localServerAddr).arg(_localServerPort);
+            if (!_deleteAggregator.add(chatId, messageId, now))
+                log_debug2_m << log_format(
+                    "Message %?/%? already queued for deletion", chatId, messageId);
+            return;
         }
-        urlStr += "/bot%1/%2";
-        urlStr = urlStr.arg(_botId).arg(params->funcName);
+    }
+    _outboundScheduler.enqueue(params, now);
+}
 
-        QUrlQuery query;
-        for (auto&& it = params->api.cbegin(); it != params->api.cend(); ++it)
-            query.addQueryItem(it.key(), it.value().toString());
+void Application::delayedCommand(const tbot::TgParams::Ptr& params,
+                                 qint64 time, bool persistent)
+{
+    if (params->funcName != "deleteMessage")
+    {
+        _timingWheel.add(time, params, persistent);
+        return;
+    }
 
-        QUrl url {urlStr};
-        url.setQuery(query);
+    DeleteKey key {params->api["chat_id"].toLongLong(),
+                   params->api["message_id"].toInt()};
 
-        QNetworkRequest request {url};
-        QNetworkReply* reply = _networkAccManager->get(request);
+    auto it = _delayedDeletes.find(key);
+    if (it != _delayedDeletes.end())
+    {
+        const tbot::TimingWheel::Item* item = _timingWheel.find(it.value());
+        if (item && (item->time <= time))
+            return;
 
-        chk_connect_a(reply, &QIODevice::readyRead,    this, &Application::http_readyRead);
-        chk_connect_a(reply, &QNetworkReply::finished, this, &Application::http_finished);
+        _timingWheel.cancel(it.value());
+    }
+    _delayedDeletes[key] = _timingWheel.add(time, params, persistent);
+}
 
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
-        chk_connect_a(reply, &QNetworkReply::errorOccurred, this, &Application::http_error);
-#else
-        chk_connect_a(reply, qOverload<QNetworkReply::NetworkError>(&QNetworkReply::error),
-                      this,  &Application::http_error);
-#endif
-        chk_connect_a(reply, &QNetworkReply::sslErrors, this, &Application::http_sslErrors);
-        chk_connect_a(reply, &QNetworkReply::encrypted, this, &Application::http_encrypted);
+void Application::delayedDelete(qint64 chatId, qint32 messageId, qint64 deleteTime)
+{
+    auto params = tbot::tgfunction("deleteMessage");
+    params->api["chat_id"] = chatId;
+    params->api["message_id"] = messageId;
 
-        quint64 replyId = reinterpret_cast<quint64>(reply);
-        ReplyData& rd = _httpReplyMap[replyId];
+    qint64 delay = deleteTime - QDateTime::currentMSecsSinceEpoch();
+    delayedCommand(params, steadyTime() + qMax(delay, qint64(0)), true);
+}
+
+QList<data::DeleteDelay> Application::deleteDelays() const
+{
+    const qint64 now = steadyTime();
+    const qint64 utcNow = QDateTime::currentMSecsSinceEpoch();
+
+    QList<data::DeleteDelay> deleteDelays;
+    for (const tbot::TimingWheel::Item& item : _timingWheel.items(true))
+    {
+        if (item.params->funcName != "deleteMessage")
+            continue;
+
+        data::DeleteDelay dd;
+        dd.chatId = item.params->api["chat_id"].toLongLong();
+        dd.messageId = item.params->api["message_id"].toInt();
+        dd.deleteTime = utcNow + (item.time - now);
+        deleteDelays.append(dd);
+    }
+    return deleteDelays;
+}
+
+void Application::setDeleteDelays(const QList<data::DeleteDelay>& deleteDelays)
+{
+    for (const tbot::TimingWheel::Item& item : _timingWheel.items(true))
+    {
+        if (item.params->funcName != "deleteMessage")
+            continue;
+
+        _timingWheel.cancel(item.id);
+        _delayedDeletes.remove(DeleteKey {item.params->api["chat_id"].toLongLong(),
+                                          item.params->api["message_id"].toInt()});
+    }
+
+    for (const data::DeleteDelay& dd : deleteDelays)
+        delayedDelete(dd.chatId, dd.messageId, dd.deleteTime);
+
+    outboundDispatch();
+}
+
+void Application::saveDelayedCommands()
+{
+    QString stateFile;
+    config::base().getValue("delete_delay.file", stateFile);
+    _timingWheel.save(stateFile, steadyTime());
+}
+
+void Application::outboundDispatch()
+{
+    KILL_TIMER(_outboundTimerId)
+
+    if (_stop)
+    {
+        _outboundScheduler.clear();
+        _deleteAggregator.clear();
+        _requestCoalescer.clear();
+        return;
+    }
 
-        rd.reply = reply;
-        rd.replyNumber = ++httpReplyNumber;
-        rd.params = params;
+    const qint64 now = steadyTime();
 
-        auto printToLog = [&rd, &url]()
+    bool deleteDelayActive = false;
+    for (const tbot::TimingWheel::Item& item : _timingWheel.advance(now))
+    {
+        const tbot::TgParams::Ptr& params = item.params;
+        if (params->funcName == "deleteMessage")
         {
-            log_debug_m << log_format("Http call %? (reply id: %?). Send command: %?",
-                                      rd.params->funcName, rd.replyNumber, url.toString());
-        };
+            DeleteKey key {params->api["chat_id"].toLongLong(),
+                           params->api["message_id"].toInt()};
+
+            auto it = _delayedDeletes.find(key);
+            if ((it != _delayedDeletes.end()) && (it.value() == item.id))
+                _delayedDeletes.erase(it);
+        }
+        if (item.persistent)
+            deleteDelayActive = true;
 
-        if (rd.params->funcName == "getChat"
-            || (rd.params->funcName == "getChatAdministrators"))
+        params->delay = 0;
+        outboundEnqueue(params, now);
+    }
+    if (deleteDelayActive)
+        updateBotCommands(delete_delay);
+
+    for (const tbot::TgParams::Ptr& params : _deleteAggregator.take(now))
+        _outboundScheduler.enqueue(params, now);
+
+    while (true)
+    {
+        tbot::TgParams::Ptr params = _outboundScheduler.next(now);
+        if (params.empty())
+            break;
+
+        httpSendCommand(params);
+    }
+
+    qint64 wait = _outboundScheduler.wait(now);
+    for (qint64 w : {_deleteAggregator.wait(now), _timingWheel.wait(now)})
+        if ((w >= 0) && ((wait < 0) || (w < wait)))
+            wait = w;
+
+    if (wait >= 0)
+    {
+        wait = qBound(qint64(1), wait, qint64(60*60*1000 /*1 час*/));
+        _outboundTimerId = startTimer(int(wait), Qt::PreciseTimer);
+    }
+}
+
+void Application::httpSendCommand(const tbot::TgParams::Ptr& params)
+{
+    if (params->funcName == "banChatMember"
+        || params->funcName == "restrictChatMember")
+    {
+        qint64 chatId = params->api["chat_id"].toLongLong();
+        qint64 userId = params->api["user_id"].toLongLong();
+
+        tbot::GroupChat::List chats = tbot::groupChats();
+        if (tbot::GroupChat* chat = chats.findItem(&chatId))
         {
-            if (_printGetChat
-                && rd.params->funcName == "getChat")
-                printToLog();
+            tbot::GroupChat::Runtime::Ptr runtime = chat->runtime();
+            if (runtime->ownerIds.contains(userId))
+            {
+                log_error_m << log_format(
+                    "Prohibited call the function %? for owner of chat %?/%?",
+                    params->funcName, userId, chatId);
+                return;
+            }
 
-            if (_printGetChatAdmins
-                && rd.params->funcName == "getChatAdministrators")
-                printToLog();
+            if (runtime->adminIds.contains(userId))
+            {
+                log_error_m << log_format(
+                    "Prohibited call the function %? for admin of chat %?/%?",
+                    params->funcName, userId, chatId);
+                return;
+            }
         }
-        else
-            printToLog();
-    });
+        if (userId  == GROUP_ANONYMOUS_BOT_ID)
+        {
+            log_error_m << log_format(
+                "Prohibited call the function %? for GroupAnonymousBot",
+                params->funcName);
+            return;
+        }
+    }
+
+    if (_httpClients.count() == 0)
+        return;
+
+    // Команды распределяются по потокам http-клиентов поочередно
+    _httpClientIndex = (_httpClientIndex + 1) % _httpClients.count();
+    _httpClients.item(_httpClientIndex)->send(params);
 }
 
-void Application::httpResultHandler(const ReplyData& rd)
+void Application::httpResultHandler(const tbot::HttpReply& rd)
 {
     if (rd.params->funcName == "getMe")
     {
@@ -2377,10 +2580,13 @@ void Application::httpResultHandler(const ReplyData& rd)
 
             _procList.add(p);
         }
-        for (tbot::Processing* p : _procList)
-            p->start();
 
+        // Конфигурация групп загружается до запуска потоков обработки,
+        // чтобы сообщения, накопленные в очереди, не были отброшены
         reloadConfig();
+
+        for (tbot::Processing* p : _procList)
+            p->start();
     }
     else if (rd.params->funcName == "getChat")
     {
@@ -2451,45 +2657,14 @@ void Application::httpResultHandler(const ReplyData& rd)
         // Обработка сообщения с BIO
         else if (rd.params->bio.userId > 0)
         {
-            if (httpResult.ok && !httpResult.result.isEmpty())
+            tbot::UserBio userBio;
+            if (httpResult.ok && !httpResult.result.isEmpty()
+                && userBio.fromJson(httpResult.result))
             {
-                tbot::MessageData::Ptr msgData {tbot::MessageData::Ptr::create()};
-                msgData->bio = rd.params->bio;
-                msgData->isNewUser = rd.params->isNewUser;
-                msgData->update.update_id = rd.params->bio.updateId;
-
-                // Конструирование BIO сообщения
-                tbot::UserBio userBio;
-                if (userBio.fromJson(httpResult.result))
-                {
-                    tbot::User::Ptr user {new tbot::User};
-                    user->id = rd.params->bio.userId;
-                    user->first_name = userBio.first_name;
-                    user->last_name  = userBio.last_name;
-                    user->username   = userBio.username;
-
-                    tbot::Chat::Ptr chat {new tbot::Chat};
-                    chat->id = rd.params->bio.chatId;
-
-                    tbot::Message::Ptr message {new tbot::Message};
-
-                    message->message_id = rd.params->bio.messageId;
-                    message->media_group_id = rd.params->bio.mediaGroupId;
-                    message->text = userBio.bio;
-                    message->from = user;
-                    message->chat = chat;
-
-                    message->personal_chat = userBio.personal_chat;
-
-                    if (userBio.business_location)
-                        message->text += " " + userBio.business_location->address;
-
-                    msgData->update.message = message;
-
-                    //log_verbose_m << "Emulation BIO message: " << msgData->update.toJson();
-
-                    sendToProcessing(msgData);
-                }
+                // Запись кеша создается до передачи сообщения на обработку:
+                // вердикт проверки BIO сохраняется в существующую запись
+                tbot::bioCache().update(rd.params->bio.userId, httpResult.result);
+                sendBioToProcessing(rd.params, userBio);
             }
             else
                 log_error_m << "Failed call function 'getChat' to get user BIO";
@@ -2527,16 +2702,12 @@ void Application::httpResultHandler(const ReplyData& rd)
                 }
                 else
                 {
-                    data::DeleteDelay dd;
-                    dd.chatId = chatId;
-                    dd.messageId = messageId;
-
                     QDateTime deleteTime = QDateTime::currentDateTimeUtc();
                     deleteTime = deleteTime.addSecs(rd.params->messageDel);
-                    dd.deleteTime = deleteTime.toMSecsSinceEpoch();
 
-                    _deleteDelays.append(dd);
+                    delayedDelete(chatId, messageId, deleteTime.toMSecsSinceEpoch());
                     updateBotCommands(delete_delay);
+                    outboundDispatch();
                 }
             }
         }
@@ -2593,10 +2764,7 @@ void Application::httpResultHandler(const ReplyData& rd)
                 if (chat->anonymousAsAdmin)
                     adminIds.insert(GROUP_ANONYMOUS_BOT_ID);
 
-                chat->setAdminIds(adminIds);
-                chat->setOwnerIds(ownerIds);
-                chat->setAdminNames(adminNames);
-                chat->setBotInfo(botInfo);
+                chat->setAdmins(adminIds, ownerIds, adminNames, botInfo);
 
                 log_info_m << log_format("Group chat info updated: %?/%?",
                                          chat->name(), chatId);
@@ -2785,8 +2953,8 @@ void Application::reportSpam(qint64 chatId, const tbot::User::Ptr& user)
 
     if (tbot::GroupChat* chat = chats.findItem(&chatId))
     {
-        QSet<qint64> ownerIds = chat->ownerIds();
-        if (ownerIds.contains(user->id))
+        tbot::GroupChat::Runtime::Ptr runtime = chat->runtime();
+        if (runtime->ownerIds.contains(user->id))
         {
             alog::Line logLine =
                 log_verbose_m << "Owner of chat cannot receive penalty";
@@ -2794,8 +2962,7 @@ void Application::reportSpam(qint64 chatId, const tbot::User::Ptr& user)
             return;
         }
 
-        QSet<qint64> adminIds = chat->adminIds();
-        if (adminIds.contains(user->id))
+        if (runtime->adminIds.contains(user->id))
         {
             alog::Line logLine =
                 log_verbose_m << "Admin of chat cannot receive penalty";
@@ -2899,8 +3066,8 @@ void Application::reportSpam(qint64 chatId, const tbot::User::Ptr& user)
                 continue;
             }
 
-            QSet<qint64> adminIds = chat->adminIds();
-            if (adminIds.contains(spammer->user->id))
+            tbot::GroupChat::Runtime::Ptr runtime = chat->runtime();
+            if (runtime->adminIds.contains(spammer->user->id))
             {
                 // Случай, когда "спамер" стал админом
                 continue;
@@ -2917,7 +3084,7 @@ void Application::reportSpam(qint64 chatId, const tbot::User::Ptr& user)
                     "User ban. Id chat/spammer: %?/%?. Times: [%?]",
                     chat->id, spammer->user->id, times(spammer->spamTimes));
 
-                tbot::ChatMemberAdministrator::Ptr botInfo = chat->botInfo();
+                const tbot::ChatMemberAdministrator::Ptr& botInfo = runtime->botInfo;
                 if (botInfo && botInfo->can_restrict_members)
                 {
                     auto params = tbot::tgfunction("banChatMember");
@@ -2981,7 +3148,6 @@ void Application::resetSpam(qint64 chatId, qint64 userId)
         params->api["chat_id"] = chatId;
         params->api["text"] = botMsg;
         params->api["parse_mode"] = "Markdown";
-        params->delay = 500 /*0.5 сек*/;
         sendTgCommand(params);
 
         // Сообщение в лог
@@ -3017,7 +3183,7 @@ void Application::antiRaidUser(qint64 chatId, const tbot::User::Ptr& user)
         }
 
         tbot::User::List* users = &antiRaid->usersTmp;
-        if (chat->antiRaidTurnOn)
+        if (chat->antiRaidTurnOn())
             users = &antiRaid->usersBan;
 
         if (users->sortState() != lst::SortState::Up)
@@ -3026,7 +3192,7 @@ void Application::antiRaidUser(qint64 chatId, const tbot::User::Ptr& user)
         lst::FindResult fr = users->findRef(user->id);
         if (fr.failed())
         {
-            if (chat->antiRaidTurnOn)
+            if (chat->antiRaidTurnOn())
             {
                 log_verbose_m << log_format(
                     "Chat: %?. Anti-Raid mode is active, user %?/%?/@%?/%? added to ban list",
@@ -3049,7 +3215,7 @@ void Application::antiRaidMessage(qint64 chatId, qint64 userId, qint32 messageId
         if (!chat->antiRaid.active)
             return;
 
-        if (!chat->antiRaidTurnOn)
+        if (!chat->antiRaidTurnOn())
             return;
 
         if (AntiRaid* antiRaid = _antiRaidCache.findItem(&chatId))
@@ -3158,6 +3324,23 @@ void Application::loadBotCommands()
     config::state().getValue("user_trigger.chats", loadFunc, false);
 
     // delete_delay
+    _timingWheel.clear();
+    _delayedDeletes.clear();
+
+    QString deleteDelayFile;
+    config::base().getValue("delete_delay.file", deleteDelayFile);
+    _timingWheel.load(deleteDelayFile, steadyTime());
+
+    for (const tbot::TimingWheel::Item& item : _timingWheel.items(true))
+        if (item.params->funcName == "deleteMessage")
+        {
+            DeleteKey key {item.params->api["chat_id"].toLongLong(),
+                           item.params->api["message_id"].toInt()};
+            _delayedDeletes[key] = item.id;
+        }
+
+    // Отложенные удаления в формате предыдущих версий (state-файл), при
+    // следующем сохранении секции они будут удалены из state-файла
     YamlConfig::Func loadFunc2 = [this](YamlConfig* conf, YAML::Node& nodes, bool)
     {
         for (const YAML::Node& node : nodes)
@@ -3166,11 +3349,10 @@ void Application::loadBotCommands()
             conf->getValue(node, "chat_id",     dd.chatId);
             conf->getValue(node, "message_id",  dd.messageId);
             conf->getValue(node, "delete_time", dd.deleteTime);
-            _deleteDelays.append(dd);
+            delayedDelete(dd.chatId, dd.messageId, dd.deleteTime);
         }
         return true;
     };
-    _deleteDelays.clear();
     config::state().getValue("delete_delay.items", loadFunc2, false);
 
     // user_join_time
@@ -3242,41 +3424,16 @@ void Application::loadBotCommands()
     loadFunc4();
 
     // fuzzy_text
-    auto loadFunc5 = []()
+    auto loadFunc5 = [this]()
     {
         QString stateFile;
         config::base().getValue("fuzzy_text.file", stateFile);
 
-        QFile file {stateFile};
-        if (!file.exists())
-        {
-            log_warn_m << "Fuzzy-Text state file not exists " << stateFile;
+        data::FuzzyText::List list;
+        if (!_fuzzyStore.load(stateFile, list))
             return;
-        }
-
-        if (!file.open(QIODevice::ReadOnly))
-        {
-            log_error_m << "Failed open Fuzzy-Text state file in read-only mode"
-                        << ". File: " << stateFile;
-            return;
-        }
-
-        QByteArray ba = file.readAll();
-        file.close();
 
-        data::FuzzyTextSerialize serialize;
-        if (!serialize.fromJson(ba))
-        {
-            log_error_m << "Failed deserialize Fuzzy-Text data from file " << stateFile;
-            return;
-        }
-
-        for (data::FuzzyText* fuzzyText : serialize.items)
-        {
-            const u32string text32 = fuzzyText->text.toLower().toStdU32String();
-            fuzzyText->fuzzyCache = data::FuzzyText::FuzzyCachePtr::create(text32);
-        }
-        tbot::fuzzyTexts().listSwap(serialize.items);
+        tbot::fuzzyTexts().listSwap(list);
         tbot::fuzzyTexts().resetChangeFlag();
     };
     loadFunc5();
@@ -3357,20 +3514,9 @@ void Application::saveBotCommands(UpdateBotSection section, qint64 timemark)
     {
         config::state().setValue("delete_delay.timemark", timemark);
 
-        YamlConfig::Func saveFunc = [this](YamlConfig* conf, YAML::Node& node, bool)
-        {
-            for (const data::DeleteDelay& dd : _deleteDelays)
-            {
-                YAML::Node n;
-                conf->setValue(n, "chat_id",     dd.chatId);
-                conf->setValue(n, "message_id",  dd.messageId);
-                conf->setValue(n, "delete_time", dd.deleteTime);
-                node.push_back(n);
-            }
-            return true;
-        };
+        // Отложенные удаления хранятся в контрольной точке колеса таймеров,
+        // которая записывается по таймеру _configStateTimerId
         config::state().remove("delete_delay.items");
-        config::state().setValue("delete_delay.items", saveFunc);
     }
     else if (section == user_join_time)
     {
@@ -3437,27 +3583,8 @@ void Application::saveBotCommands(UpdateBotSection section, qint64 timemark)
         QString stateFile;
         config::base().getValue("fuzzy_text.file", stateFile);
 
-        if (QFile::exists(stateFile))
-            if (!QFile::remove(stateFile))
-            {
-                log_error_m << "Failed remove old Fuzzy-Text state file: "
-                            << stateFile;
-                return;
-            }
-
-        QFile file {stateFile};
-        if (!file.open(QIODevice::WriteOnly))
-        {
-            log_error_m << "Failed open Fuzzy-Text state file in write mode"
-                        << ". File: " << stateFile;
-            return;
-        }
-
-        data::FuzzyTextSerialize serialize;
-        serialize.items = tbot::fuzzyTexts().list();
-        QByteArray ba = serialize.toJson();
-        file.write(ba);
-        file.close();
+        // В файл дописываются только изменения списка
+        _fuzzyStore.save(stateFile, tbot::fuzzyTexts().list());
     }
     else if (section == spam_user)
     {
@@ -3524,7 +3651,7 @@ void Application::updateBotCommands(UpdateBotSection section)
     {
         data::DeleteDelaySync deleteDelaySync;
         deleteDelaySync.timemark = timemark;
-        deleteDelaySync.items = _deleteDelays;
+        deleteDelaySync.items = deleteDelays();
 
         // Отправляем событие с измененными delete_delay
         Message::Ptr m = createJsonMessage(deleteDelaySync, {Message::Type::Event});
@@ -3562,6 +3689,44 @@ void Application::updateBotCommands(UpdateBotSection section)
     }
 }
 
+void Application::sendBioToProcessing(const tbot::TgParams::Ptr& params,
+                                      const tbot::UserBio& userBio)
+{
+    tbot::MessageData::Ptr msgData {tbot::MessageData::Ptr::create()};
+    msgData->bio = params->bio;
+    msgData->isNewUser = params->isNewUser;
+    msgData->update.update_id = params->bio.updateId;
+
+    // Конструирование BIO сообщения
+    tbot::User::Ptr user {new tbot::User};
+    user->id = params->bio.userId;
+    user->first_name = userBio.first_name;
+    user->last_name  = userBio.last_name;
+    user->username   = userBio.username;
+
+    tbot::Chat::Ptr chat {new tbot::Chat};
+    chat->id = params->bio.chatId;
+
+    tbot::Message::Ptr message {new tbot::Message};
+
+    message->message_id = params->bio.messageId;
+    message->media_group_id = params->bio.mediaGroupId;
+    message->text = userBio.bio;
+    message->from = user;
+    message->chat = chat;
+
+    message->personal_chat = userBio.personal_chat;
+
+    if (userBio.business_location)
+        message->text += " " + userBio.business_location->address;
+
+    msgData->update.message = message;
+
+    //log_verbose_m << "Emulation BIO message: " << msgData->update.toJson();
+
+    sendToProcessing(msgData);
+}
+
 void Application::sendToProcessing(const tbot::MessageData::Ptr& msgData)
 {
     tbot::Message::Ptr message = (msgData->update.message)
@@ -3660,7 +3825,6 @@ bool Application::botCommand(const tbot::MessageData::Ptr& msgData)
         auto params = tbot::tgfunction("deleteMessage");
         params->api["chat_id"] = chatId;
         params->api["message_id"] = messageId;
-        params->delay = 200 /*0.2 сек*/;
         sendTgCommand(params);
     };
 
@@ -3746,7 +3910,7 @@ bool Application::botCommand(const tbot::MessageData::Ptr& msgData)
                 tbot::Message::Ptr reply = message->reply_to_message;
                 if (reply.empty())
                 {
-                    if (!chat->adminIds().contains(userId))
+                    if (!chat->runtime()->adminIds.contains(userId))
                     {
                         botMsg = u8"Слова <i>%1</i> зарезервированы, "
                                  u8"они используются для обозначения спам-сообщений";
@@ -3757,7 +3921,6 @@ bool Application::botCommand(const tbot::MessageData::Ptr& msgData)
                         params->api["chat_id"] = chatId;
                         params->api["text"] = botMsg;
                         params->api["parse_mode"] = "HTML";
-                        params->delay = 1.5*1000 /*1.5 сек*/;
                         params->messageDel = 15  /* 15 сек*/;
                         sendTgCommand(params);
                     }
@@ -3768,7 +3931,7 @@ bool Application::botCommand(const tbot::MessageData::Ptr& msgData)
                     return true;
 
                 tbot::User::Ptr spamUser = reply->from;
-                if (chat->adminIds().contains(spamUser->id))
+                if (chat->runtime()->adminIds.contains(spamUser->id))
                 {
                     log_verbose_m << log_format(
                         u8"\"update_id\":%?. Chat: %?"
@@ -3783,13 +3946,12 @@ bool Application::botCommand(const tbot::MessageData::Ptr& msgData)
                     params->api["text"] = botMsg; //.arg(stringUserInfo(spamUser, true));
                     params->api["parse_mode"] = "Markdown";
                     params->api["reply_to_message_id"] = reply->message_id;
-                    params->delay = 1.5*1000 /*1.5 сек*/;
                     params->messageDel = 20  /* 20 сек*/;
                     sendTgCommand(params);
                     return true;
                 }
 
-                if (chat->adminIds().contains(userId))
+                if (chat->runtime()->adminIds.contains(userId))
                 {
                     // Конструируем сообщение с пометкой 'спам' и отправляем  в модуль  обработки
                     // на анализ существования медиагруппы с последующим удалением всех сообщений
@@ -3808,7 +3970,6 @@ bool Application::botCommand(const tbot::MessageData::Ptr& msgData)
                             auto params = tbot::tgfunction("deleteMessage");
                             params->api["chat_id"] = usi.chatId;
                             params->api["message_id"] = usi.messageId;
-                            params->delay = 200 /*0.2 сек*/;
                             sendTgCommand(params);
 
                             _userSpanInforms.removeAt(i--);
@@ -3825,7 +3986,7 @@ bool Application::botCommand(const tbot::MessageData::Ptr& msgData)
                         u8"\r\n%1";
 
                     QString anames;
-                    for (const QString& s : chat->adminNames())
+                    for (const QString& s : chat->runtime()->adminNames)
                         anames += "@" + s + " ";
 
                     botMsg = botMsg.arg(anames);
@@ -3836,7 +3997,6 @@ bool Application::botCommand(const tbot::MessageData::Ptr& msgData)
                     params->api["text"] = botMsg;
                     params->api["parse_mode"] = "Markdown";
                     params->api["reply_to_message_id"] = reply->message_id;
-                    params->delay = 1.5*1000 /*1.5 сек*/;
                     params->messageDel = -1;
                     params->spamMessageId = reply->message_id;
                     sendTgCommand(params);
@@ -3983,7 +4143,7 @@ bool Application::botCommand(const tbot::MessageData::Ptr& msgData)
             return true;
         }
 
-        if (!chat->adminIds().contains(userId))
+        if (!chat->runtime()->adminIds.contains(userId))
         {
             // Тайминг сообщения 1.5 сек
             sendMessage(u8"Для управления ботом нужны права администратора");
@@ -4033,6 +4193,7 @@ bool Application::botCommand(const tbot::MessageData::Ptr& msgData)
             {
                 tbot::timelimitInactiveChatsRemove(chatId);
                 updateBotCommands(timelimit_inactive);
+                timelimitSchedule();
 
                 sendMessage(u8"Триггер timelimit активирован");
             }
@@ -4040,6 +4201,7 @@ bool Application::botCommand(const tbot::MessageData::Ptr& msgData)
             {
                 tbot::timelimitInactiveChatsAdd(chatId);
                 updateBotCommands(timelimit_inactive);
+                timelimitSchedule();
 
                 sendMessage(u8"Триггер timelimit деактивирован");
             }
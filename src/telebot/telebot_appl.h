@@ -1,6 +1,14 @@
 #pragma once
 
 #include "processing.h"
+#include "groups_loader.h"
+#include "fuzzy_store.h"
+#include "outbound_scheduler.h"
+#include "delete_aggregator.h"
+#include "http_client.h"
+#include "retry_policy.h"
+#include "request_coalescer.h"
+#include "timing_wheel.h"
 
 #include "commands/commands.h"
 #include "commands/error.h"
@@ -15,9 +23,8 @@
 #include <QTcpSocket>
 #include <QSslSocket>
 #include <QTcpServer>
-#include <QUrlQuery>
-#include <QNetworkReply>
-#include <QNetworkAccessManager>
+#include <QLocalServer>
+#include <QLocalSocket>
 
 #include <atomic>
 #include <chrono>
@@ -53,21 +60,6 @@ public:
     static void stop() {_stop = true;}
     static bool isStopped() {return _stop;}
 
-    struct ReplyData
-    {
-        QNetworkReply* reply = {nullptr};
-        quint64 replyNumber = {0};
-
-        // Параметры для функции sendTgCommand()
-        tbot::TgParams::Ptr params;
-
-        // Результат выполнения http запроса в raw-формате
-        QByteArray data;
-
-        // Признак успешно выполненного http запроса
-        bool success = {true};
-    };
-
 public slots:
     void stop(int exitCode);
     void message(const pproto::Message::Ptr&);
@@ -81,27 +73,33 @@ public slots:
     void webhook_disconnected();
     void webhook_socketError(QAbstractSocket::SocketError);
     void webhook_sslSocketError(const QList<QSslError>&);
+    void webhook_newLocalConnection();
+    void webhook_localSocketError(QLocalSocket::LocalSocketError);
 
-    void http_readyRead();
-    void http_finished();
-    void http_error(QNetworkReply::NetworkError);
-    void http_encrypted();
-    void http_sslErrors(const QList<QSslError>&);
+    void http_finished(const tbot::HttpReply&);
 
     void reloadConfig();
     void reloadBotMode();
 
     void reloadGroup(qint64 chatId, bool botCommand);
     void reloadGroups(const QString& configFile);
+    void groupsLoaded(const tbot::GroupsLoader::Result::Ptr&);
 
     void startRequest();
+
+    // Строит очередь событий timelimit триггеров. Вызывается при перезагрузке
+    // конфигурации групп и при изменении списка timelimitInactiveChats
+    void timelimitSchedule();
+
+    // Публикует сообщения для наступивших событий timelimit триггеров
     void timelimitCheck();
 
-    // Функция для отправки Телеграм-команды
+    // Функция для отправки Телеграм-команды. Команда помещается в очередь
+    // планировщика и отправляется с учетом ограничений Телеграм
     void sendTgCommand(const tbot::TgParams::Ptr&);
 
     // Функция-обработчик http ответов
-    void httpResultHandler(const ReplyData&);
+    void httpResultHandler(const tbot::HttpReply&);
 
     // Обработка штрафов за спам-сообщения
     void reportSpam(qint64 chatId, const tbot::User::Ptr&);
@@ -153,9 +151,46 @@ private:
 
     void sendToProcessing(const tbot::MessageData::Ptr&);
 
+    // Конструирует BIO сообщение из результата запроса getChat и передает
+    // его на обработку
+    void sendBioToProcessing(const tbot::TgParams::Ptr&, const tbot::UserBio&);
+
+    // Запускает таймер до ближайшего события timelimit триггеров
+    void timelimitTimerStart();
+
+    // Отправляет в группу сообщение о начале/окончании действия триггера
+    void timelimitMessage(tbot::GroupChat*, tbot::TriggerTimeLimit*,
+                          const tbot::TriggerTimeLimit::Transition&);
+
     // Обрабатывает команды для бота
     bool botCommand(const tbot::MessageData::Ptr&);
 
+    // Отправляет команды, для которых наступило время отправки и не исчерпаны
+    // лимиты, и запускает таймер до момента отправки следующей команды
+    void outboundDispatch();
+
+    // Помещает команду в очередь отправки или в агрегатор команд удаления
+    void outboundEnqueue(const tbot::TgParams::Ptr&, qint64 now);
+
+    // Помещает команду в колесо таймеров, time - время отправки по монотон-
+    // ным часам. Для одного сообщения хранится только наиболее раннее  от-
+    // ложенное удаление
+    void delayedCommand(const tbot::TgParams::Ptr&, qint64 time, bool persistent);
+
+    // Отложенное удаление сервисного сообщения бота, deleteTime - время UTC
+    // в миллисекундах
+    void delayedDelete(qint64 chatId, qint32 messageId, qint64 deleteTime);
+
+    // Список отложенных удалений для синхронизации master/slave ботов
+    QList<data::DeleteDelay> deleteDelays() const;
+    void setDeleteDelays(const QList<data::DeleteDelay>&);
+
+    // Записывает контрольную точку колеса таймеров
+    void saveDelayedCommands();
+
+    // Выполняет http запрос для Телеграм-команды
+    void httpSendCommand(const tbot::TgParams::Ptr&);
+
 private:
     static QUuidEx _applId;
     static volatile bool _stop;
@@ -165,6 +200,7 @@ private:
     int _slaveTimerId = {-1};
     int _antiraidTimerId = {-1};
     int _timelimitTimerId = {-1};
+    int _outboundTimerId = {-1};
     int _userJoinTimerId = {-1};
     int _whiteUserTimerId = {-1};
     int _fuzzyTextTimerId = {-1};
@@ -184,12 +220,43 @@ private:
     QSslCertificate _sslCert;
     SslServer::Ptr _webhookServer;
 
+    // Прием webhook от локального telegram-bot сервера через Unix-сокет
+    container_ptr<QLocalServer> _webhookLocalServer;
+
     bool _localServer = {false};
     QString _localServerAddr;
     int _localServerPort = {0};
 
     tbot::Processing::List _procList;
 
+    // Поток для загрузки конфигурации групп
+    tbot::GroupsLoader _groupsLoader;
+
+    // Webhook-сообщения, полученные до публикации конфигурации групп
+    QList<tbot::MessageData::Ptr> _pendingUpdates;
+
+    // Бинарный журнал для сохранения списка FuzzyText
+    tbot::FuzzyStore _fuzzyStore;
+
+    // Очередь исходящих Телеграм-команд
+    tbot::OutboundScheduler _outboundScheduler;
+
+    // Объединение команд удаления сообщений в пакеты
+    tbot::DeleteAggregator _deleteAggregator;
+
+    // Отложенные Телеграм-команды
+    tbot::TimingWheel _timingWheel;
+
+    // Отложенные удаления сообщений, используются для отмены удаления
+    typedef QPair<qint64 /*chat id*/, qint32 /*message id*/> DeleteKey;
+    QHash<DeleteKey, quint64 /*идентификатор в колесе*/> _delayedDeletes;
+
+    // Политика повторных вызовов для команд, завершившихся ошибкой
+    tbot::RetryPolicy _retryPolicy;
+
+    // Объединение одинаковых запросов getChat/getChatAdministrators
+    tbot::RequestCoalescer _requestCoalescer;
+
     typedef QVector<QPair<SocketDescriptor, steady_timer>> SocketPair;
     SocketPair _waitAuthSockets;   // Список сокетов ожидающих авторизацию
     SocketPair _waitCloseSockets;  // Список сокетов ожидающих закрытие
@@ -232,33 +299,16 @@ private:
     };
     Spammer::List _spammers;
 
-    struct TimeLimit
+    struct TimelimitEvent
     {
         qint64  chatId = {0};
         QString triggerName;
-        steady_timer timer;
-
-        struct Compare
-        {
-            int operator() (const TimeLimit* item1, const TimeLimit* item2) const
-            {
-                LIST_COMPARE_MULTI_ITEM(item1->chatId, item2->chatId)
-                return item1->triggerName.compare(item2->triggerName);
-            }
-            int operator() (const QPair<qint64 /*chat id*/, QString /*trigger name*/>* pair,
-                            const TimeLimit* item2) const
-            {
-                LIST_COMPARE_MULTI_ITEM(pair->first, item2->chatId)
-                return pair->second.compare(item2->triggerName);
-            }
-        };
-        typedef lst::List<TimeLimit, Compare> List;
     };
 
-    // Списки начала и окончания действия триггеров timelimit, используются
-    // для публикации сообщений об начале и окончании работы триггера
-    TimeLimit::List _timelimitBegins;
-    TimeLimit::List _timelimitEnds;
+    // Очередь событий начала и окончания действия триггеров timelimit,
+    // упорядочена по UTC-времени события (в секундах). Используется для
+    // публикации сообщений об начале и окончании работы триггера
+    QMultiMap<qint64, TimelimitEvent> _timelimitEvents;
 
     struct AntiRaid
     {
@@ -359,11 +409,11 @@ private:
     QList<UserSpanInform> _userSpanInforms;
 
     data::UserTrigger::List _userTriggers;
-    QList<data::DeleteDelay> _deleteDelays;
 
     struct WebhookData
     {
-        QSslSocket* socket = {nullptr};
+        // QSslSocket или QLocalSocket
+        QIODevice* socket = {nullptr};
         qintptr socketDescr = {-1};
         bool keepAlive = {false};
         qint64 dataSize = {-1};
@@ -371,10 +421,10 @@ private:
     };
 
     QHash<quint64 /*socket id*/, WebhookData> _webhookMap;
-    QHash<quint64 /*socket id*/, ReplyData>   _httpReplyMap;
 
-    typedef container_ptr<QNetworkAccessManager> QNetworkAccessManagerPtr;
-    QNetworkAccessManagerPtr _networkAccManager;
+    // Потоки для выполнения исходящих http запросов
+    tbot::HttpClient::List _httpClients;
+    int _httpClientIndex = {0};
 
     bool _printTriggers = {true};
     bool _printGroupChats = {true};
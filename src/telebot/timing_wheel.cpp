@@ -0,0 +1,351 @@
+#include "timing_wheel.h"
+
+#include "shared/break_point.h"
+#include "shared/logger/logger.h"
+#include "shared/logger/format.h"
+
+#include <algorithm>
+
+#define log_error_m   alog::logger().error  (alog_line_location, "TimingWheel")
+#define log_warn_m    alog::logger().warn   (alog_line_location, "TimingWheel")
+#define log_info_m    alog::logger().info   (alog_line_location, "TimingWheel")
+#define log_verbose_m alog::logger().verbose(alog_line_location, "TimingWheel")
+#define log_debug_m   alog::logger().debug  (alog_line_location, "TimingWheel")
+#define log_debug2_m  alog::logger().debug2 (alog_line_location, "TimingWheel")
+
+namespace tbot {
+
+// Сигнатура файла контрольной точки: 'TBTW'
+static const quint32 checkpointMagic = 0x54425457;
+
+// Версия формата файла, должна увеличиваться при любом изменении состава
+// сохраняемых полей
+static const quint32 checkpointFormat = 1;
+
+quint64 TimingWheel::add(qint64 time, const TgParams::Ptr& params, bool persistent)
+{
+    Item item;
+    item.id = ++_nextId;
+    item.time = time;
+    item.params = params;
+    item.persistent = persistent;
+    _items.insert(item.id, item);
+
+    if (tickOf(time) <= _tick)
+        _due.append(item.id);
+    else
+        place(item.id, time);
+
+    if (persistent)
+        _changed = true;
+
+    return item.id;
+}
+
+bool TimingWheel::cancel(quint64 id)
+{
+    auto it = _items.find(id);
+    if (it == _items.end())
+        return false;
+
+    if (it->persistent)
+        _changed = true;
+
+    // Идентификатор остается в ячейке колеса и будет пропущен при ее
+    // срабатывании
+    _items.erase(it);
+    return true;
+}
+
+const TimingWheel::Item* TimingWheel::find(quint64 id) const
+{
+    auto it = _items.constFind(id);
+    return (it != _items.constEnd()) ? &it.value() : nullptr;
+}
+
+QVector<TimingWheel::Item> TimingWheel::advance(qint64 now)
+{
+    QVector<Item> fired;
+    const qint64 target = now / Tick;
+
+    auto fire = [&](quint64 id)
+    {
+        auto it = _items.find(id);
+        if (it == _items.end())
+            return;
+
+        if (it->persistent)
+            _changed = true;
+
+        fired.append(it.value());
+        _items.erase(it);
+    };
+
+    for (quint64 id : _due)
+        fire(id);
+    _due.clear();
+
+    if (_tick < 0)
+    {
+        // Первый вызов: команды, добавленные до установки текущего времени,
+        // размещаются в колесе заново
+        _tick = target;
+        for (int level = 0; level < Levels; ++level)
+            for (int i = 0; i < Slots; ++i)
+                _slots[level][i].clear();
+
+        for (const Item& item : items(false))
+        {
+            if (tickOf(item.time) <= _tick)
+                fire(item.id);
+            else
+                place(item.id, item.time);
+        }
+        return fired;
+    }
+
+    // Пустое колесо не требует прохода по шагам
+    if (_items.isEmpty())
+    {
+        _tick = std::max(_tick, target);
+        return fired;
+    }
+
+    while (_tick < target)
+    {
+        ++_tick;
+        const int index = int(_tick & (Slots - 1));
+        if (index == 0)
+            cascade(1);
+
+        QVector<quint64> ids;
+        ids.swap(_slots[0][index]);
+        for (quint64 id : ids)
+        {
+            const Item* item = find(id);
+            if (item == nullptr)
+                continue;
+
+            if (tickOf(item->time) <= _tick)
+                fire(id);
+            else
+                place(id, item->time);
+        }
+
+        if (_items.isEmpty())
+        {
+            _tick = target;
+            break;
+        }
+    }
+    return fired;
+}
+
+qint64 TimingWheel::wait(qint64 now) const
+{
+    if (!_due.isEmpty())
+        return 0;
+
+    if (_items.isEmpty())
+        return -1;
+
+    qint64 next = -1;
+
+    // Ближайшая непустая ячейка нижнего уровня
+    for (int i = 1; i <= Slots; ++i)
+        if (!_slots[0][(_tick + i) & (Slots - 1)].isEmpty())
+        {
+            next = _tick + i;
+            break;
+        }
+
+    // Ближайший перенос команд с верхних уровней
+    for (int level = 1; level < Levels; ++level)
+    {
+        const int shift = LevelBits * level;
+        for (int i = 1; i <= Slots; ++i)
+        {
+            const qint64 base = (_tick >> shift) + i;
+            if (!_slots[level][base & (Slots - 1)].isEmpty())
+            {
+                const qint64 tick = base << shift;
+                if ((next == -1) || (tick < next))
+                    next = tick;
+                break;
+            }
+        }
+    }
+
+    // В ячейках остались только идентификаторы отмененных команд
+    if (next == -1)
+        return -1;
+
+    return std::max(next * Tick - now, qint64(0));
+}
+
+QVector<TimingWheel::Item> TimingWheel::items(bool persistentOnly) const
+{
+    QVector<Item> items;
+    for (const Item& item : _items)
+        if (!persistentOnly || item.persistent)
+            items.append(item);
+    return items;
+}
+
+void TimingWheel::clear()
+{
+    for (const Item& item : _items)
+        if (item.persistent)
+        {
+            _changed = true;
+            break;
+        }
+
+    _items.clear();
+    _due.clear();
+    for (int level = 0; level < Levels; ++level)
+        for (int i = 0; i < Slots; ++i)
+            _slots[level][i].clear();
+}
+
+qint64 TimingWheel::tickOf(qint64 time)
+{
+    // Округление вверх: команда не отправляется раньше заданного времени
+    return (time + Tick - 1) / Tick;
+}
+
+void TimingWheel::place(quint64 id, qint64 time)
+{
+    qint64 tick = std::max(tickOf(time), _tick);
+    qint64 delta = tick - _tick;
+
+    // Время отправки за пределами колеса: команда размещается в  ячейке
+    // верхнего уровня и будет перенесена повторно
+    const qint64 range = qint64(1) << (LevelBits * Levels);
+    if (delta >= range)
+    {
+        tick = _tick + range - 1;
+        delta = range - 1;
+    }
+
+    int level = 0;
+    while ((level < Levels - 1)
+           && (delta >= (qint64(1) << (LevelBits * (level + 1)))))
+    {
+        ++level;
+    }
+
+    const int index = int((tick >> (LevelBits * level)) & (Slots - 1));
+    _slots[level][index].append(id);
+}
+
+void TimingWheel::cascade(int level)
+{
+    const int index = int((_tick >> (LevelBits * level)) & (Slots - 1));
+
+    QVector<quint64> ids;
+    ids.swap(_slots[level][index]);
+    for (quint64 id : ids)
+        if (const Item* item = find(id))
+            place(id, item->time);
+
+    if ((index == 0) && (level + 1 < Levels))
+        cascade(level + 1);
+}
+
+bool TimingWheel::save(const QString& fileName, qint64 now)
+{
+    QSaveFile file {fileName};
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        log_error_m << "Failed open Timing-Wheel checkpoint file in write mode"
+                    << ". File: " << fileName;
+        return false;
+    }
+
+    const QVector<Item> items = this->items(true);
+    const qint64 utcNow = QDateTime::currentMSecsSinceEpoch();
+
+    QDataStream s {&file};
+    s.setVersion(QDATASTREAM_VERSION);
+    s << checkpointMagic << checkpointFormat << qint32(items.count());
+
+    for (const Item& item : items)
+    {
+        s << qint64(utcNow + (item.time - now))
+          << item.params->funcName
+          << item.params->api
+          << qint32(item.params->messageDel);
+    }
+
+    if (s.status() != QDataStream::Ok || !file.commit())
+    {
+        log_error_m << "Failed save Timing-Wheel checkpoint file: " << fileName;
+        return false;
+    }
+    _changed = false;
+
+    log_debug_m << log_format("Timing-Wheel checkpoint saved: %?. Commands: %?",
+                              fileName, items.count());
+    return true;
+}
+
+bool TimingWheel::load(const QString& fileName, qint64 now)
+{
+    if (_tick < 0)
+        _tick = now / Tick;
+
+    QFile file {fileName};
+    if (!file.exists())
+    {
+        log_warn_m << "Timing-Wheel checkpoint file not exists " << fileName;
+        return false;
+    }
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        log_error_m << "Failed open Timing-Wheel checkpoint file in read-only mode"
+                    << ". File: " << fileName;
+        return false;
+    }
+
+    QDataStream s {&file};
+    s.setVersion(QDATASTREAM_VERSION);
+
+    quint32 magic, format;
+    qint32 count;
+    s >> magic >> format >> count;
+
+    if ((magic != checkpointMagic) || (format != checkpointFormat))
+    {
+        log_error_m << "Timing-Wheel checkpoint file has unknown format: " << fileName;
+        return false;
+    }
+
+    const qint64 utcNow = QDateTime::currentMSecsSinceEpoch();
+    for (qint32 i = 0; i < count; ++i)
+    {
+        qint64 utcTime;
+        qint32 messageDel;
+        auto params = TgParams::Ptr::create();
+        s >> utcTime >> params->funcName >> params->api >> messageDel;
+
+        if (s.status() != QDataStream::Ok)
+        {
+            log_error_m << "Failed read Timing-Wheel checkpoint file: " << fileName;
+            return false;
+        }
+        params->messageDel = messageDel;
+
+        // Команды, время отправки которых наступило во время простоя
+        // программы, отправляются немедленно
+        add(now + std::max(utcTime - utcNow, qint64(0)), params, true);
+    }
+    _changed = false;
+
+    log_verbose_m << log_format("Timing-Wheel checkpoint loaded: %?. Commands: %?",
+                                fileName, count);
+    return true;
+}
+
+} // namespace tbot
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "processing.h"
+
+#include <QtCore>
+
+namespace tbot {
+
+/**
+  Иерархическое колесо таймеров для отложенных Телеграм-команд (задержка
+  отправки, удаление сервисных сообщений бота, повторные попытки). Колесо
+  состоит из нескольких уровней по 64 ячейки, шаг нижнего уровня - Tick
+  миллисекунд, каждый следующий уровень в 64 раза грубее  предыдущего.
+  Добавление команды и срабатывание выполняются за O(1), команды верхних
+  уровней по мере приближения времени отправки переносятся на нижние.
+
+  Отмена команды удаляет ее из общего списка, идентификатор в ячейке кон-
+  тролируется при срабатывании ячейки.
+
+  Команды с признаком persistent сохраняются в файл контрольной точки,
+  время отправки в файле записывается как время UTC. Таким образом отложен-
+  ные удаления сообщений переживают перезапуск программы.
+
+  Время задается в миллисекундах по монотонным часам, текущее время колеса
+  устанавливается функцией advance(). Класс не является потокобезопасным,
+  используется в потоке приложения
+*/
+class TimingWheel
+{
+public:
+    // Шаг нижнего уровня колеса (мсек)
+    static constexpr int Tick = 10;
+
+    struct Item
+    {
+        quint64 id = {0};
+        qint64 time = {0};          // Время отправки команды
+        TgParams::Ptr params;
+        bool persistent = {false};  // Команда сохраняется в контрольной точке
+    };
+
+    // Добавляет команду с временем отправки time, возвращает идентификатор
+    // команды
+    quint64 add(qint64 time, const TgParams::Ptr&, bool persistent = false);
+
+    // Отменяет команду. Возвращает FALSE если команда не найдена (уже
+    // отправлена или отменена)
+    bool cancel(quint64 id);
+
+    const Item* find(quint64 id) const;
+
+    // Извлекает команды, время отправки которых наступило к моменту now
+    QVector<Item> advance(qint64 now);
+
+    // Время (в миллисекундах) до следующего срабатывания колеса. Значение
+    // -1 - колесо пустое
+    qint64 wait(qint64 now) const;
+
+    QVector<Item> items(bool persistentOnly) const;
+
+    int count() const {return _items.count();}
+    void clear();
+
+    // Признак изменения списка сохраняемых команд после последнего сохранения
+    bool changed() const {return _changed;}
+
+    // Сохраняет/загружает сохраняемые команды, now - текущее время
+    bool save(const QString& fileName, qint64 now);
+    bool load(const QString& fileName, qint64 now);
+
+private:
+    // Шаг колеса, на котором наступает время time
+    static qint64 tickOf(qint64 time);
+
+    // Размещает команду в ячейке колеса, время команды не меньше текущего
+    // шага колеса
+    void place(quint64 id, qint64 time);
+
+    // Переносит команды ячейки уровня level, соответствующей текущему шагу,
+    // на нижние уровни
+    void cascade(int level);
+
+private:
+    static constexpr int LevelBits = 6;
+    static constexpr int Slots = 1 << LevelBits;
+    static constexpr int Levels = 5;
+
+    QHash<quint64, Item> _items;
+    QVector<quint64> _slots[Levels][Slots];
+
+    // Команды, время отправки которых наступило на момент добавления
+    QVector<quint64> _due;
+
+    qint64 _tick = {-1}; // Текущий шаг колеса
+    quint64 _nextId = {0};
+    bool _changed = {false};
+};
+
+} // namespace tbot
@@ -7,7 +7,9 @@
 #include "shared/logger/format.h"
 
 #include <string>
+#include <algorithm>
 #include <optional>
+#include <exception>
 #include <stdexcept>
 
 #define log_error_m   alog::logger().error  (alog_line_location, "Trigger")
@@ -29,6 +31,7 @@ struct trigger_logic_error : public std::logic_error
 };
 
 thread_local QString Trigger::activationReasonMessage;
+thread_local QHash<QByteArray, Trigger::MatchResult> Trigger::_matchResults;
 
 void Trigger::assign(const Trigger& trigger)
 {
@@ -47,6 +50,47 @@ void Trigger::assign(const Trigger& trigger)
     immediatelyBan = trigger.immediatelyBan;
 }
 
+void Trigger::clearMatchResults()
+{
+    _matchResults.clear();
+}
+
+bool Trigger::findMatchResult(const Update& update, GroupChat* chat,
+                              bool& active) const
+{
+    if (matchHash.isEmpty())
+        return false;
+
+    auto it = _matchResults.constFind(matchHash);
+    if (it == _matchResults.constEnd())
+        return false;
+
+    active = it->active;
+    activationReasonMessage = it->reasonMessage;
+
+    if (active)
+        log_verbose_m << log_format(
+            "\"update_id\":%?. Chat: %?. Trigger '%?' activated"
+            ". Used match result of the trigger with same match data",
+            update.update_id, chat->name(), name);
+    return true;
+}
+
+void Trigger::saveMatchResult(bool active) const
+{
+    if (matchHash.isEmpty())
+        return;
+
+    MatchResult& result = _matchResults[matchHash];
+    result.active = active;
+    result.reasonMessage = activationReasonMessage;
+}
+
+static QByteArray matchDataHash(const QByteArray& data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
 void TriggerLinkBase::assign(const TriggerLinkBase& trigger)
 {
     Trigger::assign(trigger);
@@ -300,7 +344,30 @@ bool TriggerLinkEnable::isActive(const Update& update, GroupChat* chat,
 }
 
 bool TriggerWord::isActive(const Update& update, GroupChat* chat,
-                           const Text& text_) const
+                           const Text& text) const
+{
+    bool active;
+    if (findMatchResult(update, chat, active))
+        return active;
+
+    active = matchText(update, chat, text);
+    saveMatchResult(active);
+    return active;
+}
+
+void TriggerWord::updateMatchHash()
+{
+    QByteArray data;
+    { //Block for QDataStream
+        QDataStream s {&data, QIODevice::WriteOnly};
+        s.setVersion(QDATASTREAM_VERSION);
+        s << QString("word") << caseInsensitive << wordList;
+    }
+    matchHash = matchDataHash(data);
+}
+
+bool TriggerWord::matchText(const Update& update, GroupChat* chat,
+                            const Text& text_) const
 {
     activationReasonMessage.clear();
     QString text = text_[TextType::Content].toString();
@@ -335,7 +402,37 @@ void TriggerWord::assign(const TriggerWord& trigger)
 }
 
 bool TriggerRegexp::isActive(const Update& update, GroupChat* chat,
-                             const Text& text_) const
+                             const Text& text) const
+{
+    bool active;
+    if (findMatchResult(update, chat, active))
+        return active;
+
+    active = matchText(update, chat, text);
+    saveMatchResult(active);
+    return active;
+}
+
+void TriggerRegexp::updateMatchHash()
+{
+    QByteArray data;
+    { //Block for QDataStream
+        QDataStream s {&data, QIODevice::WriteOnly};
+        s.setVersion(QDATASTREAM_VERSION);
+        s << QString("regexp") << analyze;
+
+        for (const QList<QRegularExpression>* list : {&regexpRemove, &regexpList})
+        {
+            s << qint32(list->count());
+            for (const QRegularExpression& re : *list)
+                s << re.pattern() << qint32(re.patternOptions());
+        }
+    }
+    matchHash = matchDataHash(data);
+}
+
+bool TriggerRegexp::matchText(const Update& update, GroupChat* chat,
+                              const Text& text_) const
 {
     QString text;
     activationReasonMessage.clear();
@@ -403,6 +500,113 @@ void TriggerRegexp::assign(const TriggerRegexp& trigger)
     regexpList      = trigger.regexpList;
 }
 
+bool TriggerFuzzy::isActive(const Update& update, GroupChat* chat,
+                            const Text& text) const
+{
+    bool active;
+    if (findMatchResult(update, chat, active))
+        return active;
+
+    active = matchText(update, chat, text);
+    saveMatchResult(active);
+    return active;
+}
+
+void TriggerFuzzy::updateMatchHash()
+{
+    QByteArray data;
+    { //Block for QDataStream
+        QDataStream s {&data, QIODevice::WriteOnly};
+        s.setVersion(QDATASTREAM_VERSION);
+        s << QString("fuzzy") << qint32(threshold) << templateList;
+    }
+    matchHash = matchDataHash(data);
+}
+
+bool TriggerFuzzy::matchText(const Update& update, GroupChat* chat,
+                             const Text& text_) const
+{
+    activationReasonMessage.clear();
+    QString text = text_[TextType::Content].toString().trimmed();
+
+    if (text.isEmpty() || !_templates)
+        return false;
+
+    // Сначала выполняется поиск точной копии шаблона (после нормализации),
+    // затем поиск похожих шаблонов среди кандидатов из LSH-индекса. Для
+    // порога ниже FuzzyIndex::MinLshThreshold LSH-индекс может пропустить
+    // похожие шаблоны, поэтому текст сравнивается со всеми шаблонами
+    QVector<data::FuzzyText*> found = _templates->index.exact(FuzzyIndex::textHash(text));
+    if (found.isEmpty())
+    {
+        const u32string text32 = text.toLower().toStdU32String();
+
+        QVector<data::FuzzyText*> candidates;
+        if (threshold >= FuzzyIndex::MinLshThreshold)
+        {
+            candidates = _templates->index.candidates(FuzzyIndex::textBands(text32));
+        }
+        else
+        {
+            candidates.reserve(_templates->list.count());
+            for (data::FuzzyText* ft : _templates->list)
+                candidates.append(ft);
+        }
+        found = _templates->index.similar(text32, candidates, threshold);
+    }
+
+    if (found.isEmpty())
+    {
+        log_debug2_m << log_format(
+            "\"update_id\":%?. Chat: %?. Trigger '%?'"
+            ". Similar templates not found",
+            update.update_id, chat->name(), name);
+        return false;
+    }
+
+    const data::FuzzyText* tmpl = found.first();
+    log_verbose_m << log_format(
+        "\"update_id\":%?. Chat: %?. Trigger '%?' activated"
+        ". The text is similar to the template '%?'",
+        update.update_id, chat->name(), name, tmpl->text);
+
+    activationReasonMessage = u8"\r\nшаблон: " + tmpl->text;
+    return true;
+}
+
+void TriggerFuzzy::assign(const TriggerFuzzy& trigger)
+{
+    Trigger::assign(trigger);
+
+    threshold    = trigger.threshold;
+    templateList = trigger.templateList;
+    _templates   = trigger._templates;
+}
+
+void TriggerFuzzy::updateIndex()
+{
+    auto templates = std::make_shared<Templates>();
+    for (int i = 0; i < templateList.count(); ++i)
+    {
+        const QString text = templateList[i].trimmed();
+        if (text.isEmpty())
+            continue;
+
+        data::FuzzyText* ft {new data::FuzzyText};
+        ft->add_ref();
+        ft->messageId = i;
+        ft->text = text;
+        templates->list.add(ft);
+        templates->index.add(ft, FuzzyIndex::textKeys(text));
+    }
+    _templates = templates;
+}
+
+void TriggerFuzzy::shareIndex(const TriggerFuzzy& other)
+{
+    _templates = other._templates;
+}
+
 bool TriggerTimeLimit::isActive(const Update& update, GroupChat* chat,
                                 const Text& /*text*/) const
 {
@@ -426,37 +630,24 @@ bool TriggerTimeLimit::isActive(const Update& update, GroupChat* chat,
         return false;
     }
 
-    // Учитываем временной сдвиг UTC
-    QDateTime dtime = QDateTime::currentDateTimeUtc().addSecs(utc * 60*60);
-    int dayOfWeek = dtime.date().dayOfWeek();
-    QTime curTime = dtime.time();
-
-    Times times;
-    timesRangeOfDay(dayOfWeek, times);
-    for (const TimeRange& time : times)
-    {
-        QTime timeBegin = time.begin.isNull() ? QTime(0, 0) : time.begin;
-        QTime timeEnd   = time.end.isNull()   ? QTime(23, 59, 59, 999) : time.end;
+    const TimeRange* time = weekRange(minuteOfWeek(std::time(nullptr), utc));
+    if (time == nullptr)
+        return false;
 
-        if (timeInRange(timeBegin, curTime, timeEnd))
-        {
-            timeBegin = !time.begin.isNull() ? time.begin : time.hint;
-            timeEnd   = !time.end.isNull()   ? time.end   : time.hint;
+    QTime timeBegin = !time->begin.isNull() ? time->begin : time->hint;
+    QTime timeEnd   = !time->end.isNull()   ? time->end   : time->hint;
 
-            log_verbose_m << log_format(
-                "\"update_id\":%?. Chat: %?. Trigger '%?' activated"
-                ". Message in forbidden time range [%?÷%?]",
-                update.update_id, chat->name(), name,
-                timeBegin.toString("HH:mm"), timeEnd.toString("HH:mm"));
-
-            activationReasonMessage = QString(u8": ограничение на публикацию с %1 до %2")
-                                             .arg(timeBegin.toString("HH:mm"))
-                                             .arg(timeEnd.toString("HH:mm"));
-            activationTime = time;
-            return true;
-        }
-    }
-    return false;
+    log_verbose_m << log_format(
+        "\"update_id\":%?. Chat: %?. Trigger '%?' activated"
+        ". Message in forbidden time range [%?÷%?]",
+        update.update_id, chat->name(), name,
+        timeBegin.toString("HH:mm"), timeEnd.toString("HH:mm"));
+
+    activationReasonMessage = QString(u8": ограничение на публикацию с %1 до %2")
+                                     .arg(timeBegin.toString("HH:mm"))
+                                     .arg(timeEnd.toString("HH:mm"));
+    activationTime = *time;
+    return true;
 }
 
 void TriggerTimeLimit::assign(const TriggerTimeLimit& trigger)
@@ -489,6 +680,110 @@ void TriggerTimeLimit::timesRangeOfDay(int dayOfWeek, Times& times) const
         dayOfWeek, name);
 }
 
+void TriggerTimeLimit::updateWeekTable()
+{
+    _weekTable.fill(-1, MinutesPerWeek);
+    _weekRanges.clear();
+    _transitions.clear();
+
+    for (int dayOfWeek = 1; dayOfWeek <= 7; ++dayOfWeek)
+    {
+        Times times;
+        timesRangeOfDay(dayOfWeek, times);
+
+        qint16* dayTable = _weekTable.data() + (dayOfWeek - 1) * 24*60;
+        for (const TimeRange& time : times)
+        {
+            int begin = time.begin.isNull() ? 0 : time.begin.msecsSinceStartOfDay() / 60000;
+            int end   = time.end.isNull() ? 24*60 : time.end.msecsSinceStartOfDay() / 60000;
+
+            // При совпадении диапазонов действует первый из них (как и при
+            // последовательной проверке диапазонов функцией timeInRange)
+            qint16 index = qint16(_weekRanges.count());
+            auto mark = [&](int first, int last)
+            {
+                for (int m = first; m < last; ++m)
+                    if (dayTable[m] < 0)
+                        dayTable[m] = index;
+            };
+            if (begin <= end)
+            {
+                mark(begin, end);
+            }
+            else // begin > end
+            {
+                mark(begin, 24*60);
+                mark(0, end);
+            }
+            _weekRanges.append(time);
+
+            if (begin == end)
+                continue;
+
+            int dayMinute = (dayOfWeek - 1) * 24*60;
+            if (!time.begin.isNull())
+                _transitions.append({dayMinute + begin, true, time});
+
+            if (!time.end.isNull())
+                _transitions.append({dayMinute + end, false, time});
+        }
+    }
+
+    // Для одной минуты окончание ограничения предшествует началу следующего
+    std::stable_sort(_transitions.begin(), _transitions.end(),
+                     [](const Transition& t1, const Transition& t2)
+    {
+        if (t1.minute != t2.minute)
+            return t1.minute < t2.minute;
+        return int(t1.begin) < int(t2.begin);
+    });
+}
+
+qint64 TriggerTimeLimit::nextTransition(qint64 time) const
+{
+    if (_transitions.isEmpty())
+        return -1;
+
+    int minute = minuteOfWeek(time, utc);
+
+    // UTC-время начала текущей недели
+    qint64 weekBegin = time - (time + utc * 60*60) % 60 - qint64(minute) * 60;
+
+    auto it = std::upper_bound(_transitions.constBegin(), _transitions.constEnd(),
+                               minute, [](int m, const Transition& t)
+                               {return m < t.minute;});
+    if (it != _transitions.constEnd())
+        return weekBegin + qint64(it->minute) * 60;
+
+    return weekBegin + qint64(MinutesPerWeek + _transitions.first().minute) * 60;
+}
+
+QVector<TriggerTimeLimit::Transition> TriggerTimeLimit::transitions(qint64 time) const
+{
+    QVector<Transition> result;
+    int minute = minuteOfWeek(time, utc);
+    for (const Transition& t : _transitions)
+        if (t.minute == minute)
+            result.append(t);
+    return result;
+}
+
+int TriggerTimeLimit::minuteOfWeek(qint64 time, int utc)
+{
+    // 1 января 1970 года - четверг (третий день от понедельника)
+    qint64 minutes = (time + utc * 60*60) / 60 + 3 * 24*60;
+    return int(minutes % MinutesPerWeek);
+}
+
+const TriggerTimeLimit::TimeRange* TriggerTimeLimit::weekRange(int minute) const
+{
+    if (_weekTable.isEmpty())
+        return nullptr;
+
+    qint16 index = _weekTable[minute];
+    return (index >= 0) ? &_weekRanges[index] : nullptr;
+}
+
 bool TriggerBlackUser::isActive(const Update& update, GroupChat* chat,
                                 const Text& text_) const
 {
@@ -868,6 +1163,7 @@ Trigger::Ptr createTrigger(const YAML::Node& ytrigger, Trigger::List& triggers)
         && type != "link_disable"
         && type != "word"
         && type != "regexp"
+        && type != "fuzzy"
         && type != "timelimit"
         && type != "blackuser"
         && type != "emptytext"
@@ -875,8 +1171,8 @@ Trigger::Ptr createTrigger(const YAML::Node& ytrigger, Trigger::List& triggers)
     {
         throw trigger_logic_error(
             "In a 'trigger' node a field 'type' can take one of the following "
-            "values: link_enable, link_disable/link, word, regexp, timelimit, "
-            "blackuser, emptytext, big_id. "
+            "values: link_enable, link_disable/link, word, regexp, fuzzy, "
+            "timelimit, blackuser, emptytext, big_id. "
             "Current value: " + type.toStdString());
     }
 
@@ -984,6 +1280,23 @@ Trigger::Ptr createTrigger(const YAML::Node& ytrigger, Trigger::List& triggers)
             regexpListO->append(QString::fromStdString(yregexp.as<string>()));
     }
 
+    optional<QStringList> templateListO;
+    if (ytrigger["template_list"].IsDefined())
+    {
+        templateListO = QStringList();
+        checkFiedType(ytrigger, "template_list", YAML::NodeType::Sequence);
+        const YAML::Node& ytemplate_list = ytrigger["template_list"];
+        for (const YAML::Node& ytemplate : ytemplate_list)
+            templateListO->append(QString::fromStdString(ytemplate.as<string>()));
+    }
+
+    optional<int> thresholdO;
+    if (ytrigger["threshold"].IsDefined())
+    {
+        checkFiedType(ytrigger, "threshold", YAML::NodeType::Scalar);
+        thresholdO = qBound(1, ytrigger["threshold"].as<int>(), 100);
+    }
+
     optional<bool> caseInsensitiveO;
     if (ytrigger["case_insensitive"].IsDefined())
     {
@@ -1381,6 +1694,21 @@ Trigger::Ptr createTrigger(const YAML::Node& ytrigger, Trigger::List& triggers)
         }
         trigger = triggerRegexp;
     }
+    else if (type == "fuzzy")
+    {
+        TriggerFuzzy::Ptr triggerFuzzy {new TriggerFuzzy};
+
+        if (TriggerFuzzy* t = dynamic_cast<TriggerFuzzy*>(baseTrigger))
+            triggerFuzzy->assign(*t);
+
+        assignValue(triggerFuzzy->threshold, thresholdO);
+        if (templateListO)
+        {
+            triggerFuzzy->templateList = templateListO.value();
+            triggerFuzzy->updateIndex();
+        }
+        trigger = triggerFuzzy;
+    }
     else if (type == "timelimit")
     {
         TriggerTimeLimit::Ptr triggerTimeLmt {new TriggerTimeLimit};
@@ -1396,6 +1724,8 @@ Trigger::Ptr createTrigger(const YAML::Node& ytrigger, Trigger::List& triggers)
         assignValue(triggerTimeLmt->hideMessageBegin, hideMsgBeginO);
         assignValue(triggerTimeLmt->hideMessageEnd, hideMsgEndO);
 
+        triggerTimeLmt->updateWeekTable();
+
         trigger = triggerTimeLmt;
     }
     else if (type == "blackuser")
@@ -1431,6 +1761,7 @@ Trigger::Ptr createTrigger(const YAML::Node& ytrigger, Trigger::List& triggers)
 
     if (trigger)
     {
+        trigger->updateMatchHash();
         trigger->name = name;
         trigger->type = type;
 
@@ -1449,10 +1780,69 @@ Trigger::Ptr createTrigger(const YAML::Node& ytrigger, Trigger::List& triggers)
     return trigger;
 }
 
-bool loadTriggers(Trigger::List& triggers, const YamlConfig& config)
+QByteArray yamlNodeHash(const YAML::Node& ynode)
+{
+    YAML::Emitter emitter;
+    emitter << ynode;
+    return QCryptographicHash::hash(QByteArray(emitter.c_str(), int(emitter.size())),
+                                    QCryptographicHash::Sha1);
+}
+
+void parallelFor(int count, const std::function<void (int)>& func)
+{
+    int threadCount = qMin(count, QThread::idealThreadCount());
+    if (threadCount <= 1)
+    {
+        for (int i = 0; i < count; ++i)
+            func(i);
+        return;
+    }
+
+    // Каждый поток пула забирает очередной индекс из общего счетчика
+    struct Task : public QRunnable
+    {
+        Task(const std::function<void (int)>& func, atomic_int& next, int count)
+            : func(func), next(next), count(count)
+        {}
+        void run() override
+        {
+            for (int i = next++; i < count; i = next++)
+                func(i);
+        }
+        const std::function<void (int)>& func;
+        atomic_int& next;
+        const int count;
+    };
+
+    atomic_int next = {0};
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+    for (int i = 0; i < threadCount; ++i)
+        pool.start(new Task(func, next, count));
+
+    pool.waitForDone();
+}
+
+bool loadTriggers(Trigger::List& triggers, const YamlConfig& config,
+                  Trigger::List* prevTriggers, LoadStat* stat)
 {
     auto locker {config.locker()}; (void) locker;
 
+    QHash<QString, Trigger*> prevTriggersMap;
+    if (prevTriggers)
+        for (Trigger* t : *prevTriggers)
+            prevTriggersMap.insert(t->name, t);
+
+    // Описание триггера для этапа создания
+    struct Entry
+    {
+        YAML::Node ytrigger;
+        QByteArray yamlHash;
+        int level = {0};   // Уровень наследования (0 - нет базового триггера)
+        Trigger::Ptr trigger;
+        std::exception_ptr error;
+    };
+
     bool result = false;
     try
     {
@@ -1463,11 +1853,69 @@ bool loadTriggers(Trigger::List& triggers, const YamlConfig& config)
         if (!ytriggers.IsSequence())
             throw std::logic_error("'triggers' node must have sequence type");
 
+        // Первый проход (последовательный): вычисление хешей, поиск неизмененных
+        // триггеров и определение уровня наследования. Базовый триггер должен
+        // быть описан в конфигурации раньше производного
+        QVector<Entry> entries;
+        QHash<QString, int> entryIndexes;
+        int maxLevel = 0;
+
         for (const YAML::Node& ytrigger : ytriggers)
             try
             {
-                if (Trigger::Ptr t = createTrigger(ytrigger, triggers))
-                    triggers.add(t.detach());
+                // Хеш производного триггера включает хеш базового, так как
+                // изменение базового триггера меняет и производный
+                QCryptographicHash hash {QCryptographicHash::Sha1};
+                hash.addData(yamlNodeHash(ytrigger));
+
+                QString name;
+                if (ytrigger["name"].IsScalar())
+                    name = QString::fromStdString(ytrigger["name"].as<string>());
+
+                // Группы и производные триггеры ссылаются на триггер по имени,
+                // поэтому имя должно быть уникальным
+                if (entryIndexes.contains(name))
+                {
+                    QString err = "Trigger name '%1' is duplicated"
+                                  ". See parameter 'name'";
+                    err = err.arg(name);
+                    throw trigger_logic_error(err.toStdString());
+                }
+
+                Entry entry;
+                if (ytrigger["base"].IsScalar())
+                {
+                    QString base = QString::fromStdString(ytrigger["base"].as<string>());
+                    int baseIndex = entryIndexes.value(base, -1);
+                    if (baseIndex < 0)
+                    {
+                        QString err = "Base trigger '%1' not found for trigger '%2'"
+                                      ". See parameter 'base'";
+                        err = err.arg(base).arg(name);
+                        throw trigger_logic_error(err.toStdString());
+                    }
+                    hash.addData(entries[baseIndex].yamlHash);
+                    entry.level = entries[baseIndex].level + 1;
+                }
+                entry.yamlHash = hash.result();
+
+                Trigger* prevTrigger = prevTriggersMap.value(name);
+                if (prevTrigger && (prevTrigger->yamlHash == entry.yamlHash))
+                {
+                    entry.trigger = Trigger::Ptr(prevTrigger);
+                    entry.level = -1;
+                    if (stat)
+                        ++stat->reused;
+                }
+                else
+                {
+                    // Копия узла нужна для независимого чтения YAML из потоков пула
+                    entry.ytrigger = YAML::Clone(ytrigger);
+                    maxLevel = qMax(maxLevel, entry.level);
+                }
+
+                entryIndexes.insert(name, entries.count());
+                entries.append(entry);
             }
             catch (trigger_logic_error& e)
             {
@@ -1476,6 +1924,59 @@ bool loadTriggers(Trigger::List& triggers, const YamlConfig& config)
                 ++globalConfigParceErrors;
             }
 
+        // Второй проход: триггеры одного уровня наследования  не  зависят  друг
+        // от друга и создаются параллельно. Уровни обрабатываются по порядку,
+        // поэтому к моменту создания производного триггера базовый уже готов
+        for (int level = 0; level <= maxLevel; ++level)
+        {
+            // Уже созданные триггеры, в них выполняется поиск базовых
+            Trigger::List ready;
+            for (Entry& entry : entries)
+                if (!entry.trigger.empty())
+                {
+                    entry.trigger->add_ref();
+                    ready.add(entry.trigger.get());
+                }
+
+            QVector<int> indexes;
+            for (int i = 0; i < entries.count(); ++i)
+                if (entries[i].level == level)
+                    indexes.append(i);
+
+            parallelFor(indexes.count(), [&](int i)
+            {
+                Entry& entry = entries[indexes[i]];
+                try
+                {
+                    entry.trigger = createTrigger(entry.ytrigger, ready);
+                    if (!entry.trigger.empty())
+                        entry.trigger->yamlHash = entry.yamlHash;
+                }
+                catch (trigger_logic_error& e)
+                {
+                    log_error_m << "Trigger configure error. Detail: " << e.what()
+                                << ". Config file: " << config.filePath();
+                    ++globalConfigParceErrors;
+                }
+                catch (...)
+                {
+                    entry.error = std::current_exception();
+                }
+            });
+
+            for (int index : indexes)
+                if (entries[index].error)
+                    std::rethrow_exception(entries[index].error);
+        }
+
+        for (Entry& entry : entries)
+            if (!entry.trigger.empty())
+            {
+                triggers.add(entry.trigger.detach());
+                if (stat && (entry.level >= 0))
+                    ++stat->rebuilt;
+            }
+
         result = true;
     }
     catch (YAML::ParserException& e)
@@ -1604,6 +2105,18 @@ void printTriggers(Trigger::List& triggers)
                 logLine << nextComma() << "'" << re.pattern() << "'";
             logLine << "]";
         }
+        else if (TriggerFuzzy* triggerFuzzy = dynamic_cast<TriggerFuzzy*>(trigger))
+        {
+            logLine << "; type: fuzzy"
+                    << "; active: " << triggerFuzzy->active
+                    << "; threshold: " << triggerFuzzy->threshold;
+
+            nextCommaVal = false;
+            logLine << "; template_list: [";
+            for (const QString& item : triggerFuzzy->templateList)
+                logLine << nextComma() << "'" << item << "'";
+            logLine << "]";
+        }
         else if (TriggerTimeLimit* triggerTimeLmt = dynamic_cast<TriggerTimeLimit*>(trigger))
         {
             logLine << "; type: timelimit"
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "fuzzy_index.h"
 #include "commands/tele_data.h"
 
 #include "shared/list.h"
@@ -11,6 +12,8 @@
 
 #include <QtCore>
 #include <QRegularExpression>
+#include <functional>
+#include <memory>
 
 namespace tbot {
 
@@ -81,6 +84,17 @@ struct Trigger : public clife_base
     // можно заблокировать сразу
     bool immediatelyBan = {false};
 
+    // Хеш YAML-описания триггера (с учетом базового триггера). Используется
+    // для повторного использования триггера при перезагрузке конфигурации
+    QByteArray yamlHash;
+
+    // Хеш структур, используемых для сопоставления текста (список слов, регу-
+    // лярные выражения и их опции). Триггеры с одинаковым  хешем  дают  одина-
+    // ковый результат на одном и том же тексте, что позволяет производному
+    // триггеру не выполнять повторно проверку, уже выполненную базовым.
+    // Пустое значение - результат сопоставления не переиспользуется
+    QByteArray matchHash;
+
     // Содержит текстовую информацию о причине активации триггера, используется
     // для объяснения причины удаления телеграм-сообщения
     static thread_local QString activationReasonMessage;
@@ -89,6 +103,13 @@ struct Trigger : public clife_base
     // Параметр Text содержит текстовое сообщение с удаленными линками
     virtual bool isActive(const tbot::Update&, GroupChat*, const Text&) const = 0;
 
+    // Пересчитывает значение matchHash
+    virtual void updateMatchHash() {}
+
+    // Сбрасывает результаты сопоставления, сохраненные в текущем потоке.
+    // Вызывается перед проверкой триггерами очередного сообщения
+    static void clearMatchResults();
+
     struct Find
     {
         int operator() (const QString* name, const Trigger* item2) const
@@ -101,6 +122,19 @@ protected:
     DISABLE_DEFAULT_COPY(Trigger)
 
     void assign(const Trigger&);
+
+    // Возвращает TRUE если для текущего текста уже есть результат сопоставле-
+    // ния триггера с таким же matchHash, результат записывается в active
+    bool findMatchResult(const tbot::Update&, GroupChat*, bool& active) const;
+    void saveMatchResult(bool active) const;
+
+private:
+    struct MatchResult
+    {
+        bool active = {false};
+        QString reasonMessage;
+    };
+    static thread_local QHash<QByteArray, MatchResult> _matchResults;
 };
 
 struct TriggerLinkBase : public Trigger
@@ -159,8 +193,12 @@ struct TriggerWord : public Trigger
     QStringList wordList;
 
     bool isActive(const tbot::Update&, GroupChat*, const Text&) const override;
+    void updateMatchHash() override;
 
     void assign(const TriggerWord&);
+
+private:
+    bool matchText(const tbot::Update&, GroupChat*, const Text&) const;
 };
 
 struct TriggerRegexp : public Trigger
@@ -195,8 +233,52 @@ struct TriggerRegexp : public Trigger
     QList<QRegularExpression> regexpList;
 
     bool isActive(const tbot::Update&, GroupChat*, const Text&) const override;
+    void updateMatchHash() override;
 
     void assign(const TriggerRegexp&);
+
+private:
+    bool matchText(const tbot::Update&, GroupChat*, const Text&) const;
+};
+
+struct TriggerFuzzy : public Trigger
+{
+    typedef clife_ptr<TriggerFuzzy> Ptr;
+
+    TriggerFuzzy() = default;
+    DISABLE_DEFAULT_COPY(TriggerFuzzy)
+
+    // Порог схожести текста сообщения с шаблоном (в процентах). Триггер
+    // сработает если оценка схожести превысит пороговое значение
+    int threshold = {90};
+
+    // Список шаблонов спам-сообщений
+    QStringList templateList;
+
+    bool isActive(const tbot::Update&, GroupChat*, const Text&) const override;
+    void updateMatchHash() override;
+
+    void assign(const TriggerFuzzy&);
+
+    // Строит индекс шаблонов, вызывается после изменения templateList
+    void updateIndex();
+
+    // Использует индекс шаблонов триггера other (с таким же списком шаблонов)
+    void shareIndex(const TriggerFuzzy& other);
+
+private:
+    bool matchText(const tbot::Update&, GroupChat*, const Text&) const;
+
+private:
+    // Шаблоны и индекс для поиска похожих текстов. После построения индекс
+    // не изменяется, поэтому используется совместно базовым и производными
+    // триггерами
+    struct Templates
+    {
+        data::FuzzyText::List list;
+        FuzzyIndex index;
+    };
+    std::shared_ptr<const Templates> _templates;
 };
 
 struct TriggerTimeLimit : public Trigger
@@ -238,6 +320,44 @@ struct TriggerTimeLimit : public Trigger
 
     void assign(const TriggerTimeLimit&);
     void timesRangeOfDay(int dayOfWeek, Times& times) const;
+
+    // Строит недельную таблицу ограничений по параметру week. Функция  должна
+    // вызываться после каждого изменения параметра week
+    void updateWeekTable();
+
+    // Возвращает номер минуты недели (0 - понедельник 00:00) для UTC-времени
+    // time (в секундах) с учетом часового пояса utc
+    static int minuteOfWeek(qint64 time, int utc);
+
+    // Возвращает диапазон ограничения, действующий в минуту недели minute,
+    // или nullptr если ограничение в эту минуту не действует
+    const TimeRange* weekRange(int minute) const;
+
+    static constexpr int MinutesPerWeek = 7 * 24 * 60;
+
+    // Переход (начало или окончание ограничения) в недельном расписании
+    struct Transition
+    {
+        int minute = {0};    // Минута недели
+        bool begin = {true}; // TRUE - начало ограничения, FALSE - окончание
+        TimeRange range;
+    };
+
+    // Возвращает UTC-время (в секундах) ближайшего после time перехода,
+    // или -1 если в расписании нет переходов
+    qint64 nextTransition(qint64 time) const;
+
+    // Возвращает переходы, приходящиеся на минуту UTC-времени time
+    QVector<Transition> transitions(qint64 time) const;
+
+private:
+    // Для каждой минуты недели содержит индекс диапазона в _weekRanges,
+    // -1 - ограничение не действует
+    QVector<qint16> _weekTable;
+    QVector<TimeRange> _weekRanges;
+
+    // Переходы, упорядоченные по минуте недели
+    QVector<Transition> _transitions;
 };
 
 struct TriggerBlackUser : public Trigger
@@ -326,7 +446,28 @@ struct TriggerBigId : public Trigger
 
 const char* yamlTypeName(YAML::NodeType::value type);
 
-bool loadTriggers(Trigger::List&, const YamlConfig&);
+// Возвращает хеш содержимого YAML-узла
+QByteArray yamlNodeHash(const YAML::Node&);
+
+// Статистика загрузки конфигурации
+struct LoadStat
+{
+    // Количество элементов, повторно использованных из предыдущей конфигурации
+    int reused = {0};
+
+    // Количество заново созданных элементов
+    int rebuilt = {0};
+};
+
+// Выполняет func(index) для index в диапазоне [0, count) в пуле потоков.
+// Используется для параллельного создания триггеров и групп при  загрузке
+// конфигурации. Функция возвращает управление после обработки всех индексов
+void parallelFor(int count, const std::function<void (int)>& func);
+
+// Если задан список prevTriggers, то триггеры  с  неизмененным  YAML-описанием
+// не создаются заново, а берутся из этого списка
+bool loadTriggers(Trigger::List&, const YamlConfig&,
+                  Trigger::List* prevTriggers = nullptr, LoadStat* = nullptr);
 void printTriggers(Trigger::List&);
 
 Trigger::List triggers(Trigger::List* = nullptr);
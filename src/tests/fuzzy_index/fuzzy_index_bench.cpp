@@ -0,0 +1,94 @@
+#include "fuzzy_index.h"
+#include "tests/test_texts.h"
+
+#include <QtTest>
+#include <random>
+
+using namespace std;
+using namespace tbot;
+
+/**
+  Сравнение производительности поиска похожих текстов: полный перебор с
+  вычислением оценки rapidfuzz без кеша и поиск через LSH-индекс с пакетным
+  сравнением кандидатов (SIMD для коротких текстов)
+*/
+class FuzzyIndexBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void similarity_data();
+    void similarity();
+
+private:
+    static constexpr double Cutoff = 90;
+};
+
+void FuzzyIndexBench::similarity_data()
+{
+    QTest::addColumn<bool>("batch");
+    QTest::addColumn<int>("words");
+
+    QTest::newRow("loop, short texts")  << false << 6;
+    QTest::newRow("batch, short texts") << true  << 6;
+    QTest::newRow("loop, long texts")   << false << 30;
+    QTest::newRow("batch, long texts")  << true  << 30;
+}
+
+void FuzzyIndexBench::similarity()
+{
+    QFETCH(bool, batch);
+    QFETCH(int, words);
+
+    mt19937 generator {20241019};
+
+    data::FuzzyText::List texts;
+    FuzzyIndex index;
+    for (int i = 0; i < 20000; ++i)
+    {
+        data::FuzzyText* ft = new data::FuzzyText;
+        ft->add_ref();
+        ft->chatId = -100;
+        ft->messageId = i + 1;
+        ft->text = test::randomText(generator, words);
+        texts.add(ft);
+
+        index.add(ft, FuzzyIndex::textKeys(ft->text));
+    }
+
+    QVector<u32string> queries;
+    for (int i = 0; i < texts.count(); i += 200)
+    {
+        const QString query = test::mutateText(generator, texts.item(i)->text, 0.03);
+        queries.append(query.toLower().toStdU32String());
+    }
+
+    int found = 0;
+    QBENCHMARK
+    {
+        found = 0;
+        for (const u32string& query32 : queries)
+        {
+            if (batch)
+            {
+                QVector<data::FuzzyText*> candidates =
+                    index.candidates(FuzzyIndex::textBands(query32));
+                found += index.similar(query32, candidates, Cutoff).count();
+            }
+            else
+            {
+                for (data::FuzzyText* ft : texts)
+                {
+                    const u32string text32 = ft->text.toLower().toStdU32String();
+                    if (rapidfuzz::fuzz::ratio(text32, query32, Cutoff) > Cutoff)
+                        ++found;
+                }
+            }
+        }
+    }
+    QVERIFY(found >= queries.count());
+}
+
+QTEST_APPLESS_MAIN(FuzzyIndexBench)
+
+#include "fuzzy_index_bench.moc"
@@ -0,0 +1,117 @@
+#include "fuzzy_index.h"
+#include "tests/test_texts.h"
+
+#include <QtTest>
+#include <random>
+
+using namespace std;
+using namespace tbot;
+
+class FuzzyIndexTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void cleanup();
+
+    void exactCopies();
+    void lshRecall();
+
+private:
+    data::FuzzyText* addText(FuzzyIndex&, qint32 messageId, const QString& text);
+
+    data::FuzzyText::List _texts;
+};
+
+void FuzzyIndexTest::cleanup()
+{
+    _texts.clear();
+}
+
+data::FuzzyText* FuzzyIndexTest::addText(FuzzyIndex& index, qint32 messageId,
+                                         const QString& text)
+{
+    data::FuzzyText* ft = new data::FuzzyText;
+    ft->add_ref();
+    _texts.add(ft);
+
+    ft->chatId = -100;
+    ft->messageId = messageId;
+    ft->text = text;
+
+    index.add(ft, FuzzyIndex::textKeys(ft->text));
+    return ft;
+}
+
+void FuzzyIndexTest::exactCopies()
+{
+    FuzzyIndex index;
+    data::FuzzyText* ft = addText(index, 1, u8"Заработок  от 1000$ в день https://spam.example/x");
+    addText(index, 2, u8"Совсем другой текст сообщения");
+
+    // Регистр, пробелы и ссылки не влияют на хеш нормализованного текста
+    QVector<data::FuzzyText*> exact =
+        index.exact(FuzzyIndex::textHash(u8"ЗАРАБОТОК от 1000$ в день"));
+    QCOMPARE(exact.count(), 1);
+    QCOMPARE(exact[0], ft);
+
+    index.remove(ft);
+    QVERIFY(index.exact(FuzzyIndex::textHash(ft->text)).isEmpty());
+    QCOMPARE(index.count(), 1);
+}
+
+void FuzzyIndexTest::lshRecall()
+{
+    // Полнота поиска по LSH-индексу сверяется с полным перебором: каждый
+    // текст, оценка схожести которого с запросом превышает 90, должен
+    // попасть в кандидаты
+    const double cutoff = 90;
+
+    mt19937 generator {20241019};
+    uniform_int_distribution<> words {8, 30};
+
+    FuzzyIndex index;
+    QVector<QString> texts;
+    for (int i = 0; i < 1000; ++i)
+    {
+        texts.append(test::randomText(generator, words(generator)));
+        addText(index, i + 1, texts.last());
+    }
+
+    int expected = 0;
+    int found = 0;
+    for (int i = 0; i < texts.count(); i += 5)
+    {
+        const QString query = test::mutateText(generator, texts[i], 0.03);
+        const u32string query32 = query.toLower().toStdU32String();
+
+        QVector<data::FuzzyText*> candidates =
+            index.candidates(FuzzyIndex::textBands(query32));
+
+        for (data::FuzzyText* ft : _texts)
+        {
+            const u32string text32 = ft->text.toLower().toStdU32String();
+            if (rapidfuzz::fuzz::ratio(text32, query32, cutoff) <= cutoff)
+                continue;
+
+            ++expected;
+            if (candidates.contains(ft))
+                ++found;
+        }
+
+        // Оценка схожести кандидатов через индекс совпадает с полным перебором
+        for (data::FuzzyText* ft : index.similar(query32, candidates, cutoff))
+            QVERIFY(rapidfuzz::fuzz::ratio(ft->text.toLower().toStdU32String(),
+                                           query32, cutoff) > cutoff);
+    }
+
+    QVERIFY(expected >= texts.count() / 5);
+
+    const double recall = double(found) / expected;
+    qInfo() << "LSH recall:" << recall << QString("(%1/%2)").arg(found).arg(expected);
+    QVERIFY2(recall >= 0.98, qPrintable(QString("LSH recall %1").arg(recall)));
+}
+
+QTEST_APPLESS_MAIN(FuzzyIndexTest)
+
+#include "fuzzy_index_test.moc"
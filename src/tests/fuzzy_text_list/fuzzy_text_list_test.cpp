@@ -0,0 +1,295 @@
+#include "functions.h"
+#include "tests/test_texts.h"
+
+#include <QtTest>
+#include <atomic>
+#include <ctime>
+#include <random>
+#include <thread>
+
+using namespace std;
+using namespace tbot;
+
+/**
+  Проверка согласованности поиска похожих текстов: результаты поиска не
+  должны зависеть от того, находится текст в буфере записи или в сегменте,
+  а также от создания и объединения сегментов, повторного добавления сооб-
+  щения (редактирование), удаления устаревших текстов и загрузки списка
+*/
+class FuzzyTextListTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void lookupsAcrossMerge();
+    void lookupsAcrossReadd();
+    void lookupsAcrossRemoveByTime();
+    void lookupsAcrossListSwap();
+    void concurrentAddLookup();
+
+private:
+    // Идентификатор сообщения для поисковых запросов, не совпадает
+    // с идентификаторами текстов в списке
+    static constexpr qint32 QueryMessageId = 1000000;
+
+    // Размер буфера записи FuzzyTextList
+    static constexpr int BufferSize = 256;
+
+    static data::FuzzyText::Ptr makeText(qint32 messageId, const QString& text,
+                                         qint64 timeLife = 3600);
+
+    // Добавляет count посторонних текстов, переполнение буфера записи
+    // переносит ранее добавленные тексты в сегмент
+    static void addFillers(FuzzyTextList&, mt19937&, int count);
+
+    // Идентификаторы сообщений, найденных для текста text (по возрастанию)
+    static QVector<qint32> lookup(const FuzzyTextList&, const QString& text);
+};
+
+data::FuzzyText::Ptr FuzzyTextListTest::makeText(qint32 messageId, const QString& text,
+                                                 qint64 timeLife)
+{
+    tbot::User::Ptr user = tbot::User::Ptr::create();
+    user->id = messageId % 10 + 1;
+
+    data::FuzzyText::Ptr ft = data::FuzzyText::Ptr::create();
+    ft->chatId = -100;
+    ft->messageId = messageId;
+    ft->user = user;
+    ft->text = text;
+    ft->time = std::time(nullptr);
+    ft->timeLife = ft->time + timeLife;
+    return ft;
+}
+
+void FuzzyTextListTest::addFillers(FuzzyTextList& list, mt19937& generator, int count)
+{
+    static qint32 messageId = 500000;
+    for (int i = 0; i < count; ++i)
+        list.add(makeText(++messageId, test::randomText(generator, 20)));
+}
+
+QVector<qint32> FuzzyTextListTest::lookup(const FuzzyTextList& list, const QString& text)
+{
+    QVector<qint32> result;
+    for (data::FuzzyText* ft : list.textSimilarity(makeText(QueryMessageId, text)))
+        result.append(ft->messageId);
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+void FuzzyTextListTest::lookupsAcrossMerge()
+{
+    mt19937 generator {20241019};
+    uniform_int_distribution<> words {8, 30};
+
+    // Первые тексты остаются в буфере записи (меньше BufferSize)
+    FuzzyTextList list;
+    QVector<QString> texts;
+    for (int i = 0; i < 100; ++i)
+    {
+        texts.append(test::randomText(generator, words(generator)));
+        list.add(makeText(i + 1, texts.last()));
+    }
+
+    QVector<QString> queries;
+    for (int i = 0; i < texts.count(); i += 2)
+        queries.append(test::mutateText(generator, texts[i], 0.03));
+
+    QVector<QVector<qint32>> before;
+    int found = 0;
+    for (const QString& query : queries)
+    {
+        before.append(lookup(list, query));
+        found += before.last().isEmpty() ? 0 : 1;
+    }
+    QVERIFY(found >= queries.count() * 9 / 10);
+
+    // Переполнение буфера: тексты переносятся в сегмент
+    addFillers(list, generator, BufferSize);
+
+    for (int i = 0; i < queries.count(); ++i)
+        QCOMPARE(lookup(list, queries[i]), before[i]);
+
+    // Количество сегментов превышает порог: сегменты объединяются
+    // в фоновом потоке
+    addFillers(list, generator, BufferSize * 10);
+    list.waitIndex();
+
+    for (int i = 0; i < queries.count(); ++i)
+        QCOMPARE(lookup(list, queries[i]), before[i]);
+}
+
+void FuzzyTextListTest::lookupsAcrossReadd()
+{
+    mt19937 generator {20241019};
+
+    const QString textA = test::randomText(generator, 20);
+    const QString textB = test::randomText(generator, 20);
+
+    FuzzyTextList list;
+    list.add(makeText(1, textA));
+    for (int i = 0; i < 10; ++i)
+        list.add(makeText(i + 2, test::randomText(generator, 20)));
+
+    const QVector<qint32> first {1};
+    QCOMPARE(lookup(list, textA), first);
+
+    // Сообщение отредактировано, пока текст находится в буфере записи
+    list.add(makeText(1, textB));
+    QVERIFY(lookup(list, textA).isEmpty());
+    QCOMPARE(lookup(list, textB), first);
+
+    addFillers(list, generator, BufferSize);
+    QVERIFY(lookup(list, textA).isEmpty());
+    QCOMPARE(lookup(list, textB), first);
+
+    // Сообщение отредактировано, когда текст уже перенесен в сегмент
+    list.add(makeText(1, textA));
+    QVERIFY(lookup(list, textB).isEmpty());
+    QCOMPARE(lookup(list, textA), first);
+
+    addFillers(list, generator, BufferSize);
+    QVERIFY(lookup(list, textB).isEmpty());
+    QCOMPARE(lookup(list, textA), first);
+
+    // Объединение сегментов исключает замененный текст из индекса
+    addFillers(list, generator, BufferSize * 10);
+    list.waitIndex();
+    QVERIFY(lookup(list, textB).isEmpty());
+    QCOMPARE(lookup(list, textA), first);
+    QCOMPARE(list.list().count(), 11 + BufferSize * 12);
+}
+
+void FuzzyTextListTest::lookupsAcrossRemoveByTime()
+{
+    mt19937 generator {20241019};
+    uniform_int_distribution<> words {8, 30};
+
+    // Каждый третий текст устарел. Часть текстов попадает в сегмент при
+    // переполнении буфера, остальные остаются в буфере записи
+    FuzzyTextList list;
+    QVector<QString> texts;
+    for (int i = 0; i < 300; ++i)
+    {
+        texts.append(test::randomText(generator, words(generator)));
+        list.add(makeText(i + 1, texts.last(), (i % 3 == 0) ? -10 : 3600));
+    }
+
+    for (int i = 0; i < texts.count(); ++i)
+        QCOMPARE(lookup(list, texts[i]), QVector<qint32> {i + 1});
+
+    list.removeByTime();
+
+    auto check = [&]()
+    {
+        for (int i = 0; i < texts.count(); ++i)
+        {
+            if (i % 3 == 0)
+                QVERIFY(lookup(list, texts[i]).isEmpty());
+            else
+                QCOMPARE(lookup(list, texts[i]), QVector<qint32> {i + 1});
+        }
+    };
+    check();
+    QCOMPARE(list.list().count(), 200);
+
+    // После объединения сегментов удаленные тексты в поиске не участвуют
+    addFillers(list, generator, BufferSize * 10);
+    list.waitIndex();
+    check();
+}
+
+void FuzzyTextListTest::lookupsAcrossListSwap()
+{
+    mt19937 generator {20241019};
+    uniform_int_distribution<> words {8, 30};
+
+    // Список, заполненный через add(), и тот же список, загруженный через
+    // listSwap() с построением индекса в фоновом потоке
+    FuzzyTextList added;
+    data::FuzzyText::List loaded;
+    QVector<QString> texts;
+    for (int i = 0; i < 300; ++i)
+    {
+        texts.append(test::randomText(generator, words(generator)));
+        added.add(makeText(i + 1, texts.last()));
+
+        data::FuzzyText::Ptr ft = makeText(i + 1, texts.last());
+        ft->add_ref();
+        loaded.add(ft.get());
+    }
+
+    FuzzyTextList swapped;
+    swapped.listSwap(loaded);
+    swapped.waitIndex();
+
+    for (int i = 0; i < texts.count(); i += 3)
+    {
+        const QString query = test::mutateText(generator, texts[i], 0.03);
+        QCOMPARE(lookup(swapped, query), lookup(added, query));
+        QCOMPARE(lookup(swapped, texts[i]), QVector<qint32> {i + 1});
+    }
+
+    // Тексты, добавленные после загрузки, находятся вместе с загруженными
+    const QString text = test::randomText(generator, 20);
+    swapped.add(makeText(301, text));
+    swapped.add(makeText(302, text));
+    QCOMPARE(lookup(swapped, text), (QVector<qint32> {301, 302}));
+}
+
+void FuzzyTextListTest::concurrentAddLookup()
+{
+    // Поиск выполняется одновременно с добавлением текстов: текст,
+    // добавление которого завершено, должен находиться независимо от
+    // переноса буфера записи в сегмент и объединения сегментов
+    mt19937 generator {20241019};
+
+    const int count = BufferSize * 20;
+    QVector<QString> texts;
+    for (int i = 0; i < count; ++i)
+        texts.append(test::randomText(generator, 20));
+
+    FuzzyTextList list;
+    std::atomic_int added {0};
+    std::atomic_int missed {0};
+    std::atomic_bool done {false};
+
+    auto reader = [&]()
+    {
+        while (!done)
+        {
+            const int n = added;
+            if (n == 0)
+                continue;
+
+            // Последний добавленный текст находится в буфере записи или
+            // только что перенесен в сегмент
+            const int i = n - 1;
+            if (!lookup(list, texts.at(i)).contains(i + 1))
+                ++missed;
+        }
+    };
+
+    std::thread reader1 {reader};
+    std::thread reader2 {reader};
+
+    for (int i = 0; i < count; ++i)
+    {
+        list.add(makeText(i + 1, texts[i]));
+        added = i + 1;
+    }
+    done = true;
+    reader1.join();
+    reader2.join();
+    list.waitIndex();
+
+    QCOMPARE(missed.load(), 0);
+    for (int i = 0; i < count; i += 97)
+        QVERIFY(lookup(list, texts[i]).contains(i + 1));
+}
+
+QTEST_APPLESS_MAIN(FuzzyTextListTest)
+
+#include "fuzzy_text_list_test.moc"
@@ -0,0 +1,232 @@
+#include "http_client.h"
+
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+using namespace std;
+using namespace tbot;
+
+namespace tbot {
+
+// processing.cpp в бенчмарк не включается: тело запроса формируется
+// заранее, функция используется только для пустого тела
+QByteArray tgRequestBody(const QMap<QString, QVariant>& api)
+{
+    return QJsonDocument(QJsonObject::fromVariantMap(api)).toJson(QJsonDocument::Compact);
+}
+
+} // namespace tbot
+
+/**
+  Минимальный HTTP/1.1 сервер с постоянными соединениями: на каждый POST
+  запрос отвечает фиксированным JSON-ответом Телеграм. Работает одновременно
+  через Unix-сокет и через TCP на петлевом интерфейсе
+*/
+class EchoServer : public QObject
+{
+public:
+    bool listen(const QString& socketPath);
+
+    QString  socketPath() const {return _localServer.fullServerName();}
+    quint16  tcpPort() const {return _tcpServer.serverPort();}
+
+private:
+    void newConnection(QIODevice*);
+    void readyRead(QIODevice*);
+
+private:
+    QTcpServer _tcpServer;
+    QLocalServer _localServer;
+    QHash<QIODevice*, QByteArray> _buffers;
+};
+
+bool EchoServer::listen(const QString& socketPath)
+{
+    if (!_tcpServer.listen(QHostAddress::LocalHost, 0))
+        return false;
+
+    QLocalServer::removeServer(socketPath);
+    if (!_localServer.listen(socketPath))
+        return false;
+
+    connect(&_tcpServer, &QTcpServer::newConnection, this, [this]()
+    {
+        while (QTcpSocket* socket = _tcpServer.nextPendingConnection())
+        {
+            // Запросы и ответы небольшие, алгоритм Нейгла увеличивает
+            // задержку
+            socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+            newConnection(socket);
+        }
+    });
+
+    connect(&_localServer, &QLocalServer::newConnection, this, [this]()
+    {
+        while (QLocalSocket* socket = _localServer.nextPendingConnection())
+            newConnection(socket);
+    });
+    return true;
+}
+
+void EchoServer::newConnection(QIODevice* socket)
+{
+    connect(socket, &QIODevice::readyRead, this, [this, socket]()
+    {
+        readyRead(socket);
+    });
+
+    // Сокет удаляется сервером (родителем) при закрытии сервера, в буфере
+    // соединения данные больше не нужны
+    connect(socket, &QObject::destroyed, this, [this, socket]()
+    {
+        _buffers.remove(socket);
+    });
+}
+
+void EchoServer::readyRead(QIODevice* socket)
+{
+    static const QByteArray answer {"{\"ok\":true,\"result\":true}"};
+
+    QByteArray& buffer = _buffers[socket];
+    buffer.append(socket->readAll());
+
+    while (true)
+    {
+        int pos = buffer.indexOf("\r\n\r\n");
+        if (pos == -1)
+            return;
+
+        int contentLength = 0;
+        for (const QByteArray& line : buffer.left(pos).split('\n'))
+        {
+            int colon = line.indexOf(':');
+            if (colon <= 0)
+                continue;
+
+            if (line.left(colon).trimmed().toLower() == "content-length")
+                contentLength = line.mid(colon + 1).trimmed().toInt();
+        }
+
+        const int requestSize = pos + 4 + contentLength;
+        if (buffer.size() < requestSize)
+            return;
+
+        buffer.remove(0, requestSize);
+
+        QByteArray response;
+        response += "HTTP/1.1 200 OK\r\n";
+        response += "Content-Type: application/json\r\n";
+        response += "Content-Length: " + QByteArray::number(answer.size()) + "\r\n";
+        response += "Connection: keep-alive\r\n";
+        response += "\r\n";
+        response += answer;
+        socket->write(response);
+    }
+}
+
+/**
+  Сравнение времени выполнения запроса HttpClient (от отправки команды до
+  получения результата) к локальному серверу через Unix-сокет и через TCP
+  на петлевом интерфейсе. Запросы выполняются последовательно, поэтому
+  измеряется задержка одного запроса, а не пропускная способность
+*/
+class HttpClientBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void roundTrip_data();
+    void roundTrip();
+
+private:
+    // Отправляет команду и ожидает ее результат
+    static bool request(HttpClient&, QEventLoop&, const HttpReply& reply);
+
+private:
+    QTemporaryDir _dir;
+    EchoServer _server;
+};
+
+void HttpClientBench::initTestCase()
+{
+    qRegisterMetaType<tbot::HttpReply>("tbot::HttpReply");
+
+    QVERIFY(_dir.isValid());
+    QVERIFY(_server.listen(_dir.filePath("telebot_bench.sock")));
+}
+
+void HttpClientBench::cleanupTestCase()
+{
+    QLocalServer::removeServer(_server.socketPath());
+}
+
+void HttpClientBench::roundTrip_data()
+{
+    QTest::addColumn<bool>("unixSocket");
+
+    QTest::newRow("unix socket")  << true;
+    QTest::newRow("loopback tcp") << false;
+}
+
+void HttpClientBench::roundTrip()
+{
+    QFETCH(bool, unixSocket);
+
+    HttpClient::Params params;
+    params.url = QString("http://127.0.0.1:%1/bot123456:bench/").arg(_server.tcpPort());
+    params.maxInFlight = 1;
+    if (unixSocket)
+        params.unixSocket = _server.socketPath();
+
+    HttpClient client {1, params};
+
+    QEventLoop loop;
+    HttpReply reply;
+    QObject::connect(&client, &HttpClient::finished, &loop,
+                     [&loop, &reply](const tbot::HttpReply& rd)
+    {
+        reply = rd;
+        loop.quit();
+    });
+
+    client.start();
+
+    // Первый запрос устанавливает соединение и в измерение не входит
+    QVERIFY(request(client, loop, reply));
+
+    QBENCHMARK {
+        QVERIFY(request(client, loop, reply));
+    }
+
+    client.stop();
+}
+
+bool HttpClientBench::request(HttpClient& client, QEventLoop& loop, const HttpReply& reply)
+{
+    auto params = TgParams::Ptr::create();
+    params->funcName = "getMe";
+    params->body = "{}";
+
+    // Ограничение времени ожидания, чтобы бенчмарк не завис при ошибке
+    // соединения
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    QObject::connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+    timeout.start(5000);
+
+    client.send(params);
+    loop.exec();
+
+    return timeout.isActive() && reply.success
+           && reply.data == "{\"ok\":true,\"result\":true}";
+}
+
+QTEST_GUILESS_MAIN(HttpClientBench)
+
+#include "http_client_bench.moc"
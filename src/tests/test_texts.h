@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QtCore>
+#include <random>
+
+namespace tbot {
+namespace test {
+
+// Случайный текст из words слов (кириллица), генератор детерминирован,
+// поэтому результаты тестов воспроизводимы
+inline QString randomText(std::mt19937& generator, int words)
+{
+    std::uniform_int_distribution<> letter {0x0430, 0x044F}; // а-я
+    std::uniform_int_distribution<> wordLength {2, 9};
+
+    QString text;
+    for (int i = 0; i < words; ++i)
+    {
+        if (i != 0)
+            text += QChar(' ');
+
+        const int length = wordLength(generator);
+        for (int j = 0; j < length; ++j)
+            text += QChar(letter(generator));
+    }
+    return text;
+}
+
+// Копия текста, в которой доля rate символов заменена случайными буквами
+// (изменения, которые спамеры вносят в копии сообщений)
+inline QString mutateText(std::mt19937& generator, const QString& text, double rate)
+{
+    std::uniform_int_distribution<> letter {0x0430, 0x044F};
+    std::uniform_real_distribution<> chance {0.0, 1.0};
+
+    QString result = text;
+    for (int i = 0; i < result.length(); ++i)
+        if ((result[i] != QChar(' ')) && (chance(generator) < rate))
+            result[i] = QChar(letter(generator));
+    return result;
+}
+
+} // namespace test
+} // namespace tbot
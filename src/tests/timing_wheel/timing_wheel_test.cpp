@@ -0,0 +1,221 @@
+#include "timing_wheel.h"
+
+#include <QtTest>
+#include <algorithm>
+
+using namespace std;
+using namespace tbot;
+
+class TimingWheelTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void fireAcrossLevels();
+    void cancelThenFire();
+    void waitAfterCascades();
+    void saveLoad();
+
+private:
+    static TgParams::Ptr makeParams(qint64 messageId);
+
+    // Время срабатывания команды с временем отправки time: колесо
+    // срабатывает на границе шага, но не раньше заданного времени
+    static qint64 fireTime(qint64 time);
+};
+
+TgParams::Ptr TimingWheelTest::makeParams(qint64 messageId)
+{
+    auto params = TgParams::Ptr::create();
+    params->funcName = "deleteMessage";
+    params->api["chat_id"] = qint64(-100);
+    params->api["message_id"] = messageId;
+    return params;
+}
+
+qint64 TimingWheelTest::fireTime(qint64 time)
+{
+    const qint64 tick = TimingWheel::Tick;
+    return (time + tick - 1) / tick * tick;
+}
+
+void TimingWheelTest::fireAcrossLevels()
+{
+    // Времена отправки у границ уровней колеса: 64 шага (640 мсек),
+    // 64^2 шагов (40960 мсек) и 64^3 шагов (2621440 мсек)
+    const QVector<qint64> times {
+        5, 630, 639, 640, 641, 650, 1000,
+        40950, 40959, 40960, 40961, 41000, 100000,
+        2621430, 2621440, 2621441, 2700000
+    };
+
+    TimingWheel wheel;
+    wheel.advance(0);
+
+    // Команды добавляются в обратном порядке, порядок срабатывания
+    // определяется только временем отправки
+    QHash<quint64, qint64> expected;
+    for (int i = times.count() - 1; i >= 0; --i)
+        expected.insert(wheel.add(times[i], makeParams(i)), fireTime(times[i]));
+
+    QVector<qint64> fired;
+    for (qint64 now = 0; now <= times.last() + TimingWheel::Tick; now += TimingWheel::Tick)
+    {
+        // Команды, сработавшие на одном шаге, упорядочиваются по времени
+        QVector<qint64> tickFired;
+        for (const TimingWheel::Item& item : wheel.advance(now))
+        {
+            QCOMPARE(now, expected.value(item.id));
+            tickFired.append(item.time);
+        }
+        std::sort(tickFired.begin(), tickFired.end());
+        fired += tickFired;
+    }
+
+    QCOMPARE(fired, times);
+    QCOMPARE(wheel.count(), 0);
+    QCOMPARE(wheel.wait(times.last()), qint64(-1));
+}
+
+void TimingWheelTest::cancelThenFire()
+{
+    TimingWheel wheel;
+    wheel.advance(0);
+
+    // Отмена команд нижнего уровня и команды, которая будет перенесена
+    // с верхнего уровня
+    const quint64 id1 = wheel.add(500, makeParams(1));
+    const quint64 id2 = wheel.add(500, makeParams(2));
+    const quint64 id3 = wheel.add(50000, makeParams(3));
+    const quint64 id4 = wheel.add(50000, makeParams(4));
+
+    QVERIFY(wheel.cancel(id1));
+    QVERIFY(!wheel.cancel(id1));
+    QVERIFY(wheel.cancel(id3));
+    QVERIFY(wheel.find(id1) == nullptr);
+    QVERIFY(wheel.find(id2) != nullptr);
+    QCOMPARE(wheel.count(), 2);
+
+    QVector<TimingWheel::Item> fired = wheel.advance(500);
+    QCOMPARE(fired.count(), 1);
+    QCOMPARE(fired[0].id, id2);
+    QVERIFY(!wheel.cancel(id2));
+
+    fired = wheel.advance(50000);
+    QCOMPARE(fired.count(), 1);
+    QCOMPARE(fired[0].id, id4);
+
+    // В ячейках остались только идентификаторы отмененных команд
+    QCOMPARE(wheel.count(), 0);
+    QCOMPARE(wheel.wait(50000), qint64(-1));
+    QVERIFY(wheel.advance(100000).isEmpty());
+
+    // Команда, время отправки которой уже наступило, отменяется до
+    // срабатывания
+    const quint64 id5 = wheel.add(90000, makeParams(5));
+    QVERIFY(wheel.cancel(id5));
+    QVERIFY(wheel.advance(100010).isEmpty());
+}
+
+void TimingWheelTest::waitAfterCascades()
+{
+    // Колесо просыпается только по значению wait(): команды верхних
+    // уровней должны сработать точно в срок после переносов на нижние
+    // уровни, количество пробуждений ограничено количеством уровней
+    const QVector<qint64> times {700, 45000, 100000, 3000000};
+
+    TimingWheel wheel;
+    wheel.advance(0);
+    for (int i = 0; i < times.count(); ++i)
+        wheel.add(times[i], makeParams(i));
+
+    qint64 now = 0;
+    int wakeups = 0;
+    QVector<qint64> fired;
+    while (wheel.count() != 0)
+    {
+        const qint64 wait = wheel.wait(now);
+        QVERIFY(wait >= 0);
+
+        // Колесо не должно проспать ближайшую команду
+        now += wait;
+        QVERIFY(now <= fireTime(times[fired.count()]));
+
+        for (const TimingWheel::Item& item : wheel.advance(now))
+        {
+            QCOMPARE(now, fireTime(item.time));
+            fired.append(item.time);
+        }
+        QVERIFY(++wakeups <= times.count() * 6);
+    }
+    QCOMPARE(fired, times);
+    QCOMPARE(wheel.wait(now), qint64(-1));
+}
+
+void TimingWheelTest::saveLoad()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath("timing_wheel.dat");
+
+    TimingWheel wheel;
+    wheel.advance(1000);
+
+    TgParams::Ptr params = makeParams(1);
+    params->messageDel = 30;
+
+    wheel.add(1000 + 5000, params, true);
+    wheel.add(1000 + 5000, makeParams(2));
+    wheel.add(1000 + 200000, makeParams(3), true);
+    QVERIFY(wheel.changed());
+
+    QVERIFY(wheel.save(fileName, 1000));
+    QVERIFY(!wheel.changed());
+
+    // Загрузка с другим значением монотонных часов: время отправки
+    // пересчитывается относительно текущего времени
+    TimingWheel loaded;
+    QVERIFY(loaded.load(fileName, 50000));
+    QVERIFY(!loaded.changed());
+    QCOMPARE(loaded.count(), 2);
+
+    QVector<TimingWheel::Item> items = loaded.items(true);
+    std::sort(items.begin(), items.end(),
+              [](const TimingWheel::Item& i1, const TimingWheel::Item& i2)
+              {return i1.time < i2.time;});
+
+    QVERIFY(lst::inRange(items[0].time, qint64(50000 + 4000), qint64(50000 + 5000)));
+    QVERIFY(lst::inRange(items[1].time, qint64(50000 + 199000), qint64(50000 + 200000)));
+    QVERIFY(items[0].persistent);
+    QCOMPARE(items[0].params->funcName, params->funcName);
+    QCOMPARE(items[0].params->api, params->api);
+    QCOMPARE(items[0].params->messageDel, 30);
+
+    QVector<TimingWheel::Item> fired = loaded.advance(50000 + 5000);
+    QCOMPARE(fired.count(), 1);
+    QVERIFY(loaded.changed());
+
+    // Команды, время отправки которых наступило во время простоя программы,
+    // срабатывают при первом вызове advance()
+    TimingWheel overdue;
+    overdue.add(-1000, makeParams(4), true);
+    QVERIFY(overdue.save(fileName, 0));
+
+    TimingWheel restarted;
+    QVERIFY(restarted.load(fileName, 70000));
+    QCOMPARE(restarted.advance(70000).count(), 1);
+
+    // Файл неизвестного формата не загружается
+    QFile file {fileName};
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("unknown format");
+    file.close();
+
+    TimingWheel broken;
+    QVERIFY(!broken.load(fileName, 0));
+    QCOMPARE(broken.count(), 0);
+}
+
+QTEST_APPLESS_MAIN(TimingWheelTest)
+
+#include "timing_wheel_test.moc"